@@ -0,0 +1,166 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+#include "Ship.hpp"
+
+/*
+Поведение лодки - политика времени компиляции: что лодка делает после улова, который не принес победы.
+Общие для всех типов правила (таймеры, улов, движение к цели, уплывание победителя) остаются в движке.
+
+Политика не знает, откуда берутся случайные значения. Движок передает объект draw с методами
+timer() (1-3), offsetX() и offsetY() (0-15, смещение + 8), и политика вызывает их в нужном порядке:
+Simulation берет значения из общего последовательного генератора, StripeSimulation - из counterRandom
+по номеру лодки. Поэтому одна политика дает в обоих движках те же правила, что и раньше.
+Метод draw.richestOffset(ship, offsetX, offsetY) находит смещение до самой рыбной известной клетки
+в радиусе смещения или возвращает false, если такой клетки нет (или движок ее не видит).
+
+Новое поведение - это новая структура с TYPE и afterCatch, добавленная в ShipBehaviours
+(пока в слове лодки есть место для типа, см. BehaviourRegistry).
+*/
+
+// Жадная лодка рыбачит, пока не выловит все на своей клетке, потом уплывает в случайную сторону.
+struct GreedyBehaviour {
+    static constexpr uint8_t TYPE = ShipType::GREEDY;
+
+    template <typename Draw>
+    static uint64_t afterCatch(uint64_t ship, uint8_t cellFish, Draw& draw);
+};
+
+// Ленивая лодка никогда никуда не двигается и просто закидывает сеть снова.
+struct LazyBehaviour {
+    static constexpr uint8_t TYPE = ShipType::LAZY;
+
+    template <typename Draw>
+    static uint64_t afterCatch(uint64_t ship, uint8_t cellFish, Draw& draw);
+};
+
+// Непоседа после каждого улова сдвигается на клетку вправо.
+struct RestlessBehaviour {
+    static constexpr uint8_t TYPE = ShipType::RESTLESS;
+
+    template <typename Draw>
+    static uint64_t afterCatch(uint64_t ship, uint8_t cellFish, Draw& draw);
+};
+
+// Искатель рыбачит, пока на клетке есть рыба, а потом плывет к самой рыбной известной клетке рядом.
+struct SeekerBehaviour {
+    static constexpr uint8_t TYPE = ShipType::SEEKER;
+
+    template <typename Draw>
+    static uint64_t afterCatch(uint64_t ship, uint8_t cellFish, Draw& draw);
+};
+
+/*
+Реестр поведений: номер в списке - это 2-битный тип лодки в ее слове, так что в реестре
+не больше четырех поведений, и с искателем он заполнен. Для пятого придется расширить поле
+типа за счет 2 бит паддинга: сдвиги и маски в Ship.hpp, SHIP_TYPE_COUNT и веса типов в
+Scenario, формат файлов популяции. dispatch выбирает поведение одной лодки по типу,
+forEach перебирает все поведения, чтобы движок запустил для каждого типа свое ядро
+над пачкой лодок этого типа без ветвления по типу внутри.
+*/
+template <typename... Behaviours>
+class BehaviourRegistry {
+public:
+    static constexpr int COUNT = sizeof...(Behaviours);
+    static_assert(COUNT >= 1 && COUNT <= 4, "тип лодки занимает 2 бита слова: не больше четырех поведений");
+
+    template <std::size_t INDEX>
+    using At = std::tuple_element_t<INDEX, std::tuple<Behaviours...>>;
+
+    // Вызывает fn(Behaviour {}) для поведения типа type и возвращает результат.
+    template <typename Fn>
+    static decltype(auto) dispatch(uint8_t type, Fn&& fn);
+    // Вызывает fn(Behaviour {}) для каждого поведения по возрастанию типа.
+    template <typename Fn>
+    static void forEach(Fn&& fn);
+
+private:
+    template <std::size_t INDEX, typename Fn>
+    static decltype(auto) dispatchFrom(uint8_t type, Fn& fn);
+};
+
+// Совпадает ли TYPE каждого поведения реестра с его номером.
+template <typename Registry, std::size_t... INDICES>
+constexpr bool behaviourTypesMatch(std::index_sequence<INDICES...>)
+{
+    return ((Registry::template At<INDICES>::TYPE == INDICES) && ...);
+}
+
+using ShipBehaviours = BehaviourRegistry<GreedyBehaviour, LazyBehaviour, RestlessBehaviour, SeekerBehaviour>;
+static_assert(ShipBehaviours::COUNT == SHIP_TYPE_COUNT);
+static_assert(behaviourTypesMatch<ShipBehaviours>(std::make_index_sequence<ShipBehaviours::COUNT>()), "TYPE поведения должен совпадать с его номером в реестре");
+
+template <typename Draw>
+inline uint64_t GreedyBehaviour::afterCatch(uint64_t ship, uint8_t cellFish, Draw& draw)
+{
+    if (cellFish == 0) {
+        // На клетке закончилась рыба: случайное смещение и плавание.
+        ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, draw.offsetX());
+        ship = setbits(ship, OFFSET_Y_SHIFT, MASK_4BIT, draw.offsetY());
+        return setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::FLOATING);
+    }
+    return setbits(ship, TIMER_SHIFT, MASK_2BIT, draw.timer());
+}
+
+template <typename Draw>
+inline uint64_t LazyBehaviour::afterCatch(uint64_t ship, uint8_t, Draw& draw)
+{
+    return setbits(ship, TIMER_SHIFT, MASK_2BIT, draw.timer());
+}
+
+template <typename Draw>
+inline uint64_t RestlessBehaviour::afterCatch(uint64_t ship, uint8_t, Draw&)
+{
+    ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, 1 + 8);
+    return setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::FLOATING);
+}
+
+template <typename Draw>
+inline uint64_t SeekerBehaviour::afterCatch(uint64_t ship, uint8_t cellFish, Draw& draw)
+{
+    if (cellFish > 0) {
+        return setbits(ship, TIMER_SHIFT, MASK_2BIT, draw.timer());
+    }
+    uint64_t offsetX;
+    uint64_t offsetY;
+    if (!draw.richestOffset(ship, offsetX, offsetY)) {
+        // Рядом нет известной рыбы: плывем в случайную сторону, как жадная лодка.
+        offsetX = draw.offsetX();
+        offsetY = draw.offsetY();
+    }
+    ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, offsetX);
+    ship = setbits(ship, OFFSET_Y_SHIFT, MASK_4BIT, offsetY);
+    return setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::FLOATING);
+}
+
+template <typename... Behaviours>
+template <typename Fn>
+inline decltype(auto) BehaviourRegistry<Behaviours...>::dispatch(uint8_t type, Fn&& fn)
+{
+    return dispatchFrom<0>(type, fn);
+}
+
+template <typename... Behaviours>
+template <std::size_t INDEX, typename Fn>
+inline decltype(auto) BehaviourRegistry<Behaviours...>::dispatchFrom(uint8_t type, Fn& fn)
+{
+    // Последнее поведение берется без проверки: других типов в слове нет.
+    if constexpr (INDEX + 1 == COUNT) {
+        return fn(At<INDEX> {});
+    } else {
+        if (type == INDEX) {
+            return fn(At<INDEX> {});
+        }
+        return dispatchFrom<INDEX + 1>(type, fn);
+    }
+}
+
+template <typename... Behaviours>
+template <typename Fn>
+inline void BehaviourRegistry<Behaviours...>::forEach(Fn&& fn)
+{
+    (fn(Behaviours {}), ...);
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "Latency.hpp"
+#include "PerfCounters.hpp"
+#include "Simulation.hpp"
+
+// Параметры замера производительности.
+struct BenchConfig {
+    SimulationConfig simulation;
+    // Сколько тиков выполнить (меньше, если лодки уйдут раньше).
+    uint64_t ticks = 1000;
+    uint64_t tickDeadlineMs = 100;
+    // Читать аппаратные счетчики по фазам тика.
+    bool perf = false;
+};
+
+// Экранирует строку для JSON.
+inline std::string jsonString(const std::string& text)
+{
+    std::string result = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result + "\"";
+}
+
+/*
+Замер производительности без окна: тики выполняются подряд, результат печатается
+одним объектом JSON - пропускная способность, квантили задержки тика и по каждой фазе
+среднее время, сырые аппаратные счетчики, IPC и промахи кеша и предсказателя ветвлений на лодку.
+Если счетчики недоступны, в "perf" указывается причина, а счетчики фаз равны нулю.
+В "scripts" - цена лодки сценария за тик и одного продолжения корутины рядом с ценой
+обычной лодки за тик в том же прогоне, и сколько памяти взял пул кадров.
+*/
+inline void runBench(const BenchConfig& config, std::ostream& out)
+{
+    using Clock = std::chrono::steady_clock;
+
+    PerfCounters counters;
+    std::string perfError;
+    bool perf = config.perf && counters.open(perfError);
+    if (!config.perf) {
+        perfError = "выключено";
+    }
+
+    Simulation sim(config.simulation);
+    if (perf) {
+        sim.setPerfCounters(&counters);
+    }
+    TickProfiler profiler(config.tickDeadlineMs * 1'000'000, 0);
+
+    // Лодко-тики и время фаз обычных лодок и лодок сценариев.
+    uint64_t shipTicks = 0;
+    uint64_t scriptShipTicks = 0;
+    uint64_t shipsNs = 0;
+    uint64_t scriptsNs = 0;
+    // Лодки, прошедшие полный переход вместо перехода по таблице.
+    uint64_t slowShips = 0;
+
+    auto start = Clock::now();
+    while (!sim.finished() && sim.tick() <= config.ticks) {
+        uint64_t ships = sim.activeShips();
+        shipTicks += ships;
+        scriptShipTicks += sim.scriptShips();
+        auto tickStart = Clock::now();
+        sim.step();
+        shipsNs += sim.phaseNs()[TickPhase::SHIPS];
+        scriptsNs += sim.phaseNs()[TickPhase::SCRIPTS];
+        slowShips += sim.slowShips();
+        uint64_t tickNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - tickStart).count();
+        profiler.recordTick(sim.tick() - 1, tickNs, sim.phaseNs());
+        if (perf) {
+            profiler.recordCounters(sim.phaseCounters(), ships);
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    const SimulationConfig& simulation = config.simulation;
+    const LatencyHistogram& ticks = profiler.ticks();
+    out << "{\n"
+        << "  \"width\": " << simulation.width << ",\n"
+        << "  \"height\": " << simulation.height << ",\n"
+        << "  \"ships\": " << simulation.shipCount << ",\n"
+        << "  \"seed\": " << simulation.seed << ",\n"
+        << "  \"ticks\": " << ticks.count() << ",\n"
+        << "  \"seconds\": " << seconds << ",\n"
+        << "  \"ticks_per_s\": " << (seconds > 0 ? ticks.count() / seconds : 0.0) << ",\n"
+        << "  \"tick_ms\": { \"mean\": " << ticks.mean() / 1e6
+        << ", \"p50\": " << ticks.quantile(0.5) / 1e6
+        << ", \"p99\": " << ticks.quantile(0.99) / 1e6
+        << ", \"p999\": " << ticks.quantile(0.999) / 1e6
+        << ", \"max\": " << ticks.max() / 1e6 << " },\n"
+        << "  \"deadline_ms\": " << config.tickDeadlineMs << ",\n"
+        << "  \"overruns\": " << profiler.overruns() << ",\n";
+
+    CellTableHealth cells = sim.cells().health();
+    out << "  \"cells\": { \"size\": " << cells.size << ", \"slots\": " << cells.slots
+        << ", \"load_factor\": " << cells.loadFactor << ", \"rehashes\": " << cells.rehashes
+        << ", \"hits\": " << cells.hits << ", \"misses\": " << cells.misses
+        << ", \"cached_hits\": " << cells.cachedHits
+        << ", \"probe_mean\": " << (cells.probeSamples > 0 ? static_cast<double>(cells.probeTotal) / cells.probeSamples : 0.0)
+        << ", \"probe_max\": " << cells.probeMax << " },\n"
+        << "  \"fish_index\": { \"enabled\": " << (sim.fishIndex().enabled() ? "true" : "false")
+        << ", \"queries\": " << sim.fishIndex().queries() << ", \"cells_scanned\": " << sim.fishIndex().cellsScanned() << " },\n";
+
+    out << "  \"transitions\": { \"slow_fraction\": " << (shipTicks > 0 ? static_cast<double>(slowShips) / shipTicks : 0.0) << " },\n";
+
+    const FramePool& pool = sim.framePool();
+    out << "  \"scripts\": { \"ships\": " << simulation.scriptShips
+        << ", \"resumes\": " << sim.scriptResumes()
+        << ", \"ns_per_resume\": " << (sim.scriptResumes() > 0 ? static_cast<double>(scriptsNs) / sim.scriptResumes() : 0.0)
+        << ", \"ns_per_ship_tick\": " << (scriptShipTicks > 0 ? static_cast<double>(scriptsNs) / scriptShipTicks : 0.0)
+        << ", \"packed_ns_per_ship_tick\": " << (shipTicks > 0 ? static_cast<double>(shipsNs) / shipTicks : 0.0)
+        << ", \"frames\": " << pool.frames() << ", \"pool_chunks\": " << pool.chunks()
+        << ", \"pool_bytes\": " << pool.memoryBytes() << " },\n"
+        << "  \"perf\": { \"available\": " << (perf ? "true" : "false");
+    if (!perf) {
+        out << ", \"error\": " << jsonString(perfError);
+    }
+    out << " },\n"
+        << "  \"phases\": {\n";
+    for (int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+        out << "    " << jsonString(tickPhaseName(phase)) << ": { \"mean_ms\": " << profiler.phaseMeanMs(phase);
+        for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+            out << ", " << jsonString(perfEventName(event)) << ": " << profiler.phaseCounters(phase)[event];
+        }
+        out << ", \"ipc\": " << profiler.ipc(phase)
+            << ", \"llc_misses_per_ship\": " << profiler.perShip(phase, PerfEvent::LLC_MISSES)
+            << ", \"branch_misses_per_ship\": " << profiler.perShip(phase, PerfEvent::BRANCH_MISSES) << " }"
+            << (phase + 1 < TICK_PHASE_COUNT ? ",\n" : "\n");
+    }
+    out << "  }\n"
+        << "}" << std::endl;
+}
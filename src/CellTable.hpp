@@ -0,0 +1,551 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+
+/*
+Таблица активных клеток: позиция клетки -> количество рыбы и тик истечения.
+
+Открытая адресация с линейным пробированием, ключи и значения лежат в отдельных массивах.
+Рост постепенный: когда массив заполнен больше чем наполовину, выделяется массив вдвое больше,
+а записи старого переносятся в него по MIGRATE_STEP слотов за каждое добавление или удаление клетки.
+Пока перенос идет, поиск смотрит в оба массива. Ни одна операция не перехеширует
+всю таблицу разом, поэтому задержка тика не скачет при росте числа клеток.
+
+Тик истечения позволяет удалять истекшие клетки не сразу: клетка, чей тик истечения
+уже наступил, для find(cell, tick) считается отсутствующей. Тики хранятся в 32 битах
+и сравниваются по разности, так что переполнение счетчика тиков не мешает.
+*/
+// Состояние таблицы клеток для метрик. Счетчики монотонные с создания таблицы.
+struct CellTableHealth {
+    uint64_t size = 0;
+    uint64_t slots = 0;
+    double loadFactor = 0;
+    bool migrating = false;
+    // Сколько раз начинался переезд в новый массив (рост или уменьшение).
+    uint64_t rehashes = 0;
+    // Результаты поиска клеток лодками: найдена живая клетка или нет.
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // Из них найдены по запомненному слоту, без пробирования.
+    uint64_t cachedHits = 0;
+    // Длина пробирования (число просмотренных слотов) для каждого PROBE_SAMPLE_PERIOD-го поиска
+    // (поиски по запомненному слоту не пробируют и не замеряются).
+    uint64_t probeSamples = 0;
+    uint64_t probeTotal = 0;
+    uint64_t probeMax = 0;
+};
+
+class CellTable {
+public:
+    // Запомненного слота нет.
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    explicit CellTable(uint64_t expectedCells = 0);
+
+    /*
+    Указатель на количество рыбы в клетке или nullptr, если клетки нет или она истекла к тику tick.
+    Действителен до следующего изменения таблицы.
+    */
+    uint8_t* find(uint64_t cell, uint32_t tick);
+    // То же без учета в счетчиках поиска (hits, misses) - таблица не меняется.
+    const uint8_t* find(uint64_t cell, uint32_t tick) const;
+    // Рыба клетки для запросов только на чтение (поиск соседей), 0 - клетки нет или она истекла. Не считается.
+    uint8_t peek(uint64_t cell, uint32_t tick) const;
+    // Клетка в таблице независимо от истечения: ее рыба и тик истечения. Вернет false, если клетки нет.
+    bool stored(uint64_t cell, uint8_t& fish, uint32_t& expireTick) const;
+    /*
+    То же, но сначала смотрит в слот slot, запомненный прошлым обращением к этой клетке:
+    если клетка там, таблица не пробируется. Иначе slot обновляется по результату поиска.
+    Слот сверяется с ключом, поэтому рост, удаления и сдвиги записей его только устаревают,
+    а любое значение slot (в том числе чужое или NO_SLOT) безопасно.
+    */
+    uint8_t* find(uint64_t cell, uint32_t tick, uint32_t& slot);
+    /*
+    Активирует клетку до тика expireTick: добавляет ее или перезаписывает истекшую, но еще не удаленную.
+    Вернет указатель на количество рыбы в клетке, как find.
+    */
+    uint8_t* activate(uint64_t cell, uint8_t fish, uint32_t expireTick);
+    /*
+    То же с запомненным слотом, как у find. Если клетка уже была в таблице (истекшая, но еще
+    не удаленная), в previousFish, если он задан, записывается ее прежняя рыба.
+    */
+    uint8_t* activate(uint64_t cell, uint8_t fish, uint32_t expireTick, uint32_t& slot, uint8_t* previousFish = nullptr);
+    /*
+    Удаляет клетку, только если она истекла к тику tick (ее могли активировать заново).
+    В fish и expireTick, если они заданы, записываются рыба и тик истечения удаленной клетки.
+    */
+    bool eraseExpired(uint64_t cell, uint32_t tick, uint8_t* fish = nullptr, uint32_t* expireTick = nullptr);
+    // Удаляет клетку независимо от тика истечения.
+    bool erase(uint64_t cell);
+    void clear();
+
+    // Сразу готовит таблицу к count клеткам, чтобы при заполнении она не росла.
+    void reserve(uint64_t count);
+    // Начинает постепенный переезд в массив под count клеток (например, меньший после всплеска).
+    void rehash(uint64_t count);
+
+    uint64_t size() const noexcept { return m_currentSize + m_oldSize; }
+    // Число слотов в обоих массивах.
+    uint64_t slotCount() const noexcept { return m_current.capacity + m_old.capacity; }
+    bool migrating() const noexcept { return m_old.capacity != 0; }
+    // Слот - ключ, тик истечения и рыба.
+    static constexpr uint64_t SLOT_BYTES = sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint8_t);
+    uint64_t memoryBytes() const noexcept { return slotCount() * SLOT_BYTES; }
+    // Память таблицы, подготовленной reserve(count), без переезда.
+    static uint64_t memoryBytesFor(uint64_t count) { return capacityFor(count) * SLOT_BYTES; }
+
+    CellTableHealth health() const noexcept;
+
+    static bool expired(uint32_t expireTick, uint32_t tick) noexcept { return static_cast<int32_t>(expireTick - tick) <= 0; }
+
+    // Вызывает fn(cell, fish) для каждой клетки, включая истекшие, но еще не удаленные.
+    template <typename Fn>
+    void forEach(Fn&& fn) const;
+    // То же с тиком истечения: fn(cell, fish, expireTick).
+    template <typename Fn>
+    void forEachWithExpiry(Fn&& fn) const;
+    // Вызывает fn(cell, fish) только для клеток, не истекших к тику tick (для отрисовки и наблюдателей).
+    template <typename Fn>
+    void forEachLive(uint32_t tick, Fn&& fn) const;
+
+private:
+    struct FreeDeleter {
+        void operator()(void* ptr) const noexcept { std::free(ptr); }
+    };
+
+    /*
+    Ключ хранится как позиция + 1, ноль - пустой слот. Поэтому массив ключей берется из calloc:
+    большие блоки ОС отдает уже обнуленными страницами по первому обращению,
+    и выделение нового массива при росте не проходит по всей его памяти.
+    */
+    static constexpr uint64_t EMPTY = 0;
+    // Удаленная или перенесенная запись старого массива.
+    static constexpr uint64_t TOMBSTONE = UINT64_MAX;
+    // Слотов старого массива, переносимых за одну операцию. При заполнении не больше половины
+    // перенос заканчивается раньше, чем новый массив успевает заполниться.
+    static constexpr uint64_t MIGRATE_STEP = 32;
+    static constexpr uint64_t MIN_CAPACITY = 16;
+    // Длина пробирования замеряется повторным проходом цепочки у каждого 64-го поиска,
+    // чтобы сам поиск не платил за подсчет.
+    static constexpr uint64_t PROBE_SAMPLE_PERIOD = 64;
+
+    struct Slots {
+        std::unique_ptr<uint64_t[], FreeDeleter> keys;
+        std::unique_ptr<uint8_t[], FreeDeleter> values;
+        std::unique_ptr<uint32_t[], FreeDeleter> expires;
+        uint64_t capacity = 0;
+        unsigned shift = 64;
+
+        void allocate(uint64_t slotCount);
+        // Фибоначчиево хеширование: соседние позиции расходятся по всему массиву.
+        uint64_t home(uint64_t key) const noexcept { return (key * 0x9E3779B97F4A7C15ULL) >> shift; }
+        // Индекс слота с ключом key или capacity, если ключа нет.
+        uint64_t lookup(uint64_t key) const noexcept;
+        // Кладет ключ, которого нет в массиве, в первый свободный слот. Вернет индекс слота.
+        uint64_t place(uint64_t key, uint8_t value, uint32_t expire) noexcept;
+        // Сколько слотов просматривает поиск ключа key.
+        uint64_t probeLength(uint64_t key) const noexcept;
+    };
+
+    // Массив, в котором лежит ключ key, и индекс слота в нем; nullptr, если ключа нет.
+    Slots* locate(uint64_t key, uint64_t& index);
+    const Slots* locate(uint64_t key, uint64_t& index) const;
+    // Лежит ли ключ key в слоте slot нового массива.
+    bool remembered(uint64_t key, uint32_t slot) const noexcept { return slot < m_current.capacity && m_current.keys[slot] == key; }
+    // Слот для запоминания: запись старого массива скоро переедет, ее не запоминаем.
+    uint32_t slotToRemember(const Slots* slots, uint64_t index) const noexcept
+    {
+        return slots == &m_current && index < NO_SLOT ? static_cast<uint32_t>(index) : NO_SLOT;
+    }
+
+    static uint64_t capacityFor(uint64_t count);
+    void startMigration(uint64_t capacity);
+    void migrateStep();
+    void finishMigration();
+    void eraseAt(Slots* slots, uint64_t index);
+    // Удаляет слот index нового массива, сдвигая следующие записи цепочки назад (без надгробий).
+    void eraseCurrent(uint64_t index);
+    void sampleProbe(uint64_t key);
+
+    Slots m_current;
+    // Массив, из которого идет перенос; пуст, если переноса нет.
+    Slots m_old;
+    uint64_t m_migrateCursor = 0;
+    uint64_t m_currentSize = 0;
+    uint64_t m_oldSize = 0;
+
+    uint64_t m_rehashes = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    uint64_t m_cachedHits = 0;
+    uint64_t m_probeSamples = 0;
+    uint64_t m_probeTotal = 0;
+    uint64_t m_probeMax = 0;
+};
+
+inline void CellTable::Slots::allocate(uint64_t slotCount)
+{
+    keys.reset(static_cast<uint64_t*>(std::calloc(slotCount, sizeof(uint64_t))));
+    // Значения читаются только у занятых слотов, обнулять их не нужно.
+    values.reset(static_cast<uint8_t*>(std::malloc(slotCount)));
+    expires.reset(static_cast<uint32_t*>(std::malloc(slotCount * sizeof(uint32_t))));
+    capacity = slotCount;
+    shift = 64 - std::countr_zero(slotCount);
+}
+
+inline uint64_t CellTable::Slots::lookup(uint64_t key) const noexcept
+{
+    const uint64_t mask = capacity - 1;
+    for (uint64_t i = home(key);; i = (i + 1) & mask) {
+        uint64_t current = keys[i];
+        if (current == key) {
+            return i;
+        }
+        if (current == EMPTY) {
+            return capacity;
+        }
+    }
+}
+
+inline uint64_t CellTable::Slots::place(uint64_t key, uint8_t value, uint32_t expire) noexcept
+{
+    const uint64_t mask = capacity - 1;
+    uint64_t i = home(key);
+    while (keys[i] != EMPTY) {
+        i = (i + 1) & mask;
+    }
+    keys[i] = key;
+    values[i] = value;
+    expires[i] = expire;
+    return i;
+}
+
+inline uint64_t CellTable::Slots::probeLength(uint64_t key) const noexcept
+{
+    const uint64_t mask = capacity - 1;
+    uint64_t length = 1;
+    for (uint64_t i = home(key); keys[i] != key && keys[i] != EMPTY; i = (i + 1) & mask) {
+        length++;
+    }
+    return length;
+}
+
+inline CellTable::CellTable(uint64_t expectedCells)
+{
+    m_current.allocate(capacityFor(expectedCells));
+}
+
+inline uint64_t CellTable::capacityFor(uint64_t count)
+{
+    return std::bit_ceil(std::max<uint64_t>(MIN_CAPACITY, 2 * count));
+}
+
+inline CellTable::Slots* CellTable::locate(uint64_t key, uint64_t& index)
+{
+    const Slots* slots = std::as_const(*this).locate(key, index);
+    if (slots == nullptr) {
+        return nullptr;
+    }
+    return slots == &m_current ? &m_current : &m_old;
+}
+
+inline const CellTable::Slots* CellTable::locate(uint64_t key, uint64_t& index) const
+{
+    index = m_current.lookup(key);
+    if (index < m_current.capacity) {
+        return &m_current;
+    }
+    if (migrating()) {
+        index = m_old.lookup(key);
+        if (index < m_old.capacity) {
+            return &m_old;
+        }
+    }
+    return nullptr;
+}
+
+inline uint8_t* CellTable::find(uint64_t cell, uint32_t tick)
+{
+    uint32_t slot = NO_SLOT;
+    return find(cell, tick, slot);
+}
+
+inline uint8_t* CellTable::find(uint64_t cell, uint32_t tick, uint32_t& slot)
+{
+    if (remembered(cell + 1, slot)) {
+        if (expired(m_current.expires[slot], tick)) {
+            m_misses++;
+            return nullptr;
+        }
+        m_hits++;
+        m_cachedHits++;
+        return &m_current.values[slot];
+    }
+
+    uint64_t index;
+    Slots* slots = locate(cell + 1, index);
+    slot = slotToRemember(slots, index);
+    if ((m_hits + m_misses) % PROBE_SAMPLE_PERIOD == 0) {
+        sampleProbe(cell + 1);
+    }
+    if (slots == nullptr || expired(slots->expires[index], tick)) {
+        m_misses++;
+        return nullptr;
+    }
+    m_hits++;
+    return &slots->values[index];
+}
+
+inline void CellTable::sampleProbe(uint64_t key)
+{
+    // Пока идет переезд, поиск без результата проходит оба массива.
+    uint64_t length = m_current.probeLength(key);
+    if (migrating() && m_current.lookup(key) == m_current.capacity) {
+        length += m_old.probeLength(key);
+    }
+    m_probeSamples++;
+    m_probeTotal += length;
+    m_probeMax = std::max(m_probeMax, length);
+}
+
+inline CellTableHealth CellTable::health() const noexcept
+{
+    CellTableHealth health;
+    health.size = size();
+    health.slots = slotCount();
+    health.loadFactor = health.slots > 0 ? static_cast<double>(health.size) / health.slots : 0.0;
+    health.migrating = migrating();
+    health.rehashes = m_rehashes;
+    health.hits = m_hits;
+    health.misses = m_misses;
+    health.cachedHits = m_cachedHits;
+    health.probeSamples = m_probeSamples;
+    health.probeTotal = m_probeTotal;
+    health.probeMax = m_probeMax;
+    return health;
+}
+
+inline const uint8_t* CellTable::find(uint64_t cell, uint32_t tick) const
+{
+    uint64_t index;
+    const Slots* slots = locate(cell + 1, index);
+    if (slots == nullptr || expired(slots->expires[index], tick)) {
+        return nullptr;
+    }
+    return &slots->values[index];
+}
+
+inline uint8_t CellTable::peek(uint64_t cell, uint32_t tick) const
+{
+    const uint8_t* fish = find(cell, tick);
+    return fish != nullptr ? *fish : 0;
+}
+
+inline bool CellTable::stored(uint64_t cell, uint8_t& fish, uint32_t& expireTick) const
+{
+    uint64_t index;
+    const Slots* slots = locate(cell + 1, index);
+    if (slots == nullptr) {
+        return false;
+    }
+    fish = slots->values[index];
+    expireTick = slots->expires[index];
+    return true;
+}
+
+inline uint8_t* CellTable::activate(uint64_t cell, uint8_t fish, uint32_t expireTick)
+{
+    uint32_t slot = NO_SLOT;
+    return activate(cell, fish, expireTick, slot);
+}
+
+inline uint8_t* CellTable::activate(uint64_t cell, uint8_t fish, uint32_t expireTick, uint32_t& slot, uint8_t* previousFish)
+{
+    uint64_t key = cell + 1;
+    uint64_t index = slot;
+    // Истекшая, но не удаленная клетка часто лежит в запомненном слоте.
+    Slots* slots = remembered(key, slot) ? &m_current : locate(key, index);
+    if (slots != nullptr) {
+        if (previousFish != nullptr) {
+            *previousFish = slots->values[index];
+        }
+        slots->values[index] = fish;
+        slots->expires[index] = expireTick;
+        slot = slotToRemember(slots, index);
+        return &slots->values[index];
+    }
+
+    migrateStep();
+    if (2 * (m_currentSize + 1) > m_current.capacity) {
+        startMigration(2 * m_current.capacity);
+    }
+    m_currentSize++;
+    index = m_current.place(key, fish, expireTick);
+    slot = slotToRemember(&m_current, index);
+    return &m_current.values[index];
+}
+
+inline bool CellTable::eraseExpired(uint64_t cell, uint32_t tick, uint8_t* fish, uint32_t* expireTick)
+{
+    migrateStep();
+    uint64_t index;
+    Slots* slots = locate(cell + 1, index);
+    if (slots == nullptr || !expired(slots->expires[index], tick)) {
+        return false;
+    }
+    if (fish != nullptr) {
+        *fish = slots->values[index];
+    }
+    if (expireTick != nullptr) {
+        *expireTick = slots->expires[index];
+    }
+    eraseAt(slots, index);
+    return true;
+}
+
+inline bool CellTable::erase(uint64_t cell)
+{
+    migrateStep();
+    uint64_t index;
+    Slots* slots = locate(cell + 1, index);
+    if (slots == nullptr) {
+        return false;
+    }
+    eraseAt(slots, index);
+    return true;
+}
+
+inline void CellTable::eraseAt(Slots* slots, uint64_t index)
+{
+    if (slots == &m_current) {
+        eraseCurrent(index);
+        m_currentSize--;
+    } else {
+        m_old.keys[index] = TOMBSTONE;
+        m_oldSize--;
+    }
+}
+
+inline void CellTable::eraseCurrent(uint64_t index)
+{
+    const uint64_t mask = m_current.capacity - 1;
+    uint64_t hole = index;
+    for (uint64_t i = (hole + 1) & mask;; i = (i + 1) & mask) {
+        uint64_t key = m_current.keys[i];
+        if (key == EMPTY) {
+            break;
+        }
+        // Запись можно сдвинуть в дырку, если ее домашний слот не лежит между дыркой и ею.
+        uint64_t home = m_current.home(key);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            m_current.keys[hole] = key;
+            m_current.values[hole] = m_current.values[i];
+            m_current.expires[hole] = m_current.expires[i];
+            hole = i;
+        }
+    }
+    m_current.keys[hole] = EMPTY;
+}
+
+inline void CellTable::clear()
+{
+    m_old = Slots {};
+    m_migrateCursor = 0;
+    m_oldSize = 0;
+    std::memset(m_current.keys.get(), 0, m_current.capacity * sizeof(uint64_t));
+    m_currentSize = 0;
+}
+
+inline void CellTable::reserve(uint64_t count)
+{
+    uint64_t capacity = capacityFor(count);
+    if (capacity > m_current.capacity) {
+        startMigration(capacity);
+        finishMigration();
+    }
+}
+
+inline void CellTable::rehash(uint64_t count)
+{
+    uint64_t capacity = capacityFor(std::max(count, size()));
+    if (!migrating() && capacity != m_current.capacity) {
+        startMigration(capacity);
+    }
+}
+
+inline void CellTable::startMigration(uint64_t capacity)
+{
+    // Новый рост до конца предыдущего переноса возможен только после rehash с малым запасом.
+    finishMigration();
+    m_rehashes++;
+    m_old = std::move(m_current);
+    m_oldSize = m_currentSize;
+    m_current.allocate(capacity);
+    m_currentSize = 0;
+    m_migrateCursor = 0;
+}
+
+inline void CellTable::migrateStep()
+{
+    if (!migrating()) {
+        return;
+    }
+    uint64_t end = std::min(m_migrateCursor + MIGRATE_STEP, m_old.capacity);
+    for (uint64_t i = m_migrateCursor; i < end; i++) {
+        uint64_t key = m_old.keys[i];
+        if (key != EMPTY && key != TOMBSTONE) {
+            m_current.place(key, m_old.values[i], m_old.expires[i]);
+            // Перенесенная запись не должна находиться поиском по старому массиву.
+            m_old.keys[i] = TOMBSTONE;
+            m_currentSize++;
+            m_oldSize--;
+        }
+    }
+    m_migrateCursor = end;
+    if (m_migrateCursor == m_old.capacity || m_oldSize == 0) {
+        m_old = Slots {};
+        m_migrateCursor = 0;
+    }
+}
+
+inline void CellTable::finishMigration()
+{
+    while (migrating()) {
+        migrateStep();
+    }
+}
+
+template <typename Fn>
+inline void CellTable::forEach(Fn&& fn) const
+{
+    forEachWithExpiry([&](uint64_t cell, uint8_t fish, uint32_t) { fn(cell, fish); });
+}
+
+template <typename Fn>
+inline void CellTable::forEachWithExpiry(Fn&& fn) const
+{
+    for (const Slots* slots : { &m_current, &m_old }) {
+        for (uint64_t i = 0; i < slots->capacity; i++) {
+            uint64_t key = slots->keys[i];
+            if (key != EMPTY && key != TOMBSTONE) {
+                fn(key - 1, slots->values[i], slots->expires[i]);
+            }
+        }
+    }
+}
+
+template <typename Fn>
+inline void CellTable::forEachLive(uint32_t tick, Fn&& fn) const
+{
+    forEachWithExpiry([&](uint64_t cell, uint8_t fish, uint32_t expireTick) {
+        if (!expired(expireTick, tick)) {
+            fn(cell, fish);
+        }
+    });
+}
@@ -0,0 +1,209 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Parallel.hpp"
+#include "Random.hpp"
+#include "Ship.hpp"
+
+/*
+Разбор популяции из CSV вида:
+
+    x,y,type,fish,state
+    12,40,greedy,0,fishing
+    13,40,2,150,floating
+
+Тип и состояние задаются числом (как в упакованной лодке) или именем в нижнем регистре.
+Строка заголовка необязательна: если первая строка начинается не с цифры, она пропускается.
+*/
+
+// Считает символы '\n' в [begin, end). На x86 сравнивает по 16 байт за раз.
+inline uint64_t countNewlines(const char* begin, const char* end)
+{
+    uint64_t count = 0;
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - begin >= 16; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+        count += std::popcount(mask);
+    }
+#endif
+    for (; begin < end; begin++) {
+        count += *begin == '\n';
+    }
+    return count;
+}
+
+// Возвращает указатель на первый '\n' в [begin, end) или end.
+inline const char* findNewline(const char* begin, const char* end)
+{
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - begin >= 16; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+        if (mask != 0) {
+            return begin + std::countr_zero(mask);
+        }
+    }
+#endif
+    for (; begin < end; begin++) {
+        if (*begin == '\n') {
+            return begin;
+        }
+    }
+    return end;
+}
+
+// Параметры упаковки строк CSV в лодки.
+struct CsvParseOptions {
+    uint64_t width = 0;
+    uint64_t height = 0;
+    // Максимальный начальный улов (рыба для победы).
+    uint64_t maxFish = MASK_14BIT;
+    // Сид для таймеров рыбалки, которых нет в CSV.
+    uint64_t seed = 0;
+    unsigned threads = 0;
+};
+
+/*
+Разбирает одно поле до запятой или конца строки: число или одно из имен names (их индекс).
+Сдвигает cursor за разделитель. Вернет false, если поле некорректно.
+*/
+inline bool parseCsvField(const char*& cursor, const char* lineEnd, uint64_t& value,
+    const std::string_view* names = nullptr, int nameCount = 0)
+{
+    const char* fieldEnd = std::find(cursor, lineEnd, ',');
+    auto [ptr, ec] = std::from_chars(cursor, fieldEnd, value);
+    bool ok = ec == std::errc {} && ptr == fieldEnd;
+    for (int i = 0; !ok && i < nameCount; i++) {
+        if (std::string_view(cursor, fieldEnd - cursor) == names[i]) {
+            value = i;
+            ok = true;
+        }
+    }
+    cursor = fieldEnd == lineEnd ? lineEnd : fieldEnd + 1;
+    return ok;
+}
+
+/*
+Разбирает одну строку в упакованную лодку. row - сквозной номер лодки, из него выводится таймер.
+Вернет false, если строка некорректна.
+*/
+inline bool parseCsvShip(const char* line, const char* lineEnd, uint64_t row, const CsvParseOptions& options, uint64_t& ship)
+{
+    static constexpr std::string_view typeNames[] = { "greedy", "lazy", "restless", "seeker" };
+    static constexpr std::string_view stateNames[] = { "floating", "fishing", "finishing", "dead" };
+
+    if (lineEnd > line && lineEnd[-1] == '\r') {
+        lineEnd--;
+    }
+
+    uint64_t x = 0, y = 0, type = 0, fish = 0, state = 0;
+    const char* cursor = line;
+    bool ok = parseCsvField(cursor, lineEnd, x)
+        && parseCsvField(cursor, lineEnd, y)
+        && parseCsvField(cursor, lineEnd, type, typeNames, SHIP_TYPE_COUNT)
+        && parseCsvField(cursor, lineEnd, fish)
+        && parseCsvField(cursor, lineEnd, state, stateNames, 4);
+    if (!ok || cursor != lineEnd || x >= options.width || y >= options.height
+        || type >= SHIP_TYPE_COUNT || fish > options.maxFish) {
+        return false;
+    }
+
+    ship = type;
+    ship |= state << STATE_SHIFT;
+    ship |= fish << FISH_SHIFT;
+    ship |= (y * options.width + x) << POSITION_SHIFT;
+    if (state == ShipState::FISHING) {
+        // Таймера в CSV нет, выбираем его детерминированно по номеру лодки.
+        ship |= (1 + randomBelow(counterRandom(options.seed, row, 1), 3)) << TIMER_SHIFT;
+    } else if (state == ShipState::FLOATING) {
+        // Нулевые смещения: лодка уже у цели и на следующем тике начнет рыбачить.
+        ship |= 8ULL << OFFSET_X_SHIFT;
+        ship |= 8ULL << OFFSET_Y_SHIFT;
+    }
+    return true;
+}
+
+/*
+Разбирает CSV из памяти прямо в массив упакованных лодок.
+
+Файл делится на куски по числу потоков, границы кусков сдвигаются на начало строки.
+Первый проход параллельно считает строки в каждом куске, префиксная сумма дает
+каждому куску его диапазон в массиве лодок, второй проход параллельно разбирает строки
+сразу в этот диапазон - без промежуточных строк и объектов.
+При ошибке заполняет error номером первой некорректной строки и возвращает false.
+*/
+inline bool parseShipsCsv(const char* data, uint64_t size, const CsvParseOptions& options, ShipArray& ships, std::string& error)
+{
+    const char* end = data + size;
+    const char* begin = data;
+    uint64_t headerLines = 0;
+    if (begin < end && (*begin < '0' || *begin > '9')) {
+        begin = std::min(end, findNewline(begin, end) + 1);
+        headerLines = 1;
+    }
+
+    // Мелкие файлы быстрее разобрать в одном потоке.
+    unsigned threads = end - begin < (1 << 20) ? 1 : resolveThreads(options.threads);
+    std::vector<const char*> bounds(threads + 1);
+    bounds[0] = begin;
+    bounds[threads] = end;
+    for (unsigned t = 1; t < threads; t++) {
+        const char* raw = begin + (end - begin) * t / threads;
+        bounds[t] = std::max(bounds[t - 1], std::min(end, findNewline(raw, end) + 1));
+    }
+
+    // Первый проход: число строк в каждом куске.
+    std::vector<uint64_t> rowOffsets(threads + 1, 0);
+    parallelFor(threads, threads, [&](uint64_t t, uint64_t, unsigned) {
+        const char* chunkBegin = bounds[t];
+        const char* chunkEnd = bounds[t + 1];
+        uint64_t rows = countNewlines(chunkBegin, chunkEnd);
+        // Последняя строка файла может быть без перевода строки.
+        if (chunkEnd > chunkBegin && chunkEnd[-1] != '\n') {
+            rows++;
+        }
+        rowOffsets[t + 1] = rows;
+    });
+    for (unsigned t = 0; t < threads; t++) {
+        rowOffsets[t + 1] += rowOffsets[t];
+    }
+    ships.resize(rowOffsets[threads]);
+
+    // Второй проход: разбор строк в свой диапазон массива лодок.
+    std::vector<uint64_t> badRows(threads, UINT64_MAX);
+    parallelFor(threads, threads, [&](uint64_t t, uint64_t, unsigned) {
+        const char* line = bounds[t];
+        const char* chunkEnd = bounds[t + 1];
+        for (uint64_t row = rowOffsets[t]; row < rowOffsets[t + 1]; row++) {
+            const char* lineEnd = findNewline(line, chunkEnd);
+            if (!parseCsvShip(line, lineEnd, row, options, ships[row])) {
+                badRows[t] = row;
+                return;
+            }
+            line = lineEnd + 1;
+        }
+    });
+
+    for (uint64_t row : badRows) {
+        if (row != UINT64_MAX) {
+            error = "некорректная строка " + std::to_string(row + headerLines + 1)
+                + " (ожидается x,y,type,fish,state в пределах карты)";
+            return false;
+        }
+    }
+    return true;
+}
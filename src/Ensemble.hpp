@@ -0,0 +1,187 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "Parallel.hpp"
+#include "Random.hpp"
+#include "Simulation.hpp"
+
+// Параметры серии независимых прогонов (Монте-Карло).
+struct EnsembleConfig {
+    SimulationConfig simulation;
+    uint64_t runs = 100;
+    // 0 - по числу ядер.
+    unsigned threads = 0;
+    // Прогоны, не закончившиеся за это число тиков, считаются незавершенными.
+    uint64_t maxTicks = 1'000'000;
+};
+
+// Сводный отчет по всем прогонам серии.
+struct EnsembleReport {
+    uint64_t runs = 0;
+    uint64_t completedRuns = 0;
+    // Гистограмма числа тиков до ухода всех лодок: индекс - тик, значение - число прогонов.
+    std::vector<uint64_t> ticksToEmpty;
+    // Гистограммы тиков ухода лодок по типам, сложенные по всем прогонам.
+    std::array<std::vector<uint64_t>, SHIP_TYPE_COUNT> finishTicks;
+
+    // Добавляет в отчет результат одного прогона.
+    void addRun(const Simulation& sim);
+    void merge(const EnsembleReport& other);
+    void print(std::ostream& out) const;
+};
+
+// Складывает гистограмму src в dst, расширяя dst при необходимости.
+inline void addHistogram(std::vector<uint64_t>& dst, const std::vector<uint64_t>& src)
+{
+    if (dst.size() < src.size()) {
+        dst.resize(src.size(), 0);
+    }
+    for (std::size_t i = 0; i < src.size(); i++) {
+        dst[i] += src[i];
+    }
+}
+
+// Возвращает значение квантиля q (0..1) по гистограмме, где индекс - значение.
+inline uint64_t histogramQuantile(const std::vector<uint64_t>& counts, double q)
+{
+    uint64_t total = 0;
+    for (uint64_t c : counts) {
+        total += c;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    // Ранг искомого элемента, считая с единицы.
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * total)));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return i;
+        }
+    }
+    return counts.size() - 1;
+}
+
+inline void EnsembleReport::addRun(const Simulation& sim)
+{
+    runs++;
+    if (sim.finished()) {
+        completedRuns++;
+        // tick() указывает на следующий тик, последний выполненный - на единицу меньше.
+        uint64_t lastTick = sim.tick() - 1;
+        if (ticksToEmpty.size() <= lastTick) {
+            ticksToEmpty.resize(lastTick + 1, 0);
+        }
+        ticksToEmpty[lastTick]++;
+    }
+    for (int type = 0; type < SHIP_TYPE_COUNT; type++) {
+        addHistogram(finishTicks[type], sim.finishTicks(type));
+    }
+}
+
+inline void EnsembleReport::merge(const EnsembleReport& other)
+{
+    runs += other.runs;
+    completedRuns += other.completedRuns;
+    addHistogram(ticksToEmpty, other.ticksToEmpty);
+    for (int type = 0; type < SHIP_TYPE_COUNT; type++) {
+        addHistogram(finishTicks[type], other.finishTicks[type]);
+    }
+}
+
+inline void EnsembleReport::print(std::ostream& out) const
+{
+    static const char* typeNames[SHIP_TYPE_COUNT] = { "Greedy", "Lazy", "Restless", "Seeker" };
+    static const double quantiles[] = { 0.0, 0.05, 0.5, 0.95, 0.99, 1.0 };
+
+    auto printQuantiles = [&](const std::vector<uint64_t>& counts) {
+        for (double q : quantiles) {
+            out << " p" << q * 100 << "=" << histogramQuantile(counts, q);
+        }
+        out << "\n";
+    };
+
+    out << "Runs: " << runs << ", completed: " << completedRuns << "\n";
+    out << "Ticks until all ships leave:";
+    printQuantiles(ticksToEmpty);
+    for (int type = 0; type < SHIP_TYPE_COUNT; type++) {
+        // Типы, которых не было ни в одном прогоне, не выводятся.
+        if (finishTicks[type].empty()) {
+            continue;
+        }
+        out << typeNames[type] << " finish tick:";
+        printQuantiles(finishTicks[type]);
+    }
+}
+
+// Выводит сид прогона из базового сида и номера прогона (splitmix64).
+inline uint64_t runSeed(uint64_t baseSeed, uint64_t run)
+{
+    return mix64(baseSeed + (run + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+/*
+Выполняет серию независимых прогонов на всех ядрах.
+Каждый поток закреплен за ядром и держит одну симуляцию, которую создает сам,
+так что ее память выделяется и инициализируется на этом же ядре (first-touch)
+и переиспользуется между прогонами через Simulation::reset.
+Потоки берут номера прогонов из общего атомарного счетчика и копят отчет локально,
+сливая его в общий только в конце.
+*/
+inline EnsembleReport runEnsemble(const EnsembleConfig& config)
+{
+    unsigned threads = resolveThreads(config.threads);
+    threads = static_cast<unsigned>(std::min<uint64_t>(threads, std::max<uint64_t>(1, config.runs)));
+
+    std::atomic<uint64_t> nextRun { 0 };
+    std::vector<EnsembleReport> partial(threads);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            pinCurrentThread(t);
+            EnsembleReport& report = partial[t];
+
+            uint64_t run = nextRun.fetch_add(1, std::memory_order_relaxed);
+            if (run >= config.runs) {
+                return;
+            }
+            SimulationConfig simConfig = config.simulation;
+            // Потоки уже заняты прогонами, расстановку каждый делает в одиночку.
+            simConfig.scenario.threads = 1;
+            simConfig.recordFinishTicks = true;
+            simConfig.seed = runSeed(config.simulation.seed, run);
+            Simulation sim(simConfig);
+
+            while (true) {
+                while (!sim.finished() && sim.tick() <= config.maxTicks) {
+                    sim.step();
+                }
+
+                report.addRun(sim);
+
+                run = nextRun.fetch_add(1, std::memory_order_relaxed);
+                if (run >= config.runs) {
+                    break;
+                }
+                sim.reset(runSeed(config.simulation.seed, run));
+            }
+        });
+    }
+
+    EnsembleReport total;
+    for (unsigned t = 0; t < threads; t++) {
+        workers[t].join();
+        total.merge(partial[t]);
+    }
+    return total;
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+/*
+Сводка рыбы по плиткам карты TILE x TILE клеток - для поиска самой рыбной клетки рядом с лодкой.
+
+Для каждой плитки хранится, сколько в ней клеток с каждым количеством рыбы (1-15), и маска
+непустых уровней. Окно смещений лодки 16x16 задевает не больше 5x5 плиток, их маски лежат
+в пяти строках массива - это несколько кеш-линий, - и по ним сразу видно наибольшую рыбу
+в окрестности и плитки, где она есть. Клетки (не больше 16) перебираются только в этих плитках.
+Сводка плотная - около байта на клетку карты, - поэтому для слишком больших карт не строится.
+
+Сводка учитывает только живые клетки: истекшая клетка уходит из нее в тике истечения,
+даже если из таблицы ее удалят позже. Плитка на краю прямоугольника может дать уровень
+клетки за его пределами, поэтому кандидата проверяет fishAt, и если его рыба другая,
+поиск переходит к следующей плитке или уровню.
+*/
+class FishIndex {
+public:
+    static constexpr uint64_t TILE = 4;
+    static constexpr int LEVELS = 16;
+    // Больше этого сводка не выделяется.
+    static constexpr uint64_t MAX_BYTES = 1ULL << 30;
+
+    /*
+    Выделяет сводку для карты width x height. До этого сводка выключена и update не вызывается.
+    Вернет false, если сводка заняла бы больше MAX_BYTES; тогда refused() и повторять не нужно.
+    */
+    bool enable(uint64_t width, uint64_t height);
+    bool enabled() const noexcept { return !m_masks.empty(); }
+    bool refused() const noexcept { return m_refused; }
+    // Обнуляет сводку, сохраняя память.
+    void clear();
+    // Рыба клетки изменилась с before на after (0 - клетки нет в таблице или рыбы на ней нет).
+    void update(uint64_t cell, uint8_t before, uint8_t after);
+    /*
+    Ищет клетку с наибольшей рыбой в прямоугольнике [x0, x1] x [y0, y1]; fishAt(cell) - рыба живой клетки
+    или 0. Из равных выбирается первая по плиткам, а внутри плитки - по строкам.
+    Вернет false, если в прямоугольнике нет клеток с рыбой.
+    */
+    template <typename FishAt>
+    bool richest(uint64_t x0, uint64_t y0, uint64_t x1, uint64_t y1, FishAt&& fishAt, uint64_t& cell);
+
+    uint64_t memoryBytes() const noexcept { return m_masks.capacity() * sizeof(uint16_t) + m_counts.capacity() * LEVELS; }
+    // Сколько было поисков и сколько клеток они проверили через fishAt.
+    uint64_t queries() const noexcept { return m_queries; }
+    uint64_t cellsScanned() const noexcept { return m_cellsScanned; }
+    // Плитки сводки по строкам: маска непустых уровней и число клеток каждого уровня.
+    uint64_t tileCount() const noexcept { return m_masks.size(); }
+    uint16_t levelMask(uint64_t tile) const noexcept { return m_masks[tile]; }
+    const std::array<uint8_t, LEVELS>& levelCounts(uint64_t tile) const noexcept { return m_counts[tile]; }
+
+private:
+    uint64_t tileOf(uint64_t cell) const noexcept { return cell / m_width / TILE * m_tilesX + cell % m_width / TILE; }
+
+    uint64_t m_width = 0;
+    uint64_t m_tilesX = 0;
+    // Бит f маски - в плитке есть клетка с f рыбы.
+    std::vector<uint16_t> m_masks;
+    // Число клеток плитки с каждым количеством рыбы (в плитке не больше 16 клеток).
+    std::vector<std::array<uint8_t, LEVELS>> m_counts;
+    bool m_refused = false;
+    uint64_t m_queries = 0;
+    uint64_t m_cellsScanned = 0;
+};
+
+inline bool FishIndex::enable(uint64_t width, uint64_t height)
+{
+    uint64_t tilesX = (width + TILE - 1) / TILE;
+    uint64_t tiles = tilesX * ((height + TILE - 1) / TILE);
+    if (tiles * (sizeof(uint16_t) + LEVELS) > MAX_BYTES) {
+        m_refused = true;
+        return false;
+    }
+    m_width = width;
+    m_tilesX = tilesX;
+    m_masks.assign(tiles, 0);
+    m_counts.assign(tiles, {});
+    return true;
+}
+
+inline void FishIndex::clear()
+{
+    std::fill(m_masks.begin(), m_masks.end(), 0);
+    std::fill(m_counts.begin(), m_counts.end(), std::array<uint8_t, LEVELS> {});
+}
+
+inline void FishIndex::update(uint64_t cell, uint8_t before, uint8_t after)
+{
+    if (before == after) {
+        return;
+    }
+    uint64_t tile = tileOf(cell);
+    auto& counts = m_counts[tile];
+    if (before > 0 && --counts[before] == 0) {
+        m_masks[tile] &= static_cast<uint16_t>(~(1u << before));
+    }
+    if (after > 0 && counts[after]++ == 0) {
+        m_masks[tile] |= static_cast<uint16_t>(1u << after);
+    }
+}
+
+template <typename FishAt>
+inline bool FishIndex::richest(uint64_t x0, uint64_t y0, uint64_t x1, uint64_t y1, FishAt&& fishAt, uint64_t& cell)
+{
+    m_queries++;
+    const uint64_t tx0 = x0 / TILE, tx1 = x1 / TILE;
+    const uint64_t ty0 = y0 / TILE, ty1 = y1 / TILE;
+    uint32_t levels = 0;
+    for (uint64_t ty = ty0; ty <= ty1; ty++) {
+        for (uint64_t tx = tx0; tx <= tx1; tx++) {
+            levels |= m_masks[ty * m_tilesX + tx];
+        }
+    }
+
+    while (levels != 0) {
+        const unsigned level = std::bit_width(levels) - 1;
+        for (uint64_t ty = ty0; ty <= ty1; ty++) {
+            for (uint64_t tx = tx0; tx <= tx1; tx++) {
+                if ((m_masks[ty * m_tilesX + tx] & (1u << level)) == 0) {
+                    continue;
+                }
+                // Клетки плитки внутри прямоугольника.
+                uint64_t yEnd = std::min(ty * TILE + TILE - 1, y1);
+                uint64_t xEnd = std::min(tx * TILE + TILE - 1, x1);
+                for (uint64_t y = std::max(ty * TILE, y0); y <= yEnd; y++) {
+                    for (uint64_t x = std::max(tx * TILE, x0); x <= xEnd; x++) {
+                        m_cellsScanned++;
+                        if (fishAt(y * m_width + x) == level) {
+                            cell = y * m_width + x;
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        // Клетки этого уровня истекли или лежат в плитках за краем прямоугольника.
+        levels &= ~(1u << level);
+    }
+    return false;
+}
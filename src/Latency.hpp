@@ -0,0 +1,306 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Simulation.hpp"
+
+/*
+Гистограмма задержек с высоким динамическим диапазоном (по образцу HdrHistogram).
+Значения до 128 нс хранятся точно, дальше каждая степень двойки делится на 64 равные
+корзины, так что относительная ошибка не больше 1/64 (две значащие цифры) от наносекунд
+до ~2 минут при фиксированных 16 КБ памяти. Запись - несколько битовых операций без ветвлений по размеру.
+*/
+class LatencyHistogram {
+public:
+    void record(uint64_t ns);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const noexcept { return m_count; }
+    uint64_t max() const noexcept { return m_max; }
+    uint64_t sum() const noexcept { return m_sum; }
+    double mean() const noexcept { return m_count > 0 ? static_cast<double>(m_sum) / m_count : 0.0; }
+    // Значение квантиля q (0..1) в наносекундах.
+    uint64_t quantile(double q) const;
+    // Для каждой границы bounds[i] (по возрастанию) - число значений не больше нее, с точностью корзины.
+    void cumulativeCounts(const uint64_t* bounds, std::size_t boundCount, uint64_t* counts) const;
+
+private:
+    static constexpr unsigned SUB_BITS = 7;
+    static constexpr uint64_t SUB_COUNT = 1ULL << SUB_BITS;
+    static constexpr uint64_t HALF_COUNT = SUB_COUNT / 2;
+    // Больше 128 << 30 нс значения попадают в последнюю корзину.
+    static constexpr unsigned MAX_SHIFT = 30;
+    static constexpr uint64_t BUCKET_COUNT = SUB_COUNT + MAX_SHIFT * HALF_COUNT;
+
+    static uint64_t bucketOf(uint64_t ns) noexcept;
+    // Середина диапазона значений корзины.
+    static uint64_t bucketValue(uint64_t bucket) noexcept;
+
+    std::array<uint64_t, BUCKET_COUNT> m_counts {};
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_max = 0;
+};
+
+inline uint64_t LatencyHistogram::bucketOf(uint64_t ns) noexcept
+{
+    if (ns < SUB_COUNT) {
+        return ns;
+    }
+    // Сдвиг оставляет от значения старшие SUB_BITS бит: число в [HALF_COUNT, SUB_COUNT).
+    unsigned shift = std::bit_width(ns) - SUB_BITS;
+    if (shift > MAX_SHIFT) {
+        return BUCKET_COUNT - 1;
+    }
+    return SUB_COUNT + (shift - 1) * HALF_COUNT + ((ns >> shift) - HALF_COUNT);
+}
+
+inline uint64_t LatencyHistogram::bucketValue(uint64_t bucket) noexcept
+{
+    if (bucket < SUB_COUNT) {
+        return bucket;
+    }
+    unsigned shift = static_cast<unsigned>((bucket - SUB_COUNT) / HALF_COUNT) + 1;
+    uint64_t sub = (bucket - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+    return (sub << shift) + (1ULL << (shift - 1));
+}
+
+inline void LatencyHistogram::record(uint64_t ns)
+{
+    m_counts[bucketOf(ns)]++;
+    m_count++;
+    m_sum += ns;
+    m_max = std::max(m_max, ns);
+}
+
+inline void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (uint64_t i = 0; i < BUCKET_COUNT; i++) {
+        m_counts[i] += other.m_counts[i];
+    }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_max = std::max(m_max, other.m_max);
+}
+
+inline void LatencyHistogram::reset()
+{
+    m_counts.fill(0);
+    m_count = 0;
+    m_sum = 0;
+    m_max = 0;
+}
+
+inline uint64_t LatencyHistogram::quantile(double q) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+    // Ранг искомого значения, считая с единицы.
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * m_count)));
+    uint64_t seen = 0;
+    for (uint64_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += m_counts[i];
+        if (seen >= rank) {
+            // Середина корзины может оказаться больше реального максимума.
+            return std::min(bucketValue(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+inline void LatencyHistogram::cumulativeCounts(const uint64_t* bounds, std::size_t boundCount, uint64_t* counts) const
+{
+    uint64_t seen = 0;
+    std::size_t bound = 0;
+    for (uint64_t i = 0; i < BUCKET_COUNT && bound < boundCount; i++) {
+        while (bound < boundCount && bucketValue(i) > bounds[bound]) {
+            counts[bound++] = seen;
+        }
+        seen += m_counts[i];
+    }
+    while (bound < boundCount) {
+        counts[bound++] = seen;
+    }
+}
+
+// Тик, превысивший дедлайн или попавший в число самых долгих, с разбивкой по фазам.
+struct SlowTick {
+    uint64_t tick = 0;
+    uint64_t totalNs = 0;
+    TickPhaseTimes phaseNs {};
+};
+
+/*
+Задержки тиков и кадров: гистограммы за все время и за текущий интервал отчета,
+счетчик тиков дольше дедлайна и журнал slowTickCount самых долгих тиков.
+Кроме того, копит время и аппаратные счетчики по фазам тика за все время.
+*/
+class TickProfiler {
+public:
+    TickProfiler(uint64_t deadlineNs, uint64_t slowTickCount);
+
+    void recordTick(uint64_t tick, uint64_t ns, const TickPhaseTimes& phaseNs);
+    void recordFrame(uint64_t ns);
+    // Складывает приращения аппаратных счетчиков по фазам тика, за который обойдено ships лодок.
+    void recordCounters(const TickPhaseCounters& counters, uint64_t ships);
+    // Начинает новый интервал отчета: обнуляет интервальные гистограммы.
+    void resetInterval();
+
+    const LatencyHistogram& ticks() const noexcept { return m_ticks; }
+    const LatencyHistogram& intervalTicks() const noexcept { return m_intervalTicks; }
+    const LatencyHistogram& frames() const noexcept { return m_frames; }
+    const LatencyHistogram& intervalFrames() const noexcept { return m_intervalFrames; }
+    uint64_t overruns() const noexcept { return m_overruns; }
+    uint64_t deadlineNs() const noexcept { return m_deadlineNs; }
+
+    double phaseMeanMs(int phase) const noexcept;
+    uint64_t phaseNsTotal(int phase) const noexcept { return m_phaseNsTotal[phase]; }
+    const PerfValues& phaseCounters(int phase) const noexcept { return m_phaseCounters[phase]; }
+    // Инструкций за такт в фазе, 0 - если счетчиков не было.
+    double ipc(int phase) const noexcept;
+    // Событий event в фазе на одну лодку за тик.
+    double perShip(int phase, int event) const noexcept;
+
+    // Самые долгие тики, начиная с самого долгого.
+    std::vector<SlowTick> slowestTicks() const;
+    void printSlowestTicks(std::ostream& out) const;
+
+private:
+    static bool slowerFirst(const SlowTick& a, const SlowTick& b) noexcept { return a.totalNs > b.totalNs; }
+
+    uint64_t m_deadlineNs;
+    uint64_t m_slowTickCount;
+    LatencyHistogram m_ticks;
+    LatencyHistogram m_intervalTicks;
+    LatencyHistogram m_frames;
+    LatencyHistogram m_intervalFrames;
+    uint64_t m_overruns = 0;
+    TickPhaseTimes m_phaseNsTotal {};
+    TickPhaseCounters m_phaseCounters {};
+    uint64_t m_shipTicks = 0;
+    // Куча с самым быстрым из сохраненных тиков на вершине.
+    std::vector<SlowTick> m_slowest;
+};
+
+inline TickProfiler::TickProfiler(uint64_t deadlineNs, uint64_t slowTickCount)
+    : m_deadlineNs(deadlineNs)
+    , m_slowTickCount(slowTickCount)
+{
+    m_slowest.reserve(slowTickCount);
+}
+
+inline void TickProfiler::recordTick(uint64_t tick, uint64_t ns, const TickPhaseTimes& phaseNs)
+{
+    m_ticks.record(ns);
+    m_intervalTicks.record(ns);
+    for (int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+        m_phaseNsTotal[phase] += phaseNs[phase];
+    }
+    if (m_deadlineNs > 0 && ns > m_deadlineNs) {
+        m_overruns++;
+    }
+
+    if (m_slowTickCount == 0) {
+        return;
+    }
+    if (m_slowest.size() < m_slowTickCount) {
+        m_slowest.push_back(SlowTick { tick, ns, phaseNs });
+        std::push_heap(m_slowest.begin(), m_slowest.end(), slowerFirst);
+    } else if (ns > m_slowest.front().totalNs) {
+        std::pop_heap(m_slowest.begin(), m_slowest.end(), slowerFirst);
+        m_slowest.back() = SlowTick { tick, ns, phaseNs };
+        std::push_heap(m_slowest.begin(), m_slowest.end(), slowerFirst);
+    }
+}
+
+inline void TickProfiler::recordFrame(uint64_t ns)
+{
+    m_frames.record(ns);
+    m_intervalFrames.record(ns);
+}
+
+inline void TickProfiler::recordCounters(const TickPhaseCounters& counters, uint64_t ships)
+{
+    for (int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+        for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+            m_phaseCounters[phase][event] += counters[phase][event];
+        }
+    }
+    m_shipTicks += ships;
+}
+
+inline double TickProfiler::phaseMeanMs(int phase) const noexcept
+{
+    return m_ticks.count() > 0 ? static_cast<double>(m_phaseNsTotal[phase]) / m_ticks.count() / 1e6 : 0.0;
+}
+
+inline double TickProfiler::ipc(int phase) const noexcept
+{
+    uint64_t cycles = m_phaseCounters[phase][PerfEvent::CYCLES];
+    return cycles > 0 ? static_cast<double>(m_phaseCounters[phase][PerfEvent::INSTRUCTIONS]) / cycles : 0.0;
+}
+
+inline double TickProfiler::perShip(int phase, int event) const noexcept
+{
+    return m_shipTicks > 0 ? static_cast<double>(m_phaseCounters[phase][event]) / m_shipTicks : 0.0;
+}
+
+inline void TickProfiler::resetInterval()
+{
+    m_intervalTicks.reset();
+    m_intervalFrames.reset();
+}
+
+inline std::vector<SlowTick> TickProfiler::slowestTicks() const
+{
+    std::vector<SlowTick> sorted = m_slowest;
+    std::sort(sorted.begin(), sorted.end(), slowerFirst);
+    return sorted;
+}
+
+// Наносекунды в миллисекунды строкой с двумя знаками после запятой.
+inline std::string formatMs(uint64_t ns)
+{
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2) << static_cast<double>(ns) / 1e6;
+    return text.str();
+}
+
+// Квантили гистограммы строкой "p50 / p99 / p99.9 / max" в миллисекундах.
+inline std::string formatQuantiles(const LatencyHistogram& histogram)
+{
+    return formatMs(histogram.quantile(0.5)) + " / " + formatMs(histogram.quantile(0.99)) + " / "
+        + formatMs(histogram.quantile(0.999)) + " / " + formatMs(histogram.max());
+}
+
+inline void TickProfiler::printSlowestTicks(std::ostream& out) const
+{
+    out << "Slowest ticks (ms), deadline " << formatMs(m_deadlineNs) << ", overruns " << m_overruns << ":\n";
+    for (const SlowTick& slow : slowestTicks()) {
+        out << "  tick " << slow.tick << ": " << formatMs(slow.totalNs);
+        for (int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+            out << ' ' << tickPhaseName(phase) << '=' << formatMs(slow.phaseNs[phase]);
+        }
+        out << "\n";
+    }
+}
+
+// Счетчики фазы строкой для панели: "ships: IPC 1.20, LLC/ship 0.45, br-miss/ship 0.12".
+inline std::string formatPhaseCounters(const TickProfiler& profiler, int phase)
+{
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2) << tickPhaseName(phase) << ": IPC " << profiler.ipc(phase)
+         << ", LLC/ship " << profiler.perShip(phase, PerfEvent::LLC_MISSES)
+         << ", br-miss/ship " << profiler.perShip(phase, PerfEvent::BRANCH_MISSES);
+    return text.str();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Текущий размер резидентной памяти процесса в байтах, 0 если неизвестен.
+inline uint64_t currentRssBytes()
+{
+#ifdef __linux__
+    // Второе поле /proc/self/statm - резидентные страницы.
+    std::ifstream statm("/proc/self/statm");
+    uint64_t pages = 0, resident = 0;
+    if (statm >> pages >> resident) {
+        return resident * static_cast<uint64_t>(sysconf(_SC_PAGE_SIZE));
+    }
+#endif
+    return 0;
+}
+
+// Максимальный за время жизни процесса размер резидентной памяти в байтах, 0 если неизвестен.
+inline uint64_t peakRssBytes()
+{
+#if defined(__APPLE__)
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss); // На macOS - в байтах.
+#elif defined(__unix__)
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // На Linux - в килобайтах.
+#else
+    return 0;
+#endif
+}
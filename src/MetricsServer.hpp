@@ -0,0 +1,223 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "Latency.hpp"
+#include "Metrics.hpp"
+#include "Net.hpp"
+#include "Parallel.hpp"
+#include "Simulation.hpp"
+
+// Границы корзин гистограммы длительности тика для экспорта, в наносекундах.
+constexpr std::array<uint64_t, 12> METRICS_TICK_BOUNDS_NS = {
+    1'000'000, 2'000'000, 5'000'000, 10'000'000, 20'000'000, 50'000'000,
+    100'000'000, 200'000'000, 500'000'000, 1'000'000'000, 2'000'000'000, 5'000'000'000
+};
+
+// Снимок метрик, который поток тиков публикует после каждого тика.
+struct MetricsSnapshot {
+    uint64_t tick = 0;
+    uint64_t activeShips = 0;
+    std::array<uint64_t, SHIP_TYPE_COUNT> shipsByType {};
+    uint64_t expiryBacklog = 0;
+    uint64_t freeSlots = 0;
+    uint64_t arrivedShips = 0;
+    uint64_t droppedArrivals = 0;
+    uint64_t respawnedShips = 0;
+    uint64_t injectedShips = 0;
+    CellTableHealth cells;
+    MemoryUsage memory;
+    uint64_t overruns = 0;
+    uint64_t tickCount = 0;
+    uint64_t tickSumNs = 0;
+    std::array<uint64_t, METRICS_TICK_BOUNDS_NS.size()> tickBuckets {};
+    TickPhaseTimes phaseNsTotal {};
+};
+
+/*
+Встроенный HTTP-сервер метрик в текстовом формате Prometheus (GET /metrics).
+Слушает только 127.0.0.1 и работает в своем потоке. Поток тиков заполняет снимок
+и публикует его через тройной буфер, а сервер при запросе забирает последний снимок -
+ни блокировок, ни ожидания между ними нет, медленный клиент задерживает только сервер.
+*/
+class MetricsServer {
+public:
+    MetricsServer() = default;
+    ~MetricsServer() { stop(); }
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    bool start(uint16_t port, std::string& error);
+    void stop();
+    bool running() const noexcept { return m_listenFd >= 0; }
+
+    // Заполняет и публикует снимок. Вызывается только потоком тиков.
+    void publish(const Simulation& sim, const TickProfiler& profiler);
+
+private:
+    void serve();
+    void handle(int client);
+    std::string render(const MetricsSnapshot& snapshot) const;
+
+    TripleBuffer<MetricsSnapshot> m_snapshots;
+    int m_listenFd = -1;
+    std::atomic<bool> m_stop { false };
+    std::thread m_thread;
+};
+
+inline bool MetricsServer::start(uint16_t port, std::string& error)
+{
+    m_listenFd = listenLocalTcp(port, error);
+    if (m_listenFd < 0) {
+        return false;
+    }
+    m_stop = false;
+    m_thread = std::thread([this]() { serve(); });
+    return true;
+}
+
+inline void MetricsServer::stop()
+{
+    if (m_listenFd < 0) {
+        return;
+    }
+    m_stop = true;
+    m_thread.join();
+    close(m_listenFd);
+    m_listenFd = -1;
+}
+
+inline void MetricsServer::publish(const Simulation& sim, const TickProfiler& profiler)
+{
+    MetricsSnapshot& snapshot = m_snapshots.writeBuffer();
+    const SimulationStats& stats = sim.stats();
+    snapshot.tick = sim.tick() - 1;
+    snapshot.activeShips = sim.activeShips();
+    snapshot.shipsByType = { stats.greedyCount, stats.lazyCount, stats.restlessCount, stats.seekerCount };
+    snapshot.expiryBacklog = sim.expiryBacklog();
+    snapshot.freeSlots = sim.freeSlots();
+    snapshot.arrivedShips = sim.arrivedShips();
+    snapshot.droppedArrivals = sim.droppedArrivals();
+    snapshot.respawnedShips = sim.respawnedShips();
+    snapshot.injectedShips = sim.injectedShips();
+    snapshot.cells = sim.cells().health();
+    snapshot.memory = sim.memoryUsage();
+    snapshot.overruns = profiler.overruns();
+    snapshot.tickCount = profiler.ticks().count();
+    snapshot.tickSumNs = profiler.ticks().sum();
+    profiler.ticks().cumulativeCounts(METRICS_TICK_BOUNDS_NS.data(), METRICS_TICK_BOUNDS_NS.size(), snapshot.tickBuckets.data());
+    for (int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+        snapshot.phaseNsTotal[phase] = profiler.phaseNsTotal(phase);
+    }
+    m_snapshots.publish();
+}
+
+inline void MetricsServer::serve()
+{
+    while (!m_stop.load(std::memory_order_relaxed)) {
+        // Короткий таймаут, чтобы поток замечал остановку.
+        if (!waitReadable(m_listenFd, 200)) {
+            continue;
+        }
+        int client = acceptClient(m_listenFd);
+        if (client >= 0) {
+            handle(client);
+            close(client);
+        }
+    }
+}
+
+inline void MetricsServer::handle(int client)
+{
+    // Читаем заголовки запроса целиком; тело у GET не ожидается.
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        if (!waitReadable(client, 1000)) {
+            return;
+        }
+        ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return;
+        }
+        request.append(buffer, received);
+    }
+
+    std::string status = "200 OK";
+    std::string body;
+    if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET /metrics?", 0) == 0) {
+        m_snapshots.update();
+        body = render(m_snapshots.readBuffer());
+    } else {
+        status = "404 Not Found";
+        body = "not found\n";
+    }
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+        + "Content-Type: text/plain; version=0.0.4\r\n"
+        + "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        + "Connection: close\r\n\r\n" + body;
+    sendAll(client, response.data(), response.size());
+}
+
+inline std::string MetricsServer::render(const MetricsSnapshot& snapshot) const
+{
+    static const char* typeNames[SHIP_TYPE_COUNT] = { "greedy", "lazy", "restless", "seeker" };
+    std::ostringstream out;
+    auto header = [&](const char* name, const char* type, const char* help) {
+        out << "# HELP grandfishing_" << name << ' ' << help << "\n# TYPE grandfishing_" << name << ' ' << type << "\n";
+    };
+    auto metric = [&](const char* name, const char* type, const char* help, auto value) {
+        header(name, type, help);
+        out << "grandfishing_" << name << ' ' << value << "\n";
+    };
+
+    metric("tick", "counter", "Last completed tick.", snapshot.tick);
+    header("active_ships", "gauge", "Ships on the map by type.");
+    for (int type = 0; type < SHIP_TYPE_COUNT; type++) {
+        out << "grandfishing_active_ships{type=\"" << typeNames[type] << "\"} " << snapshot.shipsByType[type] << "\n";
+    }
+    metric("active_cells", "gauge", "Cells in the cell table, including expired ones awaiting removal.", snapshot.cells.size);
+    metric("expiry_backlog", "gauge", "Expired cells whose removal is deferred.", snapshot.expiryBacklog);
+    metric("free_slots", "gauge", "Ship slots available for reuse.", snapshot.freeSlots);
+    metric("arrived_ships_total", "counter", "Ships that arrived.", snapshot.arrivedShips);
+    metric("dropped_arrivals_total", "counter", "Arrivals dropped for lack of capacity.", snapshot.droppedArrivals);
+    metric("respawned_ships_total", "counter", "Ships replaced in place on finish.", snapshot.respawnedShips);
+    metric("injected_ships_total", "counter", "Ships added by bulk injection.", snapshot.injectedShips);
+
+    metric("cell_table_slots", "gauge", "Slots in the cell table arrays.", snapshot.cells.slots);
+    metric("cell_table_load_factor", "gauge", "Cells per slot.", snapshot.cells.loadFactor);
+    metric("cell_table_rehashes_total", "counter", "Migrations to a new array.", snapshot.cells.rehashes);
+    header("cell_table_lookups_total", "counter", "Cell lookups by ships.");
+    out << "grandfishing_cell_table_lookups_total{result=\"hit\"} " << snapshot.cells.hits << "\n"
+        << "grandfishing_cell_table_lookups_total{result=\"miss\"} " << snapshot.cells.misses << "\n";
+    metric("cell_table_cached_lookups_total", "counter", "Cell hits found through a remembered slot without probing.", snapshot.cells.cachedHits);
+    metric("cell_table_probe_max", "gauge", "Longest sampled probe sequence.", snapshot.cells.probeMax);
+
+    header("memory_bytes", "gauge", "Memory held by simulation containers.");
+    out << "grandfishing_memory_bytes{container=\"ships\"} " << snapshot.memory.ships << "\n"
+        << "grandfishing_memory_bytes{container=\"cells\"} " << snapshot.memory.cells << "\n"
+        << "grandfishing_memory_bytes{container=\"timers\"} " << snapshot.memory.timers << "\n"
+        << "grandfishing_memory_bytes{container=\"free_slots\"} " << snapshot.memory.freeSlots << "\n";
+    // Резидентная память процесса читается здесь, а не в потоке тиков.
+    metric("resident_memory_bytes", "gauge", "Resident memory of the process.", currentRssBytes());
+
+    metric("tick_overruns_total", "counter", "Ticks longer than the deadline.", snapshot.overruns);
+    header("tick_duration_seconds", "histogram", "Tick duration.");
+    for (std::size_t i = 0; i < METRICS_TICK_BOUNDS_NS.size(); i++) {
+        out << "grandfishing_tick_duration_seconds_bucket{le=\"" << METRICS_TICK_BOUNDS_NS[i] / 1e9 << "\"} "
+            << snapshot.tickBuckets[i] << "\n";
+    }
+    out << "grandfishing_tick_duration_seconds_bucket{le=\"+Inf\"} " << snapshot.tickCount << "\n"
+        << "grandfishing_tick_duration_seconds_sum " << snapshot.tickSumNs / 1e9 << "\n"
+        << "grandfishing_tick_duration_seconds_count " << snapshot.tickCount << "\n";
+    header("tick_phase_seconds_total", "counter", "Time spent in each tick phase.");
+    for (int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+        out << "grandfishing_tick_phase_seconds_total{phase=\"" << tickPhaseName(phase) << "\"} "
+            << snapshot.phaseNsTotal[phase] / 1e9 << "\n";
+    }
+    return out.str();
+}
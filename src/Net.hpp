@@ -0,0 +1,209 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+Флаг send, отключающий SIGPIPE при записи в закрытое соединение. На Linux это MSG_NOSIGNAL;
+на macOS такого флага нет, там сокет получает SO_NOSIGPIPE один раз в prepareSocket.
+*/
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_NO_SIGNAL = MSG_NOSIGNAL;
+#else
+constexpr int SEND_NO_SIGNAL = 0;
+#endif
+
+/*
+Готовит новый сокет: закрывать при exec и не слать SIGPIPE (где это свойство сокета).
+SOCK_CLOEXEC и accept4 есть только на Linux, поэтому флаг ставится отдельным fcntl.
+*/
+inline void prepareSocket(int fd)
+{
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    int noSigpipe = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigpipe, sizeof(noSigpipe));
+#endif
+}
+
+// Создает потоковый сокет семейства family. Вернет -1 и заполнит error при ошибке.
+inline int openSocket(int family, std::string& error)
+{
+    int fd = socket(family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = std::string("socket: ") + std::strerror(errno);
+        return -1;
+    }
+    prepareSocket(fd);
+    return fd;
+}
+
+// Принимает соединение со слушающего сокета. Вернет -1, если соединения нет или accept не удался.
+inline int acceptClient(int listenFd)
+{
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd >= 0) {
+        prepareSocket(fd);
+    }
+    return fd;
+}
+
+// Отправляет сколько получится без ожидания. Как send: -1 и errno при ошибке (EAGAIN - буфер полон).
+inline ssize_t sendNow(int fd, const void* data, std::size_t size)
+{
+    return send(fd, data, size, MSG_DONTWAIT | SEND_NO_SIGNAL);
+}
+
+// Открывает слушающий TCP-сокет только на 127.0.0.1. Вернет -1 и заполнит error при ошибке.
+inline int listenLocalTcp(uint16_t port, std::string& error)
+{
+    int fd = openSocket(AF_INET, error);
+    if (fd < 0) {
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 16) < 0) {
+        error = "порт " + std::to_string(port) + ": " + std::strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Ждет, пока из сокета можно читать (или принять соединение). Вернет false по таймауту.
+inline bool waitReadable(int fd, int timeoutMs)
+{
+    pollfd request { fd, POLLIN, 0 };
+    return poll(&request, 1, timeoutMs) > 0;
+}
+
+// Отправляет буфер целиком. Вернет false, если соединение закрыто.
+inline bool sendAll(int fd, const void* data, std::size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, SEND_NO_SIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+// Разобранный адрес сокета.
+struct SocketAddress {
+    sockaddr_storage storage {};
+    socklen_t length = 0;
+    // Путь Unix-сокета, пустой для TCP.
+    std::string unixPath;
+};
+
+/*
+Разбирает адрес: "unix:/путь" - Unix-сокет, "хост:порт" - TCP,
+просто "порт" - TCP на 127.0.0.1. Вернет false и заполнит error, если адрес не разобран.
+*/
+inline bool resolveAddress(const std::string& text, SocketAddress& address, std::string& error)
+{
+    address = SocketAddress {};
+    if (text.rfind("unix:", 0) == 0) {
+        address.unixPath = text.substr(5);
+        sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&address.storage);
+        if (address.unixPath.empty() || address.unixPath.size() >= sizeof(un->sun_path)) {
+            error = "некорректный путь Unix-сокета " + text;
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        std::memcpy(un->sun_path, address.unixPath.c_str(), address.unixPath.size() + 1);
+        address.length = sizeof(sockaddr_un);
+        return true;
+    }
+
+    std::size_t colon = text.rfind(':');
+    std::string host = colon == std::string::npos ? "127.0.0.1" : text.substr(0, colon);
+    std::string port = colon == std::string::npos ? text : text.substr(colon + 1);
+    addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (status != 0 || result == nullptr) {
+        error = "адрес " + text + ": " + gai_strerror(status);
+        return false;
+    }
+    std::memcpy(&address.storage, result->ai_addr, result->ai_addrlen);
+    address.length = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+// Открывает слушающий сокет по адресу вида resolveAddress. Вернет -1 и заполнит error при ошибке.
+inline int listenAddress(const std::string& text, std::string& error)
+{
+    SocketAddress address;
+    if (!resolveAddress(text, address, error)) {
+        return -1;
+    }
+    int fd = openSocket(address.storage.ss_family, error);
+    if (fd < 0) {
+        return -1;
+    }
+    if (address.unixPath.empty()) {
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    } else {
+        // Файл сокета от прошлого запуска мешает bind.
+        unlink(address.unixPath.c_str());
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address.storage), address.length) < 0 || listen(fd, 16) < 0) {
+        error = "адрес " + text + ": " + std::strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Подключается к адресу вида resolveAddress. Вернет -1 и заполнит error при ошибке.
+inline int connectAddress(const std::string& text, std::string& error)
+{
+    SocketAddress address;
+    if (!resolveAddress(text, address, error)) {
+        return -1;
+    }
+    int fd = openSocket(address.storage.ss_family, error);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address.storage), address.length) < 0) {
+        error = "подключение к " + text + ": " + std::strerror(errno);
+        close(fd);
+        return -1;
+    }
+    if (address.unixPath.empty()) {
+        // Мелкие кадры (запрос области) не должны ждать алгоритма Нейгла.
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+    return fd;
+}
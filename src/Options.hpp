@@ -0,0 +1,383 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "Simulation.hpp"
+
+/*
+Параметры командной строки.
+Без аргументов запускается обычная симуляция с окном.
+*/
+struct Options {
+    // Параметры симуляции, по умолчанию берутся из define-ов в main.cpp.
+    SimulationConfig simulation;
+    // Сид задан явно, иначе берется из std::random_device.
+    bool seedSet = false;
+    // Задана опция поступлений: --arrivals, --arrival-rate, --arrival-types, --respawn или --capacity.
+    bool arrivalsSet = false;
+    bool help = false;
+
+    // Режим серии прогонов без окна.
+    bool ensemble = false;
+    uint64_t runs = 100;
+    unsigned threads = 0;
+    uint64_t maxTicks = 1'000'000;
+
+    // Режим перебора сетки параметров без окна.
+    std::string sweepGrid;
+    std::string sweepOut = "sweep.csv";
+
+    // Файл начальной популяции для загрузки.
+    std::string populationFile;
+    // Сгенерировать популяцию, записать в файл и выйти.
+    std::string writePopulationFile;
+
+    // Длительный прогон без окна, секунд; 0 - выключен.
+    uint64_t soakSeconds = 0;
+    uint64_t reportIntervalSeconds = 10;
+
+    // Тики дольше дедлайна считаются просроченными.
+    uint64_t tickDeadlineMs = 100;
+    // Сколько самых долгих тиков напечатать в конце с разбивкой по фазам.
+    uint64_t slowTicks = 0;
+
+    // Замер производительности на заданное число тиков с выводом JSON; 0 - выключен.
+    uint64_t benchTicks = 0;
+    // Читать аппаратные счетчики по фазам тика (Linux, perf_event_open).
+    bool perf = false;
+
+    // Порт HTTP-сервера метрик на 127.0.0.1; 0 - выключен.
+    uint64_t metricsPort = 0;
+
+    // Симуляция без окна с раздачей области карты клиентам по этому адресу.
+    std::string serveAddress;
+    // Окно, которое рисует симуляцию с сервера по этому адресу.
+    std::string connectAddress;
+
+    // Прогон без окна, поделенный на столько горизонтальных полос; 0 - выключен.
+    unsigned shards = 0;
+    // Полосы в потоках одного процесса, а не в отдельных процессах.
+    bool shardThreads = false;
+    // Раз в столько тиков полосы сдвигают границы по нагрузке; 0 - границы неподвижны.
+    uint64_t rebalanceInterval = 0;
+    double rebalanceThreshold = 1.1;
+    // Сверять каждый тик полос с прогоном одной полосой.
+    bool verifyShards = false;
+};
+
+// Разбирает беззнаковое число целиком. Вернет nullopt, если строка не является числом.
+inline std::optional<uint64_t> parseUint(std::string_view text)
+{
+    uint64_t value = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc {} || ptr != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+inline void printUsage(std::ostream& out)
+{
+    out << "Usage: GrandFishing [options]\n"
+           "  --width N, --height N    Размер карты\n"
+           "  --ships N                Количество лодок\n"
+           "  --win-fish N             Количество рыбы для победы\n"
+           "  --seed N                 Сид генератора случайных чисел\n"
+           "  --types G:L:R[:S]        Соотношение жадных, ленивых, непоседливых лодок и искателей\n"
+           "  --placement NAME         Расстановка: uniform, clusters, hot, stripes\n"
+           "  --clusters N, --spread N Число облаков и их разброс в клетках (clusters)\n"
+           "  --hot-cells N            Число клеток со всеми лодками (hot)\n"
+           "  --stripes N              Число полос, вдоль границ которых стоят лодки (stripes)\n"
+           "  --ensemble RUNS          Серия независимых прогонов без окна\n"
+           "  --threads N              Число потоков (0 - по числу ядер)\n"
+           "  --max-ticks N            Ограничение длины одного прогона\n"
+           "  --population FILE        Загрузить начальную популяцию из бинарного файла или CSV\n"
+           "  --write-population FILE  Сгенерировать популяцию, записать в файл и выйти\n"
+           "  --arrivals MODE          Поступление новых лодок: fixed или poisson\n"
+           "  --arrival-rate R         Среднее число новых лодок за тик\n"
+           "  --arrival-types G:L:R[:S] Соотношение типов новых лодок\n"
+           "  --respawn                Заменять ушедшую лодку новой в том же слоте\n"
+           "  --capacity N             Максимальное число слотов лодок\n"
+           "  --scripts N              Добавить N лодок, которыми управляют сценарии-корутины\n"
+           "  --script NAME            Сценарий этих лодок: greedy или patrol\n"
+           "  --expiry-budget N        Максимум удалений истекших клеток за тик (0 - авто)\n"
+           "  --no-compaction          Не освобождать память контейнеров во время прогона\n"
+           "  --soak SECONDS           Длительный прогон без окна с отчетом о задержках и памяти\n"
+           "  --report-interval N      Интервал строк отчета длительного прогона, секунд\n"
+           "  --tick-deadline-ms N     Дедлайн тика для счетчика просрочек\n"
+           "  --slow-ticks N           Напечатать в конце N самых долгих тиков по фазам\n"
+           "  --bench TICKS            Замер производительности без окна, результат в JSON\n"
+           "  --perf                   Аппаратные счетчики по фазам тика (панель и --bench)\n"
+           "  --metrics-port PORT      Метрики Prometheus на http://127.0.0.1:PORT/metrics (окно, --soak, --serve)\n"
+           "  --serve ADDR             Симуляция без окна для удаленного просмотра (PORT, HOST:PORT, unix:PATH)\n"
+           "  --connect ADDR           Окно удаленного просмотра симуляции с сервера --serve\n"
+           "  --shards N               Прогон без окна, поделенный на N полос карты в отдельных процессах\n"
+           "  --shard-threads          Полосы --shards в потоках одного процесса\n"
+           "  --rebalance N            Раз в N тиков сдвигать границы полос --shards по времени полос\n"
+           "  --rebalance-threshold X  Сдвигать, если самая медленная полоса медленнее средней в X раз (1.1)\n"
+           "  --verify-shards          Сверять хеш каждого тика --shards с прогоном одной полосой\n"
+           "  --sweep FILE             Перебор сетки параметров из файла без окна\n"
+           "  --out FILE               Файл CSV с результатами перебора (sweep.csv)\n";
+}
+
+// Разбирает веса типов вида G:L:R или G:L:R:S; без последнего веса искателей нет.
+inline bool parseTypeWeights(std::string_view text, std::array<uint32_t, SHIP_TYPE_COUNT>& weights)
+{
+    weights.fill(0);
+    for (int type = 0; type < SHIP_TYPE_COUNT; type++) {
+        std::size_t end = text.find(':');
+        std::optional<uint64_t> weight = parseUint(text.substr(0, end));
+        if (!weight) {
+            return false;
+        }
+        weights[type] = static_cast<uint32_t>(*weight);
+        if (end == std::string_view::npos) {
+            return type + 2 >= SHIP_TYPE_COUNT;
+        }
+        text.remove_prefix(end + 1);
+    }
+    return false;
+}
+
+/*
+Разбирает аргументы поверх уже заполненных значений по умолчанию.
+При ошибке печатает сообщение и возвращает false.
+*/
+inline bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+
+        if (arg == "--help") {
+            options.help = true;
+            return true;
+        }
+
+        // Флаги без значения.
+        if (arg == "--respawn") {
+            options.simulation.arrivals.respawn = true;
+            options.arrivalsSet = true;
+            continue;
+        }
+        if (arg == "--no-compaction") {
+            options.simulation.compaction.enabled = false;
+            continue;
+        }
+        if (arg == "--perf") {
+            options.perf = true;
+            continue;
+        }
+        if (arg == "--shard-threads") {
+            options.shardThreads = true;
+            continue;
+        }
+        if (arg == "--verify-shards") {
+            options.verifyShards = true;
+            continue;
+        }
+
+        // Все опции ниже принимают ровно одно значение.
+        if (i + 1 >= argc) {
+            std::cout << "Ошибка: не указано значение для " << arg << std::endl;
+            return false;
+        }
+
+        // Строковые значения.
+        if (arg == "--sweep") {
+            options.sweepGrid = argv[++i];
+            continue;
+        }
+        if (arg == "--out") {
+            options.sweepOut = argv[++i];
+            continue;
+        }
+        if (arg == "--serve") {
+            options.serveAddress = argv[++i];
+            continue;
+        }
+        if (arg == "--connect") {
+            options.connectAddress = argv[++i];
+            continue;
+        }
+        if (arg == "--population") {
+            options.populationFile = argv[++i];
+            continue;
+        }
+        if (arg == "--write-population") {
+            options.writePopulationFile = argv[++i];
+            continue;
+        }
+        if (arg == "--placement") {
+            std::string_view name = argv[++i];
+            ScenarioConfig& scenario = options.simulation.scenario;
+            if (name == "uniform") {
+                scenario.placement = ScenarioPlacement::UNIFORM;
+            } else if (name == "clusters") {
+                scenario.placement = ScenarioPlacement::CLUSTERS;
+            } else if (name == "hot") {
+                scenario.placement = ScenarioPlacement::HOT_CELLS;
+            } else if (name == "stripes") {
+                scenario.placement = ScenarioPlacement::STRIPES;
+            } else {
+                std::cout << "Ошибка: неизвестная расстановка " << name << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if (arg == "--types" || arg == "--arrival-types") {
+            auto& weights = arg == "--types" ? options.simulation.typeWeights : options.simulation.arrivals.typeWeights;
+            options.arrivalsSet = options.arrivalsSet || arg == "--arrival-types";
+            if (!parseTypeWeights(argv[++i], weights)) {
+                std::cout << "Ошибка: ожидается соотношение типов вида 1:1:1, получено " << argv[i] << std::endl;
+                return false;
+            }
+            if (!typeWeightsValid(weights)) {
+                std::cout << "Ошибка: в " << arg << " хотя бы один вес должен быть больше нуля" << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if (arg == "--script") {
+            std::string_view name = argv[++i];
+            if (name == "greedy") {
+                options.simulation.script = ScriptKind::GREEDY_SCRIPT;
+            } else if (name == "patrol") {
+                options.simulation.script = ScriptKind::PATROL_SCRIPT;
+            } else {
+                std::cout << "Ошибка: неизвестный сценарий " << name << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if (arg == "--arrivals") {
+            std::string_view name = argv[++i];
+            if (name == "fixed") {
+                options.simulation.arrivals.mode = ArrivalMode::FIXED_RATE;
+            } else if (name == "poisson") {
+                options.simulation.arrivals.mode = ArrivalMode::POISSON;
+            } else {
+                std::cout << "Ошибка: неизвестный режим поступлений " << name << std::endl;
+                return false;
+            }
+            options.arrivalsSet = true;
+            continue;
+        }
+        if (arg == "--arrival-rate") {
+            char* end = nullptr;
+            double rate = std::strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || rate < 0) {
+                std::cout << "Ошибка: некорректное значение " << argv[i] << " для " << arg << std::endl;
+                return false;
+            }
+            options.simulation.arrivals.rate = rate;
+            options.arrivalsSet = true;
+            continue;
+        }
+        if (arg == "--rebalance-threshold") {
+            char* end = nullptr;
+            double threshold = std::strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || threshold < 1) {
+                std::cout << "Ошибка: некорректное значение " << argv[i] << " для " << arg << std::endl;
+                return false;
+            }
+            options.rebalanceThreshold = threshold;
+            continue;
+        }
+
+        // Остальные значения - числа.
+        std::optional<uint64_t> value = parseUint(argv[i + 1]);
+        if (!value) {
+            std::cout << "Ошибка: некорректное значение " << argv[i + 1] << " для " << arg << std::endl;
+            return false;
+        }
+        i++;
+
+        if (arg == "--width") {
+            options.simulation.width = *value;
+        } else if (arg == "--height") {
+            options.simulation.height = *value;
+        } else if (arg == "--ships") {
+            options.simulation.shipCount = *value;
+        } else if (arg == "--win-fish") {
+            options.simulation.winFishCount = *value;
+        } else if (arg == "--seed") {
+            options.simulation.seed = *value;
+            options.seedSet = true;
+        } else if (arg == "--clusters") {
+            options.simulation.scenario.clusters = *value;
+        } else if (arg == "--spread") {
+            options.simulation.scenario.spread = *value;
+        } else if (arg == "--hot-cells") {
+            options.simulation.scenario.hotCells = *value;
+        } else if (arg == "--stripes") {
+            options.simulation.scenario.stripes = *value;
+        } else if (arg == "--capacity") {
+            options.simulation.arrivals.capacity = *value;
+            options.arrivalsSet = true;
+        } else if (arg == "--scripts") {
+            options.simulation.scriptShips = *value;
+        } else if (arg == "--expiry-budget") {
+            options.simulation.expiryBudget = *value;
+        } else if (arg == "--tick-deadline-ms") {
+            options.tickDeadlineMs = *value;
+        } else if (arg == "--slow-ticks") {
+            options.slowTicks = *value;
+        } else if (arg == "--metrics-port") {
+            if (*value == 0 || *value > 65535) {
+                std::cout << "Ошибка: порт метрик должен быть от 1 до 65535" << std::endl;
+                return false;
+            }
+            options.metricsPort = *value;
+        } else if (arg == "--shards") {
+            options.shards = static_cast<unsigned>(*value);
+        } else if (arg == "--rebalance") {
+            options.rebalanceInterval = *value;
+        } else if (arg == "--bench") {
+            options.benchTicks = *value;
+        } else if (arg == "--soak") {
+            options.soakSeconds = *value;
+        } else if (arg == "--report-interval") {
+            options.reportIntervalSeconds = std::max<uint64_t>(1, *value);
+        } else if (arg == "--ensemble") {
+            options.ensemble = true;
+            options.runs = *value;
+        } else if (arg == "--threads") {
+            options.threads = static_cast<unsigned>(*value);
+        } else if (arg == "--max-ticks") {
+            options.maxTicks = *value;
+        } else {
+            std::cout << "Ошибка: неизвестная опция " << arg << std::endl;
+            printUsage(std::cout);
+            return false;
+        }
+    }
+
+    if (!options.simulation.valid()) {
+        std::cout << "Ошибка: параметры симуляции не помещаются в упакованное представление лодки" << std::endl;
+        return false;
+    }
+    bool publishesMetrics = options.benchTicks == 0 && options.shards == 0 && !options.ensemble
+        && options.sweepGrid.empty() && options.connectAddress.empty() && options.writePopulationFile.empty();
+    if (options.metricsPort > 0 && !publishesMetrics) {
+        // В остальных режимах снимок метрик не обновляется, и /metrics отдавал бы одни нули.
+        std::cout << "Ошибка: --metrics-port работает только в окне, --soak и --serve" << std::endl;
+        return false;
+    }
+    if (options.simulation.scriptShips > 0 && options.shards > 0) {
+        // Полосы обсчитывают только упакованные лодки.
+        std::cout << "Ошибка: лодки сценариев (--scripts) не поддерживаются в --shards" << std::endl;
+        return false;
+    }
+    if (options.arrivalsSet && options.shards > 0) {
+        // В полосах нет потока поступлений: ушедшая лодка просто исчезает.
+        std::cout << "Ошибка: поступления (--arrivals, --arrival-rate, --arrival-types, --respawn, --capacity)"
+                     " не поддерживаются в --shards" << std::endl;
+        return false;
+    }
+    return true;
+}
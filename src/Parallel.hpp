@@ -0,0 +1,179 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Привязывает текущий поток к ядру. На платформах без поддержки ничего не делает.
+inline void pinCurrentThread(unsigned core)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % CPU_SETSIZE, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)core;
+#endif
+}
+
+// Число потоков по умолчанию: 0 означает все ядра.
+inline unsigned resolveThreads(unsigned threads)
+{
+    return threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+/*
+Аллокатор, который не зануляет элементы при resize.
+std::vector<T> по умолчанию записывает нули во всю новую память в вызывающем потоке,
+и физические страницы достаются его NUMA-узлу. С этим аллокатором страницы
+впервые трогает тот поток, который заполняет свой кусок (first-touch).
+*/
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U>;
+    };
+
+    using std::allocator<T>::allocator;
+
+    template <typename U>
+    void construct(U* ptr) noexcept
+    {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* ptr, Args&&... args)
+    {
+        ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+};
+
+/*
+Делит диапазон [0, count) на непрерывные куски по числу потоков и вызывает
+fn(begin, end, thread) для каждого куска в своем потоке.
+Кусок с номером t всегда одинаков при одинаковых count и threads, а поток t закреплен за ядром t,
+поэтому память, впервые записанная потоком t, остается "его" и при следующих вызовах.
+*/
+template <typename Fn>
+void parallelFor(uint64_t count, unsigned threads, Fn&& fn)
+{
+    threads = static_cast<unsigned>(std::clamp<uint64_t>(threads, 1, std::max<uint64_t>(1, count)));
+    if (threads == 1) {
+        fn(uint64_t { 0 }, count, 0u);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned t = 0; t < threads; t++) {
+        uint64_t begin = count * t / threads;
+        uint64_t end = count * (t + 1) / threads;
+        workers.emplace_back([&fn, begin, end, t]() {
+            pinCurrentThread(t);
+            fn(begin, end, t);
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+/*
+Тройной буфер для передачи снимков от одного писателя одному читателю без блокировок.
+Писатель заполняет свой буфер и публикует его обменом с промежуточным, читатель забирает
+промежуточный обменом со своим. Ни одна сторона никогда не ждет другую, читатель всегда
+видит последний целиком опубликованный снимок.
+*/
+template <typename T>
+class TripleBuffer {
+public:
+    // Буфер писателя: заполняется между вызовами publish().
+    T& writeBuffer() noexcept { return m_buffers[m_back].value; }
+
+    void publish() noexcept
+    {
+        uint8_t previous = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel);
+        m_back = previous & INDEX_MASK;
+    }
+
+    // Забирает последний опубликованный снимок. Вернет false, если нового с прошлого раза не было.
+    bool update() noexcept
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        uint8_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& readBuffer() const noexcept { return m_buffers[m_front].value; }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 3;
+    // Промежуточный буфер опубликован и еще не забран читателем.
+    static constexpr uint8_t FRESH = 4;
+
+    // Каждый буфер на своих кеш-линиях, чтобы писатель и читатель не делили линию.
+    struct alignas(64) Slot {
+        T value {};
+    };
+
+    Slot m_buffers[3];
+    std::atomic<uint8_t> m_middle { 1 };
+    uint8_t m_back = 0;
+    uint8_t m_front = 2;
+};
+
+/*
+Кольцевая очередь одного писателя и одного читателя без блокировок.
+Все данные лежат внутри объекта, поэтому очередь, созданная в разделяемой памяти до fork,
+работает и между процессами: атомики без блокировок не зависят от адреса отображения.
+*/
+template <typename T, uint64_t CAPACITY>
+class SpscRing {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "емкость должна быть степенью двойки");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+public:
+    // Вернет false, если очередь заполнена.
+    bool push(const T& value) noexcept
+    {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        m_items[tail & (CAPACITY - 1)] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Вернет false, если очередь пуста.
+    bool pop(T& value) noexcept
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = m_items[head & (CAPACITY - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // Голова и хвост на разных кеш-линиях: их пишут разные стороны.
+    alignas(64) std::atomic<uint64_t> m_head { 0 };
+    alignas(64) std::atomic<uint64_t> m_tail { 0 };
+    alignas(64) T m_items[CAPACITY];
+};
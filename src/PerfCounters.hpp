@@ -0,0 +1,148 @@
+#pragma once
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Аппаратные события, которые считаются группой.
+enum PerfEvent {
+    CYCLES = 0,
+    INSTRUCTIONS = 1,
+    // Промахи последнего уровня кеша (PERF_COUNT_HW_CACHE_MISSES).
+    LLC_MISSES = 2,
+    BRANCH_MISSES = 3,
+};
+constexpr int PERF_EVENT_COUNT = 4;
+
+using PerfValues = std::array<uint64_t, PERF_EVENT_COUNT>;
+
+inline const char* perfEventName(int event)
+{
+    static const char* names[PERF_EVENT_COUNT] = { "cycles", "instructions", "llc_misses", "branch_misses" };
+    return names[event];
+}
+
+/*
+Группа аппаратных счетчиков текущего потока через perf_event_open (только Linux).
+Счетчики открываются одной группой, чтобы все события считались на одном и том же
+интервале, и читаются одним системным вызовом. В контейнерах и виртуальных машинах
+счетчики часто недоступны (perf_event_paranoid, нет PMU) - тогда open вернет false
+с причиной, а события, которые не открылись по отдельности, читаются как 0.
+*/
+class PerfCounters {
+public:
+    PerfCounters() = default;
+    ~PerfCounters() { close(); }
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Открывает и запускает счетчики вызывающего потока. Вернет false, если не открылся ни один.
+    bool open(std::string& error);
+    void close();
+
+    bool available() const noexcept { return m_leader >= 0; }
+    bool has(int event) const noexcept { return m_fds[event] >= 0; }
+    // Значения счетчиков с момента open; недоступные события - 0.
+    PerfValues read() const;
+
+private:
+    std::array<int, PERF_EVENT_COUNT> m_fds { -1, -1, -1, -1 };
+    // Позиция события в ответе группового чтения.
+    std::array<int, PERF_EVENT_COUNT> m_readIndex { -1, -1, -1, -1 };
+    int m_leader = -1;
+    int m_opened = 0;
+};
+
+inline bool PerfCounters::open(std::string& error)
+{
+    close();
+#ifdef __linux__
+    static const uint64_t configs[PERF_EVENT_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    int firstErrno = 0;
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        perf_event_attr attr {};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[event];
+        attr.read_format = PERF_FORMAT_GROUP;
+        // Лидер создается остановленным и запускает всю группу разом.
+        attr.disabled = m_leader < 0 ? 1 : 0;
+        // Без ядра счетчики доступны и при perf_event_paranoid = 2.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, m_leader, 0));
+        if (fd < 0) {
+            if (firstErrno == 0) {
+                firstErrno = errno;
+            }
+            continue;
+        }
+        m_fds[event] = fd;
+        m_readIndex[event] = m_opened++;
+        if (m_leader < 0) {
+            m_leader = fd;
+        }
+    }
+    if (m_leader < 0) {
+        error = std::string("perf_event_open: ") + std::strerror(firstErrno)
+            + " (нет доступа к аппаратным счетчикам: kernel.perf_event_paranoid или контейнер без PMU)";
+        return false;
+    }
+    ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    error = "аппаратные счетчики поддерживаются только в Linux";
+    return false;
+#endif
+}
+
+inline void PerfCounters::close()
+{
+#ifdef __linux__
+    for (int& fd : m_fds) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        fd = -1;
+    }
+#endif
+    m_readIndex.fill(-1);
+    m_leader = -1;
+    m_opened = 0;
+}
+
+inline PerfValues PerfCounters::read() const
+{
+    PerfValues values {};
+#ifdef __linux__
+    if (m_leader < 0) {
+        return values;
+    }
+    // Ответ группового чтения: число событий, затем значения в порядке открытия.
+    uint64_t buffer[1 + PERF_EVENT_COUNT] = {};
+    if (::read(m_leader, buffer, sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t))) {
+        return values;
+    }
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        if (m_readIndex[event] >= 0 && static_cast<uint64_t>(m_readIndex[event]) < buffer[0]) {
+            values[event] = buffer[1 + m_readIndex[event]];
+        }
+    }
+#endif
+    return values;
+}
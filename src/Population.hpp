@@ -0,0 +1,286 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "CsvPopulation.hpp"
+#include "Parallel.hpp"
+#include "Ship.hpp"
+
+/*
+Бинарный файл начальной популяции.
+Заголовок 64 байта, за ним count упакованных лодок по 8 байт, все в little-endian:
+
+[8 байт - сигнатура "GFISHPOP"]
+[4 байта - версия формата]
+[4 байта - размер заголовка]
+[8 байт - ширина карты]
+[8 байт - высота карты]
+[8 байт - количество лодок]
+[24 байта - резерв]
+*/
+struct PopulationHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t width;
+    uint64_t height;
+    uint64_t count;
+    uint64_t reserved[3];
+};
+static_assert(sizeof(PopulationHeader) == 64);
+
+constexpr char POPULATION_MAGIC[8] = { 'G', 'F', 'I', 'S', 'H', 'P', 'O', 'P' };
+constexpr uint32_t POPULATION_VERSION = 1;
+
+/*
+Проверяет упакованную лодку из файла: паддинг пуст, у живой лодки положение не дальше
+positionBound и улов не больше maxFish, у рыбачащей таймер от 1 до 3.
+Слово мертвой лодки - пустой слот, его остальные поля не читаются.
+*/
+inline bool validPopulationShip(uint64_t ship, uint64_t positionBound, uint64_t maxFish)
+{
+    const uint64_t state = (ship >> STATE_SHIFT) & MASK_2BIT;
+    if (state == ShipState::DEAD) {
+        return true;
+    }
+    const uint64_t timer = (ship >> TIMER_SHIFT) & MASK_2BIT;
+    return (ship >> (OFFSET_Y_SHIFT + 4)) == 0
+        && ((ship >> POSITION_SHIFT) & MASK_34BIT) <= positionBound
+        && ((ship >> FISH_SHIFT) & MASK_14BIT) <= maxFish
+        && (state != ShipState::FISHING || timer > 0);
+}
+
+/*
+Файл, целиком отображенный в память только для чтения.
+На POSIX используется mmap, на остальных платформах файл читается в буфер.
+*/
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool openFromFile(const std::string& path, std::string& error);
+    void close();
+
+    const char* data() const noexcept { return m_data; }
+    uint64_t size() const noexcept { return m_size; }
+
+private:
+    const char* m_data = nullptr;
+    uint64_t m_size = 0;
+    void* m_mapping = nullptr;
+    std::vector<char> m_buffer;
+};
+
+inline MappedFile::~MappedFile()
+{
+    close();
+}
+
+inline void MappedFile::close()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (m_mapping) {
+        munmap(m_mapping, m_size);
+    }
+#endif
+    m_mapping = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+    m_buffer.clear();
+}
+
+inline bool MappedFile::openFromFile(const std::string& path, std::string& error)
+{
+    close();
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "не удалось открыть файл " + path;
+        return false;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        error = "не удалось открыть файл " + path;
+        return false;
+    }
+    if (st.st_size > 0) {
+        void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            error = "не удалось отобразить в память файл " + path;
+            return false;
+        }
+        // Файл читается один раз подряд, подсказываем ядру читать с опережением.
+        madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+        m_mapping = mapping;
+        m_data = static_cast<const char*>(mapping);
+        m_size = st.st_size;
+    }
+    ::close(fd);
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        error = "не удалось открыть файл " + path;
+        return false;
+    }
+    m_buffer.resize(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(m_buffer.data(), m_buffer.size());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#endif
+    return true;
+}
+
+/*
+Открытый файл начальной популяции: бинарный или CSV.
+Формат определяется по сигнатуре. Бинарный файл остается отображенным в память
+и копируется в массив лодок напрямую, CSV разбирается параллельно сразу в упакованные лодки.
+*/
+class PopulationFile {
+public:
+    /*
+    Открывает файл и проверяет его. Для CSV размер карты и прочие параметры берутся из csv,
+    для бинарного файла - из заголовка, а из csv только maxFish и threads для проверки лодок.
+    При ошибке заполняет error и возвращает false.
+    */
+    bool openFromFile(const std::string& path, const CsvParseOptions& csv, std::string& error);
+
+    uint64_t width() const noexcept { return m_header.width; }
+    uint64_t height() const noexcept { return m_header.height; }
+    uint64_t count() const noexcept { return m_header.count; }
+
+    // Копирует лодки в dst, разбив работу на threads потоков (first-touch целевой памяти).
+    void copyTo(uint64_t* dst, unsigned threads) const;
+    /*
+    Лодки на месте, без копирования: отображенный файл или разобранный CSV.
+    Действительны, пока файл открыт; после fork страницы общие с дочерними процессами.
+    */
+    const uint64_t* ships() const noexcept { return m_ships; }
+
+private:
+    bool openBinary(const std::string& path, const CsvParseOptions& csv, std::string& error);
+
+    PopulationHeader m_header {};
+    const uint64_t* m_ships = nullptr;
+    MappedFile m_file;
+    // Разобранные лодки из CSV.
+    ShipArray m_parsed;
+};
+
+inline bool PopulationFile::openFromFile(const std::string& path, const CsvParseOptions& csv, std::string& error)
+{
+    m_ships = nullptr;
+    m_parsed.clear();
+    if (!m_file.openFromFile(path, error)) {
+        return false;
+    }
+
+    if (m_file.size() >= sizeof(POPULATION_MAGIC) && std::memcmp(m_file.data(), POPULATION_MAGIC, sizeof(POPULATION_MAGIC)) == 0) {
+        return openBinary(path, csv, error);
+    }
+
+    // Все остальное разбираем как CSV.
+    if (!parseShipsCsv(m_file.data(), m_file.size(), csv, m_parsed, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    m_file.close();
+    m_header = PopulationHeader {};
+    m_header.width = csv.width;
+    m_header.height = csv.height;
+    m_header.count = m_parsed.size();
+    m_ships = m_parsed.data();
+    return true;
+}
+
+inline bool PopulationFile::openBinary(const std::string& path, const CsvParseOptions& csv, std::string& error)
+{
+    uint64_t fileSize = m_file.size();
+    if (fileSize < sizeof(PopulationHeader)) {
+        error = path + ": не является файлом популяции";
+        return false;
+    }
+    std::memcpy(&m_header, m_file.data(), sizeof(PopulationHeader));
+    if (m_header.version != POPULATION_VERSION || m_header.headerSize != sizeof(PopulationHeader)) {
+        error = path + ": неподдерживаемая версия формата " + std::to_string(m_header.version);
+        return false;
+    }
+    if (m_header.width == 0 || m_header.height == 0 || m_header.width > MASK_34BIT || m_header.height > MASK_34BIT
+        || m_header.width * m_header.height - 1 > MASK_34BIT) {
+        error = path + ": размер карты не помещается в упакованное представление лодки";
+        return false;
+    }
+    if (m_header.count > (fileSize - sizeof(PopulationHeader)) / sizeof(uint64_t)
+        || fileSize != sizeof(PopulationHeader) + m_header.count * sizeof(uint64_t)) {
+        error = path + ": размер файла не совпадает с количеством лодок в заголовке";
+        return false;
+    }
+    m_ships = reinterpret_cast<const uint64_t*>(m_file.data() + sizeof(PopulationHeader));
+
+    // Проверяем каждую лодку, как и строки CSV: битое слово сломало бы симуляцию молча.
+    const uint64_t positionBound = m_header.width * m_header.height - 1;
+    unsigned threads = m_header.count < (1 << 16) ? 1 : resolveThreads(csv.threads);
+    std::vector<uint64_t> badShips(threads, UINT64_MAX);
+    parallelFor(m_header.count, threads, [&](uint64_t begin, uint64_t end, unsigned t) {
+        for (uint64_t i = begin; i < end; i++) {
+            if (!validPopulationShip(m_ships[i], positionBound, csv.maxFish)) {
+                badShips[t] = i;
+                return;
+            }
+        }
+    });
+    for (uint64_t index : badShips) {
+        if (index != UINT64_MAX) {
+            m_ships = nullptr;
+            error = path + ": некорректная лодка " + std::to_string(index)
+                + " (положение вне карты, улов больше победного или неверный таймер)";
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void PopulationFile::copyTo(uint64_t* dst, unsigned threads) const
+{
+    // Мелкие популяции быстрее скопировать в одном потоке, чем запускать потоки.
+    threads = m_header.count < (1 << 16) ? 1 : resolveThreads(threads);
+    parallelFor(m_header.count, threads, [&](uint64_t begin, uint64_t end, unsigned) {
+        std::memcpy(dst + begin, m_ships + begin, (end - begin) * sizeof(uint64_t));
+    });
+}
+
+// Записывает популяцию в бинарный файл. При ошибке заполняет error и возвращает false.
+inline bool writePopulationFile(const std::string& path, uint64_t width, uint64_t height, const ShipArray& ships, std::string& error)
+{
+    PopulationHeader header {};
+    std::memcpy(header.magic, POPULATION_MAGIC, sizeof(POPULATION_MAGIC));
+    header.version = POPULATION_VERSION;
+    header.headerSize = sizeof(PopulationHeader);
+    header.width = width;
+    header.height = height;
+    header.count = ships.size();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(ships.data()), ships.size() * sizeof(uint64_t));
+    if (!out) {
+        error = "не удалось записать файл " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+
+// Финализатор splitmix64: хорошо перемешивает биты, соседние входы дают независимые выходы.
+inline uint64_t mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*
+Счетчиковый генератор: случайное число зависит только от сида, номера объекта и номера потока значений.
+В отличие от std::mt19937, значения для любой лодки можно получить в любом порядке
+и из любого потока, и они не зависят от того, как работа поделена между потоками.
+*/
+inline uint64_t counterRandom(uint64_t seed, uint64_t index, uint64_t stream)
+{
+    return mix64(seed ^ mix64(index * 0x9E3779B97F4A7C15ULL + stream));
+}
+
+// Равномерное число в [0, bound) из 64 случайных бит (умножение вместо деления по модулю).
+inline uint64_t randomBelow(uint64_t random, uint64_t bound)
+{
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(random) * bound) >> 64);
+}
+
+// Равномерное число в [0, 1).
+inline double randomUnit(uint64_t random)
+{
+    return static_cast<double>(random >> 11) * 0x1.0p-53;
+}
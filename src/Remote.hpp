@@ -0,0 +1,752 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "CellTable.hpp"
+#include "Latency.hpp"
+#include "MetricsServer.hpp"
+#include "Net.hpp"
+#include "Ship.hpp"
+#include "Simulation.hpp"
+
+/*
+Протокол удаленного просмотра: симуляция идет на одной машине, окно - на другой (или в другом процессе).
+
+Кадр: [u32 LE - длина нагрузки][u8 - тип][нагрузка]. Числа в нагрузке - varint (LEB128),
+поэтому малые значения занимают 1-2 байта. Сервер шлет HELLO при подключении,
+клиент отвечает VIEWPORT с прямоугольником клеток, который он рисует.
+На новую область сервер отвечает SNAPSHOT со всеми клетками и лодками в ней,
+а дальше после каждого тика - DELTA только с изменениями внутри области из журнала симуляции.
+Поэтому трафик растет с числом видимых изменений, а не с размером популяции.
+
+HELLO:    width, height
+VIEWPORT: x, y, width, height
+SNAPSHOT, DELTA: tick, число клеток, клетки, число лодок, лодки.
+  Клетка: разность позиции с предыдущей клеткой кадра (клетки отсортированы), байт рыбы
+  или REMOTE_CELL_REMOVED.
+  Лодка: слот, позиция, байт тип | состояние << 2. Состояние DEAD - лодка ушла из области или с карты.
+*/
+enum RemoteFrameType {
+    HELLO = 1,
+    SNAPSHOT = 2,
+    DELTA = 3,
+    VIEWPORT = 4,
+};
+
+constexpr uint8_t REMOTE_CELL_REMOVED = 0xFF;
+/*
+Клиент удаляет клетки только по кадрам сервера. Он хранит их с тиком истечения
+REMOTE_VIEW_TICK + 1 и смотрит на них с тика REMOTE_VIEW_TICK, так что все они живые.
+*/
+constexpr uint32_t REMOTE_VIEW_TICK = 0;
+// Кадр длиннее считается признаком поврежденного потока.
+constexpr uint32_t REMOTE_MAX_FRAME = 1u << 30;
+// Сколько неотправленных байт может накопиться у клиента, прежде чем изменения для него перестанут копиться.
+constexpr std::size_t REMOTE_MAX_PENDING = 16u << 20;
+
+inline void putVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Начинает кадр, оставляя место под длину. Вернет начало кадра для endFrame.
+inline std::size_t beginFrame(std::string& out, RemoteFrameType type)
+{
+    std::size_t start = out.size();
+    out.append(4, '\0');
+    out.push_back(static_cast<char>(type));
+    return start;
+}
+
+inline void endFrame(std::string& out, std::size_t start)
+{
+    uint32_t length = static_cast<uint32_t>(out.size() - start - 5);
+    for (int i = 0; i < 4; i++) {
+        out[start + i] = static_cast<char>(length >> (8 * i));
+    }
+}
+
+// Чтение нагрузки кадра. При выходе за конец ok становится false, а значения читаются нулями.
+struct FrameReader {
+    const uint8_t* data = nullptr;
+    std::size_t size = 0;
+    std::size_t pos = 0;
+    bool ok = true;
+
+    uint8_t byte()
+    {
+        if (pos >= size) {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+};
+
+/*
+Вызывает fn(type, reader) для каждого полного кадра в начале buffer и удаляет их из буфера.
+Неполный кадр остается ждать остальных байт. Вернет false, если поток поврежден.
+*/
+template <typename Fn>
+inline bool takeFrames(std::string& buffer, Fn&& fn)
+{
+    std::size_t offset = 0;
+    while (buffer.size() - offset >= 5) {
+        const uint8_t* header = reinterpret_cast<const uint8_t*>(buffer.data() + offset);
+        uint32_t length = header[0] | header[1] << 8 | header[2] << 16 | static_cast<uint32_t>(header[3]) << 24;
+        if (length > REMOTE_MAX_FRAME) {
+            return false;
+        }
+        if (buffer.size() - offset - 5 < length) {
+            break;
+        }
+        FrameReader reader { header + 5, length };
+        if (!fn(static_cast<RemoteFrameType>(header[4]), reader) || !reader.ok) {
+            return false;
+        }
+        offset += 5 + length;
+    }
+    buffer.erase(0, offset);
+    return true;
+}
+
+// Прямоугольник клеток, который рисует клиент.
+struct RemoteViewport {
+    uint64_t x = 0;
+    uint64_t y = 0;
+    uint64_t width = 0;
+    uint64_t height = 0;
+
+    bool contains(uint64_t position, uint64_t mapWidth) const noexcept
+    {
+        uint64_t px = position % mapWidth;
+        uint64_t py = position / mapWidth;
+        return px >= x && px - x < width && py >= y && py - y < height;
+    }
+};
+
+// Тип и состояние лодки одним байтом протокола.
+inline uint8_t remoteShipByte(uint64_t ship)
+{
+    return static_cast<uint8_t>((ship & MASK_2BIT) | ((ship >> STATE_SHIFT) & MASK_2BIT) << 2);
+}
+
+/*
+Сервер удаленного просмотра. Работает в потоке тиков без своих потоков: между тиками
+service() принимает подключения, читает запросы и дописывает буферы отправки, не блокируясь,
+а publish() после тика кладет каждому клиенту снимок или изменения его области.
+Медленный клиент не задерживает тики: когда у него копится больше REMOTE_MAX_PENDING байт,
+изменения для него пропускаются, а после того как буфер уйдет, он получает свежий снимок.
+Симуляции нужен включенный журнал (setJournalEnabled).
+*/
+class RemoteServer {
+public:
+    RemoteServer() = default;
+    ~RemoteServer() { stop(); }
+    RemoteServer(const RemoteServer&) = delete;
+    RemoteServer& operator=(const RemoteServer&) = delete;
+
+    bool start(const std::string& address, std::string& error);
+    void stop();
+    bool running() const noexcept { return m_listenFd >= 0; }
+
+    // Обслуживает подключения до момента until. Вызывается между тиками.
+    void service(const Simulation& sim, std::chrono::steady_clock::time_point until);
+    // Отправляет клиентам снимки и изменения последнего тика. Вызывается после step().
+    void publish(const Simulation& sim);
+
+    uint64_t clientCount() const noexcept { return m_clients.size(); }
+    uint64_t bytesSent() const noexcept { return m_bytesSent; }
+
+private:
+    struct Client {
+        int fd = -1;
+        std::string in;
+        std::string out;
+        // Сколько байт начала out уже отправлено.
+        std::size_t sent = 0;
+        RemoteViewport viewport;
+        bool hasViewport = false;
+        bool needSnapshot = false;
+        bool closed = false;
+
+        std::size_t pending() const noexcept { return out.size() - sent; }
+    };
+
+    void accept(const Simulation& sim);
+    void receive(Client& client);
+    void flush(Client& client);
+    void dropClosed();
+    void encodeSnapshot(std::string& out, const Simulation& sim, const RemoteViewport& viewport);
+    void encodeDelta(std::string& out, const Simulation& sim, const RemoteViewport& viewport);
+    // Сводит клетки журнала к последнему изменению каждой клетки, по возрастанию позиции.
+    void collectCellChanges(const Simulation& sim);
+
+    int m_listenFd = -1;
+    std::string m_unixPath;
+    std::vector<Client> m_clients;
+    std::vector<CellChange> m_cellChanges;
+    std::vector<std::pair<uint64_t, uint8_t>> m_snapshotCells;
+    std::string m_scratch;
+    uint64_t m_bytesSent = 0;
+};
+
+inline bool RemoteServer::start(const std::string& address, std::string& error)
+{
+    m_listenFd = listenAddress(address, error);
+    if (m_listenFd < 0) {
+        return false;
+    }
+    m_unixPath = address.rfind("unix:", 0) == 0 ? address.substr(5) : std::string();
+    return true;
+}
+
+inline void RemoteServer::stop()
+{
+    if (m_listenFd < 0) {
+        return;
+    }
+    for (Client& client : m_clients) {
+        close(client.fd);
+    }
+    m_clients.clear();
+    close(m_listenFd);
+    m_listenFd = -1;
+    if (!m_unixPath.empty()) {
+        unlink(m_unixPath.c_str());
+    }
+}
+
+inline void RemoteServer::service(const Simulation& sim, std::chrono::steady_clock::time_point until)
+{
+    using Clock = std::chrono::steady_clock;
+    std::vector<pollfd> fds;
+    while (true) {
+        fds.clear();
+        fds.push_back({ m_listenFd, POLLIN, 0 });
+        for (const Client& client : m_clients) {
+            fds.push_back({ client.fd, static_cast<short>(POLLIN | (client.pending() > 0 ? POLLOUT : 0)), 0 });
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(until - Clock::now()).count();
+        if (::poll(fds.data(), fds.size(), static_cast<int>(std::max<int64_t>(0, left))) > 0) {
+            for (std::size_t i = 0; i < m_clients.size(); i++) {
+                short events = fds[i + 1].revents;
+                if (events & (POLLIN | POLLHUP | POLLERR)) {
+                    receive(m_clients[i]);
+                }
+                if (events & POLLOUT) {
+                    flush(m_clients[i]);
+                }
+            }
+            if (fds[0].revents & POLLIN) {
+                accept(sim);
+            }
+            dropClosed();
+        }
+        if (Clock::now() >= until) {
+            return;
+        }
+    }
+}
+
+inline void RemoteServer::accept(const Simulation& sim)
+{
+    int fd = acceptClient(m_listenFd);
+    if (fd < 0) {
+        return;
+    }
+    Client client;
+    client.fd = fd;
+    std::size_t frame = beginFrame(client.out, RemoteFrameType::HELLO);
+    putVarint(client.out, sim.config().width);
+    putVarint(client.out, sim.config().height);
+    endFrame(client.out, frame);
+    m_clients.push_back(std::move(client));
+    flush(m_clients.back());
+}
+
+inline void RemoteServer::receive(Client& client)
+{
+    char buffer[4096];
+    while (true) {
+        ssize_t received = recv(client.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (received > 0) {
+            client.in.append(buffer, received);
+            continue;
+        }
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            client.closed = true;
+            return;
+        }
+        if (errno != EINTR) {
+            break;
+        }
+    }
+
+    bool valid = takeFrames(client.in, [&](RemoteFrameType type, FrameReader& reader) {
+        if (type != RemoteFrameType::VIEWPORT) {
+            return false;
+        }
+        client.viewport.x = reader.varint();
+        client.viewport.y = reader.varint();
+        client.viewport.width = reader.varint();
+        client.viewport.height = reader.varint();
+        // Новая область - клиенту нужен ее снимок, старые изменения к ней не относятся.
+        client.hasViewport = true;
+        client.needSnapshot = true;
+        return true;
+    });
+    if (!valid) {
+        client.closed = true;
+    }
+}
+
+inline void RemoteServer::flush(Client& client)
+{
+    while (client.pending() > 0) {
+        ssize_t sent = sendNow(client.fd, client.out.data() + client.sent, client.pending());
+        if (sent > 0) {
+            client.sent += static_cast<std::size_t>(sent);
+            m_bytesSent += static_cast<uint64_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        client.closed = true;
+        return;
+    }
+    if (client.sent == client.out.size()) {
+        client.out.clear();
+        client.sent = 0;
+    } else if (client.sent > client.out.size() / 2) {
+        client.out.erase(0, client.sent);
+        client.sent = 0;
+    }
+}
+
+inline void RemoteServer::dropClosed()
+{
+    for (std::size_t i = 0; i < m_clients.size();) {
+        if (m_clients[i].closed) {
+            close(m_clients[i].fd);
+            m_clients[i] = std::move(m_clients.back());
+            m_clients.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+inline void RemoteServer::publish(const Simulation& sim)
+{
+    bool collected = false;
+    for (Client& client : m_clients) {
+        if (!client.hasViewport) {
+            continue;
+        }
+        if (client.needSnapshot) {
+            // Снимок ждет, пока уйдут уже накопленные байты, чтобы не раздувать буфер.
+            if (client.pending() > 0) {
+                continue;
+            }
+            encodeSnapshot(client.out, sim, client.viewport);
+            client.needSnapshot = false;
+        } else if (client.pending() > REMOTE_MAX_PENDING) {
+            // Клиент не успевает: пропускаем изменения и потом пришлем снимок целиком.
+            client.needSnapshot = true;
+            continue;
+        } else {
+            if (!collected) {
+                collectCellChanges(sim);
+                collected = true;
+            }
+            encodeDelta(client.out, sim, client.viewport);
+        }
+        flush(client);
+    }
+    dropClosed();
+}
+
+inline void RemoteServer::collectCellChanges(const Simulation& sim)
+{
+    const std::vector<CellChange>& cells = sim.journal().cells;
+    m_cellChanges.assign(cells.begin(), cells.end());
+    // Устойчивая сортировка сохраняет порядок изменений одной клетки, берем последнее.
+    std::stable_sort(m_cellChanges.begin(), m_cellChanges.end(), [](const CellChange& a, const CellChange& b) {
+        return a.cell < b.cell;
+    });
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < m_cellChanges.size(); i++) {
+        if (i + 1 < m_cellChanges.size() && m_cellChanges[i + 1].cell == m_cellChanges[i].cell) {
+            continue;
+        }
+        m_cellChanges[kept++] = m_cellChanges[i];
+    }
+    m_cellChanges.resize(kept);
+}
+
+inline void RemoteServer::encodeSnapshot(std::string& out, const Simulation& sim, const RemoteViewport& viewport)
+{
+    const uint64_t mapWidth = sim.config().width;
+    std::size_t frame = beginFrame(out, RemoteFrameType::SNAPSHOT);
+    putVarint(out, sim.tick() - 1);
+
+    // Клетки таблицы лежат в порядке хешей, для разностного кодирования их нужно упорядочить.
+    m_snapshotCells.clear();
+    // Истекшие клетки из очереди удалений в снимок не попадают: в журнале они уже удалены.
+    sim.cells().forEachLive(sim.cellsTick(), [&](uint64_t cell, uint8_t fish) {
+        if (viewport.contains(cell, mapWidth)) {
+            m_snapshotCells.emplace_back(cell, fish);
+        }
+    });
+    std::sort(m_snapshotCells.begin(), m_snapshotCells.end());
+    putVarint(out, m_snapshotCells.size());
+    uint64_t previous = 0;
+    for (const auto& [cell, fish] : m_snapshotCells) {
+        putVarint(out, cell - previous);
+        out.push_back(static_cast<char>(fish));
+        previous = cell;
+    }
+
+    m_scratch.clear();
+    uint64_t count = 0;
+    const ShipArray& ships = sim.ships();
+    for (uint64_t slot = 0; slot < ships.size(); slot++) {
+        uint64_t ship = ships[slot];
+        uint64_t position = (ship >> POSITION_SHIFT) & MASK_34BIT;
+        if (((ship >> STATE_SHIFT) & MASK_2BIT) == ShipState::DEAD || !viewport.contains(position, mapWidth)) {
+            continue;
+        }
+        putVarint(m_scratch, slot);
+        putVarint(m_scratch, position);
+        m_scratch.push_back(static_cast<char>(remoteShipByte(ship)));
+        count++;
+    }
+    putVarint(out, count);
+    out += m_scratch;
+    endFrame(out, frame);
+}
+
+inline void RemoteServer::encodeDelta(std::string& out, const Simulation& sim, const RemoteViewport& viewport)
+{
+    const uint64_t mapWidth = sim.config().width;
+    std::size_t frame = beginFrame(out, RemoteFrameType::DELTA);
+    putVarint(out, sim.tick() - 1);
+
+    m_scratch.clear();
+    uint64_t count = 0;
+    uint64_t previous = 0;
+    for (const CellChange& change : m_cellChanges) {
+        if (!viewport.contains(change.cell, mapWidth)) {
+            continue;
+        }
+        putVarint(m_scratch, change.cell - previous);
+        m_scratch.push_back(static_cast<char>(change.removed ? REMOTE_CELL_REMOVED : change.fish));
+        previous = change.cell;
+        count++;
+    }
+    putVarint(out, count);
+    out += m_scratch;
+
+    auto visible = [&](uint64_t ship) {
+        return ((ship >> STATE_SHIFT) & MASK_2BIT) != ShipState::DEAD
+            && viewport.contains((ship >> POSITION_SHIFT) & MASK_34BIT, mapWidth);
+    };
+    m_scratch.clear();
+    count = 0;
+    for (const ShipChange& change : sim.journal().ships) {
+        uint64_t ship;
+        if (visible(change.after)) {
+            ship = change.after;
+        } else if (visible(change.before)) {
+            // Лодка ушла из области: клиент удаляет ее по состоянию DEAD.
+            ship = DEAD_SHIP;
+        } else {
+            continue;
+        }
+        putVarint(m_scratch, change.slot);
+        putVarint(m_scratch, (ship >> POSITION_SHIFT) & MASK_34BIT);
+        m_scratch.push_back(static_cast<char>(remoteShipByte(ship)));
+        count++;
+    }
+    putVarint(out, count);
+    out += m_scratch;
+    endFrame(out, frame);
+}
+
+/*
+Клиент удаленного просмотра: копия клеток и лодок видимой области, которую рисует Renderer.
+Лодки хранятся плотным массивом в формате симуляции (тип, состояние и положение),
+а номер слота на сервере сопоставляется индексу в массиве.
+*/
+class RemoteView {
+public:
+    RemoteView() = default;
+    ~RemoteView() { disconnect(); }
+    RemoteView(const RemoteView&) = delete;
+    RemoteView& operator=(const RemoteView&) = delete;
+
+    // Подключается и ждет HELLO с размером карты.
+    bool connect(const std::string& address, std::string& error);
+    void disconnect();
+
+    /*
+    Запрашивает область, если видимая часть карты вышла за уже запрошенную.
+    Запрашивается область с запасом в половину видимой с каждой стороны,
+    чтобы небольшая прокрутка не требовала нового снимка.
+    */
+    void requestViewport(uint64_t x, uint64_t y, uint64_t width, uint64_t height);
+    // Читает пришедшие кадры без блокировки и применяет их. Вернет false, если соединение закрыто.
+    bool receive(std::string& error);
+
+    uint64_t width() const noexcept { return m_width; }
+    uint64_t height() const noexcept { return m_height; }
+    uint64_t tick() const noexcept { return m_tick; }
+    uint64_t bytesReceived() const noexcept { return m_bytesReceived; }
+    const CellTable& cells() const noexcept { return m_cells; }
+    const ShipArray& ships() const noexcept { return m_ships; }
+
+private:
+    bool apply(RemoteFrameType type, FrameReader& reader);
+    void setShip(uint64_t slot, uint64_t position, uint8_t typeState);
+
+    int m_fd = -1;
+    std::string m_in;
+    uint64_t m_width = 0;
+    uint64_t m_height = 0;
+    uint64_t m_tick = 0;
+    uint64_t m_bytesReceived = 0;
+    RemoteViewport m_requested;
+    bool m_hasRequest = false;
+
+    CellTable m_cells;
+    ShipArray m_ships;
+    // Слот лодки на сервере для каждого индекса m_ships и обратное соответствие.
+    std::vector<uint64_t> m_slots;
+    std::unordered_map<uint64_t, uint64_t> m_indexBySlot;
+};
+
+inline bool RemoteView::connect(const std::string& address, std::string& error)
+{
+    disconnect();
+    m_fd = connectAddress(address, error);
+    if (m_fd < 0) {
+        return false;
+    }
+    // Первым кадром сервер присылает размер карты, без него нельзя создать окно.
+    while (m_width == 0) {
+        if (!waitReadable(m_fd, 5000)) {
+            error = "сервер " + address + " не прислал приветствие";
+            disconnect();
+            return false;
+        }
+        if (!receive(error)) {
+            disconnect();
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void RemoteView::disconnect()
+{
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+inline void RemoteView::requestViewport(uint64_t x, uint64_t y, uint64_t width, uint64_t height)
+{
+    if (m_hasRequest && x >= m_requested.x && y >= m_requested.y
+        && x + width <= m_requested.x + m_requested.width && y + height <= m_requested.y + m_requested.height) {
+        return;
+    }
+    uint64_t left = x - std::min(x, width / 2);
+    uint64_t top = y - std::min(y, height / 2);
+    m_requested.x = left;
+    m_requested.y = top;
+    m_requested.width = std::min(m_width, x + width + width / 2) - left;
+    m_requested.height = std::min(m_height, y + height + height / 2) - top;
+    m_hasRequest = true;
+
+    std::string out;
+    std::size_t frame = beginFrame(out, RemoteFrameType::VIEWPORT);
+    putVarint(out, m_requested.x);
+    putVarint(out, m_requested.y);
+    putVarint(out, m_requested.width);
+    putVarint(out, m_requested.height);
+    endFrame(out, frame);
+    sendAll(m_fd, out.data(), out.size());
+}
+
+inline bool RemoteView::receive(std::string& error)
+{
+    char buffer[65536];
+    while (true) {
+        ssize_t received = recv(m_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (received > 0) {
+            m_in.append(buffer, received);
+            m_bytesReceived += static_cast<uint64_t>(received);
+            continue;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            error = "соединение с сервером закрыто";
+            return false;
+        }
+        break;
+    }
+    if (!takeFrames(m_in, [&](RemoteFrameType type, FrameReader& reader) { return apply(type, reader); })) {
+        error = "поврежденный кадр от сервера";
+        return false;
+    }
+    return true;
+}
+
+inline bool RemoteView::apply(RemoteFrameType type, FrameReader& reader)
+{
+    switch (type) {
+    case RemoteFrameType::HELLO: {
+        m_width = reader.varint();
+        m_height = reader.varint();
+        return m_width > 0 && m_height > 0;
+    }
+    case RemoteFrameType::SNAPSHOT:
+    case RemoteFrameType::DELTA: {
+        if (type == RemoteFrameType::SNAPSHOT) {
+            m_cells.clear();
+            m_ships.clear();
+            m_slots.clear();
+            m_indexBySlot.clear();
+        }
+        m_tick = reader.varint();
+        uint64_t cellCount = reader.varint();
+        uint64_t cell = 0;
+        for (uint64_t i = 0; i < cellCount && reader.ok; i++) {
+            cell += reader.varint();
+            uint8_t fish = reader.byte();
+            if (fish == REMOTE_CELL_REMOVED) {
+                m_cells.erase(cell);
+            } else {
+                m_cells.activate(cell, fish, REMOTE_VIEW_TICK + 1);
+            }
+        }
+        uint64_t shipCount = reader.varint();
+        for (uint64_t i = 0; i < shipCount && reader.ok; i++) {
+            uint64_t slot = reader.varint();
+            uint64_t position = reader.varint();
+            setShip(slot, position, reader.byte());
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+inline void RemoteView::setShip(uint64_t slot, uint64_t position, uint8_t typeState)
+{
+    auto found = m_indexBySlot.find(slot);
+    if (((typeState >> 2) & MASK_2BIT) == ShipState::DEAD) {
+        if (found == m_indexBySlot.end()) {
+            return;
+        }
+        // Удаляем перестановкой последней лодки на место удаленной.
+        uint64_t index = found->second;
+        m_indexBySlot.erase(found);
+        if (index + 1 != m_ships.size()) {
+            m_ships[index] = m_ships.back();
+            m_slots[index] = m_slots.back();
+            m_indexBySlot[m_slots[index]] = index;
+        }
+        m_ships.pop_back();
+        m_slots.pop_back();
+        return;
+    }
+
+    uint64_t ship = 0;
+    ship = setbits(ship, 0, MASK_2BIT, typeState & MASK_2BIT);
+    ship = setbits(ship, STATE_SHIFT, MASK_2BIT, (typeState >> 2) & MASK_2BIT);
+    ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, position);
+    if (found != m_indexBySlot.end()) {
+        m_ships[found->second] = ship;
+        return;
+    }
+    m_indexBySlot.emplace(slot, m_ships.size());
+    m_ships.push_back(ship);
+    m_slots.push_back(slot);
+}
+
+// Параметры симуляции без окна с удаленным просмотром.
+struct ServeConfig {
+    SimulationConfig simulation;
+    std::string address;
+    // Темп тиков, как у окна.
+    uint64_t tickMs = 100;
+    uint64_t tickDeadlineMs = 100;
+    // Если задан, после каждого тика в него публикуется снимок метрик.
+    MetricsServer* metrics = nullptr;
+};
+
+/*
+Симуляция без окна в темпе окна: между тиками сервер обслуживает клиентов --connect,
+после тика рассылает им изменения. Идет, пока на карте есть лодки.
+*/
+inline bool runServe(const ServeConfig& config, std::ostream& out, std::string& error)
+{
+    using Clock = std::chrono::steady_clock;
+    RemoteServer server;
+    if (!server.start(config.address, error)) {
+        return false;
+    }
+    out << "Удаленный просмотр: " << config.address << std::endl;
+
+    Simulation sim(config.simulation);
+    sim.setJournalEnabled(true);
+    TickProfiler profiler(config.tickDeadlineMs * 1'000'000, 0);
+    auto nextTick = Clock::now();
+    while (!sim.finished()) {
+        nextTick += std::chrono::milliseconds(config.tickMs);
+        server.service(sim, nextTick);
+
+        auto tickStart = Clock::now();
+        sim.step();
+        profiler.recordTick(sim.tick() - 1, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - tickStart).count(), sim.phaseNs());
+        if (config.metrics != nullptr) {
+            config.metrics->publish(sim, profiler);
+        }
+        server.publish(sim);
+    }
+    return true;
+}
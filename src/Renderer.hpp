@@ -6,25 +6,29 @@
 #include <SFML/Graphics.hpp>
 #include <cstdint>
 #include <vector>
-#include <unordered_map>
 #include <algorithm>
 #include <cassert>
 
+#include "CellTable.hpp"
+#include "Ship.hpp"
+
 class Renderer {
 public:
-    using CellMap = std::unordered_map<uint64_t, uint8_t>;
-    using ShipArray = std::vector<uint64_t>;
+    using CellMap = CellTable;
 
     Renderer(sf::RenderWindow& window, uint32_t gridW, uint32_t gridH, unsigned int cellSizePx = 8u, float initialZoom = 1.0f);
 
     void handleEvent(const std::optional<sf::Event>& event);
 
-    void drawScene(const CellMap& activeCells, const ShipArray& ships);
+    // Рисует клетки, не истекшие к тику tick (истекшие могут еще ждать удаления), и лодки.
+    void drawScene(const CellMap& activeCells, uint32_t tick, const ShipArray& ships);
 
     void setViewCenter(const sf::Vector2f& worldCenter);
     void setZoom(float zoom);
     float getZoom() const noexcept { return m_zoom; }
     sf::View getView() const noexcept { return m_view; }
+    // Прямоугольник клеток, попадающий в текущий вид, обрезанный по границам карты.
+    void getVisibleCells(uint64_t& x, uint64_t& y, uint64_t& w, uint64_t& h) const;
 
 private:
     void ensureCellVertexCapacity(std::size_t cellsCount);
@@ -136,7 +140,7 @@ inline void Renderer::handleEvent(const std::optional<sf::Event>& event)
     }
 }
 
-inline void Renderer::drawScene(const CellMap& activeCells, const ShipArray& ships)
+inline void Renderer::drawScene(const CellMap& activeCells, uint32_t tick, const ShipArray& ships)
 {
     bool rightDown = sf::Mouse::isButtonPressed(sf::Mouse::Button::Left);
     sf::Vector2i mousePix = sf::Mouse::getPosition(m_window);
@@ -173,9 +177,7 @@ inline void Renderer::drawScene(const CellMap& activeCells, const ShipArray& shi
     std::vector<sf::Vertex> verts;
     verts.reserve(std::min<std::size_t>(activeCells.size() * 6, 65536));
 
-    for (const auto& kv : activeCells) {
-        uint64_t pos = kv.first;
-        uint8_t fish = kv.second;
+    activeCells.forEachLive(tick, [&](uint64_t pos, uint8_t fish) {
         uint64_t x = pos % m_gridW;
         uint64_t y = pos / m_gridW;
 
@@ -192,7 +194,7 @@ inline void Renderer::drawScene(const CellMap& activeCells, const ShipArray& shi
         float viewBottom = viewTop + viewRect.size.y;
 
         if (right < viewLeft || left > viewRight || bottom < viewTop || top > viewBottom) {
-            continue;
+            return;
         }
 
         sf::Color col = fishColorFromAmount(fish);
@@ -204,7 +206,7 @@ inline void Renderer::drawScene(const CellMap& activeCells, const ShipArray& shi
         verts.emplace_back(sf::Vector2f(left, top), col);
         verts.emplace_back(sf::Vector2f(right, bottom), col);
         verts.emplace_back(sf::Vector2f(left, bottom), col);
-    }
+    });
 
     if (!verts.empty()) {
         m_cellsVA.resize(verts.size());
@@ -304,6 +306,22 @@ inline void Renderer::drawScene(const CellMap& activeCells, const ShipArray& shi
     m_window.draw(border);
 }
 
+inline void Renderer::getVisibleCells(uint64_t& x, uint64_t& y, uint64_t& w, uint64_t& h) const
+{
+    float cellSizeWorld = static_cast<float>(m_baseCellSizePx);
+    sf::Vector2f topLeft = m_view.getCenter() - m_view.getSize() * 0.5f;
+    sf::Vector2f bottomRight = m_view.getCenter() + m_view.getSize() * 0.5f;
+
+    auto toCell = [&](float world, uint32_t bound) {
+        float cell = std::floor(world / cellSizeWorld);
+        return static_cast<uint64_t>(std::clamp(cell, 0.f, static_cast<float>(bound - 1)));
+    };
+    x = toCell(topLeft.x, m_gridW);
+    y = toCell(topLeft.y, m_gridH);
+    w = toCell(bottomRight.x, m_gridW) - x + 1;
+    h = toCell(bottomRight.y, m_gridH) - y + 1;
+}
+
 inline void Renderer::setViewCenter(const sf::Vector2f& worldCenter)
 {
     m_view.setCenter(worldCenter);
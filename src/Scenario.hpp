@@ -0,0 +1,199 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#include "Parallel.hpp"
+#include "Random.hpp"
+#include "Ship.hpp"
+
+// Способ начальной расстановки лодок.
+enum ScenarioPlacement {
+    // Равномерно по всей карте.
+    UNIFORM = 0,
+    // Гауссовы облака вокруг случайных центров.
+    CLUSTERS = 1,
+    // Все лодки на нескольких клетках - максимальная конкуренция за клетку.
+    HOT_CELLS = 2,
+    // Полосы строк вдоль границ горизонтальных разбиений карты.
+    STRIPES = 3,
+};
+
+// Параметры начальной расстановки.
+struct ScenarioConfig {
+    ScenarioPlacement placement = ScenarioPlacement::UNIFORM;
+    // CLUSTERS: число центров и стандартное отклонение облака в клетках.
+    uint64_t clusters = 16;
+    uint64_t spread = 50;
+    // HOT_CELLS: число клеток, на которые ставятся все лодки.
+    uint64_t hotCells = 8;
+    // STRIPES: число полос и сколько строк по каждую сторону от границы занимают лодки.
+    uint64_t stripes = 8;
+    uint64_t stripeRows = 2;
+    // Потоков для генерации, 0 - все ядра.
+    unsigned threads = 0;
+};
+
+/*
+Генератор начальных лодок.
+Каждая лодка вычисляется только из сида и своего номера через counterRandom,
+поэтому результат не зависит ни от числа потоков, ни от порядка генерации.
+*/
+class ShipGenerator {
+public:
+    ShipGenerator(const ScenarioConfig& scenario, uint64_t width, uint64_t height,
+        const std::array<uint32_t, SHIP_TYPE_COUNT>& typeWeights, uint64_t seed);
+
+    // Лодка с номером index, сразу в режиме рыбалки.
+    uint64_t operator()(uint64_t index) const;
+
+    // Заполняет ships[begin, end) лодками с номерами firstIndex + (i - begin).
+    void fill(uint64_t* ships, uint64_t begin, uint64_t end, uint64_t firstIndex = 0) const;
+
+    // Заполняет count лодок параллельно.
+    void fillParallel(uint64_t* ships, uint64_t count, uint64_t firstIndex = 0) const;
+
+    /*
+    Ограничивает расстановку прямоугольником карты с левым верхним углом (x, y).
+    Все способы расстановки работают внутри него, как на отдельной карте;
+    прямоугольник, выходящий за край, заворачивается на другую сторону.
+    */
+    void setRegion(uint64_t x, uint64_t y, uint64_t width, uint64_t height);
+
+private:
+    // Номера потоков значений counterRandom.
+    enum Stream {
+        TYPE = 0,
+        TIMER = 1,
+        GROUP = 2,
+        X = 3,
+        Y = 4,
+        ANGLE = 5,
+    };
+
+    uint64_t position(uint64_t index) const;
+    uint64_t wrap(int64_t value, uint64_t bound) const;
+
+    ScenarioConfig m_scenario;
+    // Размер области расстановки (по умолчанию вся карта) и ее положение на карте.
+    uint64_t m_width;
+    uint64_t m_height;
+    uint64_t m_originX = 0;
+    uint64_t m_originY = 0;
+    uint64_t m_mapWidth;
+    uint64_t m_mapHeight;
+    uint64_t m_seed;
+    // Сид для центров облаков и горячих клеток, отдельный от сида лодок.
+    uint64_t m_groupSeed;
+    // Накопленные веса типов: тип t выбирается, если случайное число < m_typeBounds[t].
+    std::array<uint64_t, SHIP_TYPE_COUNT> m_typeBounds;
+};
+
+inline ShipGenerator::ShipGenerator(const ScenarioConfig& scenario, uint64_t width, uint64_t height,
+    const std::array<uint32_t, SHIP_TYPE_COUNT>& typeWeights, uint64_t seed)
+    : m_scenario(scenario)
+    , m_width(width)
+    , m_height(height)
+    , m_mapWidth(width)
+    , m_mapHeight(height)
+    , m_seed(seed)
+    , m_groupSeed(mix64(seed ^ 0x5CE7A210ULL))
+{
+    uint64_t total = 0;
+    for (int type = 0; type < SHIP_TYPE_COUNT; type++) {
+        total += typeWeights[type];
+        m_typeBounds[type] = total;
+    }
+    m_scenario.clusters = std::max<uint64_t>(1, m_scenario.clusters);
+    m_scenario.hotCells = std::max<uint64_t>(1, m_scenario.hotCells);
+    m_scenario.stripes = std::max<uint64_t>(1, m_scenario.stripes);
+}
+
+inline void ShipGenerator::setRegion(uint64_t x, uint64_t y, uint64_t width, uint64_t height)
+{
+    m_originX = x % m_mapWidth;
+    m_originY = y % m_mapHeight;
+    m_width = std::clamp<uint64_t>(width, 1, m_mapWidth);
+    m_height = std::clamp<uint64_t>(height, 1, m_mapHeight);
+}
+
+inline uint64_t ShipGenerator::wrap(int64_t value, uint64_t bound) const
+{
+    int64_t r = value % static_cast<int64_t>(bound);
+    return static_cast<uint64_t>(r < 0 ? r + static_cast<int64_t>(bound) : r);
+}
+
+inline uint64_t ShipGenerator::position(uint64_t index) const
+{
+    switch (m_scenario.placement) {
+    case ScenarioPlacement::UNIFORM:
+        break;
+    case ScenarioPlacement::CLUSTERS: {
+        // Центр облака - случайная клетка, общая для всех лодок облака.
+        uint64_t cluster = randomBelow(counterRandom(m_seed, index, Stream::GROUP), m_scenario.clusters);
+        int64_t cx = randomBelow(counterRandom(m_groupSeed, cluster, Stream::X), m_width);
+        int64_t cy = randomBelow(counterRandom(m_groupSeed, cluster, Stream::Y), m_height);
+
+        // Преобразование Бокса-Мюллера: нормальное смещение из двух равномерных чисел.
+        double u = 1.0 - randomUnit(counterRandom(m_seed, index, Stream::X));
+        double angle = 2.0 * 3.14159265358979323846 * randomUnit(counterRandom(m_seed, index, Stream::ANGLE));
+        double radius = std::sqrt(-2.0 * std::log(u)) * static_cast<double>(m_scenario.spread);
+        uint64_t x = wrap(cx + std::llround(radius * std::cos(angle)), m_width);
+        uint64_t y = wrap(cy + std::llround(radius * std::sin(angle)), m_height);
+        return y * m_width + x;
+    }
+    case ScenarioPlacement::HOT_CELLS: {
+        uint64_t cell = randomBelow(counterRandom(m_seed, index, Stream::GROUP), m_scenario.hotCells);
+        return randomBelow(counterRandom(m_groupSeed, cell, Stream::X), m_width * m_height);
+    }
+    case ScenarioPlacement::STRIPES: {
+        // Граница полосы k проходит по строке k * height / stripes.
+        uint64_t stripe = randomBelow(counterRandom(m_seed, index, Stream::GROUP), m_scenario.stripes);
+        int64_t boundary = stripe * m_height / m_scenario.stripes;
+        int64_t rows = 2 * std::max<uint64_t>(1, m_scenario.stripeRows);
+        int64_t row = boundary - rows / 2 + randomBelow(counterRandom(m_seed, index, Stream::Y), rows);
+        uint64_t x = randomBelow(counterRandom(m_seed, index, Stream::X), m_width);
+        return wrap(row, m_height) * m_width + x;
+    }
+    }
+    return randomBelow(counterRandom(m_seed, index, Stream::X), m_width * m_height);
+}
+
+inline uint64_t ShipGenerator::operator()(uint64_t index) const
+{
+    uint64_t typeRandom = randomBelow(counterRandom(m_seed, index, Stream::TYPE), m_typeBounds.back());
+    uint64_t shipType = 0;
+    // Граница защищает от нулевых весов: тогда typeRandom == 0 и тип остается последним.
+    while (shipType < SHIP_TYPE_COUNT - 1 && typeRandom >= m_typeBounds[shipType]) {
+        shipType++;
+    }
+    uint64_t timer = 1 + randomBelow(counterRandom(m_seed, index, Stream::TIMER), 3);
+
+    uint64_t ship = 0;
+    ship |= shipType; // Тип лодки.
+    ship |= ShipState::FISHING << STATE_SHIFT; // Состояние лодки.
+    ship |= timer << TIMER_SHIFT; // Таймер ожидания конца улова.
+    // Позиция внутри области переводится в позицию на карте.
+    uint64_t local = position(index);
+    uint64_t x = (m_originX + local % m_width) % m_mapWidth;
+    uint64_t y = (m_originY + local / m_width) % m_mapHeight;
+    ship |= (y * m_mapWidth + x) << POSITION_SHIFT; // Позиция лодки.
+    return ship;
+}
+
+inline void ShipGenerator::fill(uint64_t* ships, uint64_t begin, uint64_t end, uint64_t firstIndex) const
+{
+    for (uint64_t i = begin; i < end; i++) {
+        ships[i] = (*this)(firstIndex + i - begin);
+    }
+}
+
+inline void ShipGenerator::fillParallel(uint64_t* ships, uint64_t count, uint64_t firstIndex) const
+{
+    // Мелкие популяции быстрее заполнить в одном потоке, чем запускать потоки.
+    unsigned threads = count < (1 << 16) ? 1 : resolveThreads(m_scenario.threads);
+    parallelFor(count, threads, [&](uint64_t begin, uint64_t end, unsigned) {
+        fill(ships, begin, end, firstIndex + begin);
+    });
+}
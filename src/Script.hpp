@@ -0,0 +1,377 @@
+#pragma once
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Random.hpp"
+
+/*
+Сценарии лодок на корутинах C++20 - для исследовательских поведений, которые неудобно
+записывать автоматом в 64-битном слове лодки. Сценарий - функция, которая возвращает ShipScript
+и первым параметром принимает ScriptShip&:
+
+    ShipScript myScript(ScriptShip& ship)
+    {
+        co_await moveTo(10, 20);
+        ScriptCatch result = co_await fish();
+        co_await ticks(5);
+    }
+
+Сценарий не трогает карту сам: co_await ставит лодке действие и возвращает управление
+планировщику симуляции, который выполняет действие по тику за раз по тем же правилам, что
+и для обычных лодок, и продолжает сценарий, когда действие закончено. Лодка, набравшая
+рыбу для победы, больше не продолжается и уплывает с карты, как и лодка, чей сценарий закончился.
+
+Кадры корутин берутся из FramePool, а не из кучи: пул держит списки свободных блоков
+по размеру, и закончившийся сценарий отдает кадр следующему. Продолжение сценария
+не выделяет память вовсе - кадр уже лежит в пуле.
+*/
+
+/*
+Пул кадров корутин. Блоки выдаются кусками по CHUNK_BYTES и после освобождения
+попадают в список своего класса размера (кратного CLASS_STEP), откуда их берут следующие кадры.
+Кадры одной функции-сценария всегда одного размера, поэтому классов немного.
+Пул не потокобезопасен: у каждой симуляции свой.
+*/
+class FramePool {
+public:
+    FramePool() = default;
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    void* allocate(std::size_t size);
+    void deallocate(void* block, std::size_t size) noexcept;
+
+    // Сколько кусков взято из кучи, сколько кадров выдано всего и сколько выдано сейчас.
+    uint64_t chunks() const noexcept { return m_chunks.size(); }
+    uint64_t frames() const noexcept { return m_frames; }
+    uint64_t liveFrames() const noexcept { return m_liveFrames; }
+    uint64_t memoryBytes() const noexcept { return m_chunkBytes + m_free.capacity() * sizeof(FreeBlock*); }
+
+private:
+    static constexpr std::size_t CLASS_STEP = 64;
+    static constexpr std::size_t CHUNK_BYTES = 64 * 1024;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    // Голова списка свободных блоков для каждого класса размера.
+    std::vector<FreeBlock*> m_free;
+    std::vector<std::unique_ptr<std::byte[]>> m_chunks;
+    std::byte* m_cursor = nullptr;
+    std::byte* m_chunkEnd = nullptr;
+    uint64_t m_chunkBytes = 0;
+    uint64_t m_frames = 0;
+    uint64_t m_liveFrames = 0;
+};
+
+// Действие, которое лодка сценария выполняет сейчас.
+enum ScriptAction {
+    // Ждет, пока не пройдут тики wait.
+    WAIT = 0,
+    // Плывет к клетке targetX, targetY по клетке за тик.
+    MOVE = 1,
+    // Рыбачит: таймер wait, потом улов.
+    FISH = 2,
+    // Победила или закончила сценарий и уплывает с карты.
+    LEAVE = 3,
+};
+
+// Результат co_await fish(): сколько выловлено и сколько рыбы осталось на клетке.
+struct ScriptCatch {
+    uint8_t caught = 0;
+    uint8_t cellFish = 0;
+};
+
+class ScriptShip;
+
+/*
+Корутина сценария. Начинается приостановленной: первый раз ее продолжает планировщик.
+Кадр выделяется из пула лодки - первого параметра сценария.
+*/
+class ShipScript {
+public:
+    struct promise_type {
+        ScriptShip* ship;
+
+        template <typename... Args>
+        promise_type(ScriptShip& ship, Args&...) noexcept
+            : ship(&ship)
+        {
+        }
+
+        template <typename... Args>
+        static void* operator new(std::size_t size, ScriptShip& ship, Args&...);
+        static void operator delete(void* frame, std::size_t size) noexcept;
+
+        ShipScript get_return_object() noexcept { return ShipScript(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept { }
+        // Исключений в проекте нет, поэтому сценарий, бросивший исключение, - ошибка программы.
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    ShipScript() = default;
+    ShipScript(ShipScript&& other) noexcept
+        : m_handle(std::exchange(other.m_handle, {}))
+    {
+    }
+    ShipScript& operator=(ShipScript&& other) noexcept;
+    ~ShipScript() { reset(); }
+
+    bool running() const noexcept { return m_handle && !m_handle.done(); }
+    void resume() const { m_handle.resume(); }
+    // Уничтожает кадр, возвращая его в пул.
+    void reset() noexcept;
+
+private:
+    explicit ShipScript(Handle handle) noexcept
+        : m_handle(handle)
+    {
+    }
+
+    Handle m_handle;
+};
+
+// Общее для всех лодок сценариев одной симуляции.
+struct ScriptWorld {
+    uint64_t width = 0;
+    uint64_t height = 0;
+    FramePool pool;
+};
+
+/*
+Лодка, которой управляет сценарий. Координаты хранятся раздельно, без упаковки:
+таких лодок немного, а сценарию удобнее x и y.
+*/
+class ScriptShip {
+public:
+    uint64_t x = 0;
+    uint64_t y = 0;
+    uint64_t fish = 0;
+    // Цель действия MOVE.
+    uint64_t targetX = 0;
+    uint64_t targetY = 0;
+    ScriptAction action = ScriptAction::WAIT;
+    // Оставшиеся тики ожидания или таймер рыбалки.
+    uint32_t wait = 0;
+    // Слот клетки в таблице, запомненный при последней рыбалке.
+    uint32_t cellSlot = UINT32_MAX;
+    ScriptCatch lastCatch;
+    bool alive = false;
+    ScriptWorld* world = nullptr;
+    ShipScript script;
+
+    // Случайное число в [0, bound) из собственного генератора лодки (splitmix64).
+    uint64_t random(uint64_t bound) noexcept
+    {
+        m_rng += 0x9E3779B97F4A7C15ULL;
+        return randomBelow(mix64(m_rng), bound);
+    }
+    void seed(uint64_t seed) noexcept { m_rng = seed; }
+    // Координата, прижатая к краям карты.
+    uint64_t clampX(int64_t value) const noexcept { return clamp(value, world->width); }
+    uint64_t clampY(int64_t value) const noexcept { return clamp(value, world->height); }
+
+private:
+    static uint64_t clamp(int64_t value, uint64_t size) noexcept
+    {
+        return static_cast<uint64_t>(std::clamp<int64_t>(value, 0, static_cast<int64_t>(size) - 1));
+    }
+
+    uint64_t m_rng = 0;
+};
+
+// co_await ticks(n): пропустить n тиков.
+struct TicksAwaiter {
+    uint32_t ticks;
+
+    bool await_ready() const noexcept { return ticks == 0; }
+    void await_suspend(ShipScript::Handle handle) const noexcept
+    {
+        ScriptShip& ship = *handle.promise().ship;
+        ship.action = ScriptAction::WAIT;
+        ship.wait = ticks;
+    }
+    void await_resume() const noexcept { }
+};
+
+// co_await moveTo(x, y): плыть до клетки; прибытие занимает тик, как у обычной лодки.
+struct MoveAwaiter {
+    uint64_t x;
+    uint64_t y;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(ShipScript::Handle handle) const noexcept
+    {
+        ScriptShip& ship = *handle.promise().ship;
+        ship.action = ScriptAction::MOVE;
+        ship.targetX = std::min(x, ship.world->width - 1);
+        ship.targetY = std::min(y, ship.world->height - 1);
+    }
+    void await_resume() const noexcept { }
+};
+
+// co_await fish(): закинуть сеть на текущей клетке и дождаться улова.
+struct FishAwaiter {
+    ScriptShip* ship = nullptr;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(ShipScript::Handle handle) noexcept
+    {
+        ship = handle.promise().ship;
+        ship->action = ScriptAction::FISH;
+        // Таймер рыбалки выбирает планировщик из генератора симуляции.
+        ship->wait = 0;
+    }
+    ScriptCatch await_resume() const noexcept { return ship->lastCatch; }
+};
+
+inline TicksAwaiter ticks(uint32_t count) noexcept { return { count }; }
+inline MoveAwaiter moveTo(uint64_t x, uint64_t y) noexcept { return { x, y }; }
+inline FishAwaiter fish() noexcept { return {}; }
+
+// Встроенные сценарии (--script).
+enum ScriptKind {
+    // Повторяет жадную лодку - для сравнения с автоматом в слове лодки.
+    GREEDY_SCRIPT = 0,
+    // Обходит квадрат вокруг места появления, задерживаясь на богатых углах.
+    PATROL_SCRIPT = 1,
+};
+
+// Жадная лодка: рыбачит, пока на клетке есть рыба, потом плывет к случайной клетке в радиусе 8.
+inline ShipScript greedyScript(ScriptShip& ship)
+{
+    for (;;) {
+        while ((co_await fish()).cellFish > 0) {
+        }
+        int64_t offsetX = static_cast<int64_t>(ship.random(16)) - 8;
+        int64_t offsetY = static_cast<int64_t>(ship.random(16)) - 8;
+        co_await moveTo(ship.clampX(static_cast<int64_t>(ship.x) + offsetX), ship.clampY(static_cast<int64_t>(ship.y) + offsetY));
+    }
+}
+
+/*
+Патрульный обходит углы квадрата 2*radius вокруг места появления. На углу он рыбачит,
+пока улов не меньше трех, а после круга отдыхает тем дольше, чем меньше поймал за круг.
+Такое поведение требует счетчиков и вложенных циклов, которых нет в слове лодки.
+*/
+inline ShipScript patrolScript(ScriptShip& ship, int64_t radius)
+{
+    const int64_t homeX = static_cast<int64_t>(ship.x);
+    const int64_t homeY = static_cast<int64_t>(ship.y);
+    static constexpr int64_t CORNERS[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+    for (;;) {
+        uint64_t lapCatch = 0;
+        for (const auto& corner : CORNERS) {
+            co_await moveTo(ship.clampX(homeX + corner[0] * radius), ship.clampY(homeY + corner[1] * radius));
+            for (;;) {
+                ScriptCatch result = co_await fish();
+                lapCatch += result.caught;
+                if (result.caught < 3) {
+                    break;
+                }
+            }
+        }
+        co_await ticks(static_cast<uint32_t>(40 / (1 + lapCatch / 8)));
+    }
+}
+
+// Запускает встроенный сценарий kind для лодки.
+inline ShipScript startScript(ScriptKind kind, ScriptShip& ship)
+{
+    switch (kind) {
+    case ScriptKind::PATROL_SCRIPT:
+        return patrolScript(ship, 6);
+    case ScriptKind::GREEDY_SCRIPT:
+    default:
+        return greedyScript(ship);
+    }
+}
+
+inline void* FramePool::allocate(std::size_t size)
+{
+    std::size_t sizeClass = (size + CLASS_STEP - 1) / CLASS_STEP;
+    if (sizeClass < m_free.size() && m_free[sizeClass] != nullptr) {
+        FreeBlock* block = m_free[sizeClass];
+        m_free[sizeClass] = block->next;
+        m_frames++;
+        m_liveFrames++;
+        return block;
+    }
+
+    std::size_t bytes = sizeClass * CLASS_STEP;
+    if (m_cursor == nullptr || static_cast<std::size_t>(m_chunkEnd - m_cursor) < bytes) {
+        // Остаток текущего куска меньше блока и пропадает: кадры мелкие, а куски большие.
+        std::size_t chunkBytes = std::max(CHUNK_BYTES, bytes);
+        m_chunks.push_back(std::make_unique<std::byte[]>(chunkBytes));
+        m_cursor = m_chunks.back().get();
+        m_chunkEnd = m_cursor + chunkBytes;
+        m_chunkBytes += chunkBytes;
+    }
+    void* block = m_cursor;
+    m_cursor += bytes;
+    m_frames++;
+    m_liveFrames++;
+    return block;
+}
+
+inline void FramePool::deallocate(void* block, std::size_t size) noexcept
+{
+    std::size_t sizeClass = (size + CLASS_STEP - 1) / CLASS_STEP;
+    if (sizeClass >= m_free.size()) {
+        // Список класса появляется при первом освобождении; дальше кадры этого размера идут по кругу.
+        m_free.resize(sizeClass + 1, nullptr);
+    }
+    FreeBlock* freed = static_cast<FreeBlock*>(block);
+    freed->next = m_free[sizeClass];
+    m_free[sizeClass] = freed;
+    m_liveFrames--;
+}
+
+/*
+Перед кадром лежит указатель на пул: operator delete получает только адрес и размер кадра.
+Заголовок выровнен как max_align_t, чтобы не сбить выравнивание кадра.
+*/
+constexpr std::size_t SCRIPT_FRAME_HEADER = alignof(std::max_align_t);
+
+template <typename... Args>
+inline void* ShipScript::promise_type::operator new(std::size_t size, ScriptShip& ship, Args&...)
+{
+    FramePool* pool = &ship.world->pool;
+    std::byte* block = static_cast<std::byte*>(pool->allocate(size + SCRIPT_FRAME_HEADER));
+    *reinterpret_cast<FramePool**>(block) = pool;
+    return block + SCRIPT_FRAME_HEADER;
+}
+
+inline void ShipScript::promise_type::operator delete(void* frame, std::size_t size) noexcept
+{
+    std::byte* block = static_cast<std::byte*>(frame) - SCRIPT_FRAME_HEADER;
+    FramePool* pool = *reinterpret_cast<FramePool**>(block);
+    pool->deallocate(block, size + SCRIPT_FRAME_HEADER);
+}
+
+inline ShipScript& ShipScript::operator=(ShipScript&& other) noexcept
+{
+    if (this != &other) {
+        reset();
+        m_handle = std::exchange(other.m_handle, {});
+    }
+    return *this;
+}
+
+inline void ShipScript::reset() noexcept
+{
+    if (m_handle) {
+        m_handle.destroy();
+        m_handle = {};
+    }
+}
@@ -0,0 +1,576 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Parallel.hpp"
+#include "Simulation.hpp"
+#include "Stripe.hpp"
+
+constexpr unsigned MAX_SHARDS = 64;
+// Емкость очереди переходящих лодок между соседними полосами.
+constexpr uint64_t SHARD_RING_CAPACITY = 1 << 16;
+using ShardRing = SpscRing<StripeShip, SHARD_RING_CAPACITY>;
+// Емкость очереди клеток, которые полосы передают друг другу при сдвиге границ.
+constexpr uint64_t SHARD_CELL_RING_CAPACITY = 1 << 14;
+using ShardCellRing = SpscRing<StripeCell, SHARD_CELL_RING_CAPACITY>;
+
+// Параметры прогона, поделенного на горизонтальные полосы.
+struct ShardedConfig {
+    SimulationConfig simulation;
+    unsigned shards = 2;
+    // Полосы в потоках одного процесса вместо отдельных процессов.
+    bool threads = false;
+    uint64_t maxTicks = 1'000'000;
+    // Раз в столько тиков координатор сравнивает время полос и сдвигает границы; 0 - не сдвигать.
+    uint64_t rebalanceInterval = 0;
+    // Границы сдвигаются, только если самая медленная полоса медленнее средней в столько раз.
+    double rebalanceThreshold = 1.1;
+    // Координатор ведет эталонный прогон одной полосой и сверяет с ним хеш каждого тика.
+    bool verify = false;
+};
+
+// Отчет полосы за последний тик. Пишет только ее процесс, читает координатор между барьерами.
+struct alignas(64) ShardReport {
+    StripeStats stats;
+    uint64_t rowBegin = 0;
+    uint64_t rowEnd = 0;
+    uint64_t tickNs = 0;
+    // Хеш состояния полосы после приема лодок тика (см. shipStateHash); пишется до второго барьера.
+    uint64_t hash = 0;
+    // Лодки и клетки, отданные соседям при сдвигах границ, с начала прогона.
+    uint64_t movedShips = 0;
+    uint64_t movedCells = 0;
+};
+
+/*
+Барьер для процессов с общей памятью: последний пришедший открывает следующее поколение.
+Пока барьер закрыт, ожидающий вызывает whileWaiting (например, разбирает входящие очереди).
+*/
+struct ShardBarrier {
+    std::atomic<uint64_t> arrived { 0 };
+    std::atomic<uint64_t> generation { 0 };
+
+    template <typename Fn>
+    void arriveAndWait(uint64_t participants, Fn&& whileWaiting)
+    {
+        uint64_t current = generation.load(std::memory_order_acquire);
+        if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == participants) {
+            arrived.store(0, std::memory_order_relaxed);
+            generation.store(current + 1, std::memory_order_release);
+            return;
+        }
+        while (generation.load(std::memory_order_acquire) == current) {
+            whileWaiting();
+            sched_yield();
+        }
+    }
+};
+
+/*
+Общая память прогона, отображается до fork. За структурой лежат 2 * shards очередей лодок
+(очередь 2i - из полосы i в следующую, 2i + 1 - из полосы i в предыдущую), столько же
+очередей клеток с той же нумерацией и счетчики лодок по строкам карты.
+*/
+struct ShardShared {
+    ShardBarrier barrier;
+    std::atomic<bool> stop { false };
+    std::array<ShardReport, MAX_SHARDS> reports;
+    // Полоса i занимает строки [rows[i], rows[i + 1]). Координатор меняет границы между
+    // барьерами тика и увеличивает rowsEpoch, полосы сверяют его после второго барьера.
+    std::array<uint64_t, MAX_SHARDS + 1> rows {};
+    std::atomic<uint64_t> rowsEpoch { 0 };
+
+    ShardRing& ring(unsigned index) noexcept
+    {
+        return reinterpret_cast<ShardRing*>(reinterpret_cast<char*>(this) + ringsOffset())[index];
+    }
+    ShardCellRing& cellRing(unsigned shards, unsigned index) noexcept
+    {
+        return reinterpret_cast<ShardCellRing*>(reinterpret_cast<char*>(this) + cellRingsOffset(shards))[index];
+    }
+    uint32_t* rowShips(unsigned shards) noexcept
+    {
+        return reinterpret_cast<uint32_t*>(reinterpret_cast<char*>(this) + rowShipsOffset(shards));
+    }
+
+    static constexpr std::size_t alignUp(std::size_t offset, std::size_t alignment) noexcept
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+    static constexpr std::size_t ringsOffset() noexcept { return alignUp(sizeof(ShardShared), alignof(ShardRing)); }
+    static std::size_t cellRingsOffset(unsigned shards) noexcept
+    {
+        return alignUp(ringsOffset() + 2 * shards * sizeof(ShardRing), alignof(ShardCellRing));
+    }
+    static std::size_t rowShipsOffset(unsigned shards) noexcept
+    {
+        return cellRingsOffset(shards) + 2 * shards * sizeof(ShardCellRing);
+    }
+    static std::size_t bytes(unsigned shards, uint64_t height) noexcept
+    {
+        return rowShipsOffset(shards) + height * sizeof(uint32_t);
+    }
+};
+
+/*
+Тик полосы. Полоса считает свой тик, кладет ушедшие лодки в очереди соседей и приходит
+на первый барьер; пока другие не пришли, она разбирает свои входящие очереди, так что
+переполненная очередь не блокирует соседа. После первого барьера все лодки этого тика
+уже отправлены: полоса дочитывает очереди и приходит на второй барьер, после которого
+координатор уже решил, продолжать ли прогон. До второго барьера никто не начинает
+следующий тик, поэтому лодки следующего тика не смешиваются с лодками текущего.
+
+Если координатор сдвинул границы, после второго барьера полосы отдают соседям лодки и клетки
+ушедших строк и проходят еще одну пару барьеров так же, как с лодками тика.
+*/
+inline void runShardWorker(const ShardedConfig& config, ShardShared& shared, unsigned shard, const uint64_t* fleet)
+{
+    using Clock = std::chrono::steady_clock;
+    const unsigned shards = config.shards;
+    const uint64_t participants = shards + 1;
+    StripeSimulation stripe(config.simulation, shared.rows[shard], shared.rows[shard + 1]);
+    stripe.initShips(fleet, config.simulation.shipCount);
+
+    const unsigned prev = (shard + shards - 1) % shards;
+    const unsigned next = (shard + 1) % shards;
+    ShardRing& toNext = shared.ring(2 * shard);
+    ShardRing& toPrev = shared.ring(2 * shard + 1);
+    ShardRing& fromPrev = shared.ring(2 * prev);
+    ShardRing& fromNext = shared.ring(2 * next + 1);
+    ShardCellRing& cellsToNext = shared.cellRing(shards, 2 * shard);
+    ShardCellRing& cellsToPrev = shared.cellRing(shards, 2 * shard + 1);
+    ShardCellRing& cellsFromPrev = shared.cellRing(shards, 2 * prev);
+    ShardCellRing& cellsFromNext = shared.cellRing(shards, 2 * next + 1);
+    auto drain = [&]() {
+        StripeShip ship;
+        while (fromPrev.pop(ship)) {
+            stripe.receive(ship);
+        }
+        while (fromNext.pop(ship)) {
+            stripe.receive(ship);
+        }
+        StripeCell cell;
+        while (cellsFromPrev.pop(cell)) {
+            stripe.receiveCell(cell);
+        }
+        while (cellsFromNext.pop(cell)) {
+            stripe.receiveCell(cell);
+        }
+    };
+    auto send = [&](auto& ring, const auto& items) {
+        for (const auto& item : items) {
+            while (!ring.push(item)) {
+                drain();
+                sched_yield();
+            }
+        }
+    };
+
+    ShardReport& report = shared.reports[shard];
+    uint64_t rowsEpoch = 0;
+    while (true) {
+        auto start = Clock::now();
+        stripe.step();
+        report.tickNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        send(toNext, stripe.toNext());
+        send(toPrev, stripe.toPrev());
+        report.stats = stripe.stats();
+        report.rowBegin = stripe.rowBegin();
+        report.rowEnd = stripe.rowEnd();
+        if (config.rebalanceInterval > 0 && (stripe.tick() - 1) % config.rebalanceInterval == 0) {
+            stripe.countRowShips(shared.rowShips(shards));
+        }
+
+        shared.barrier.arriveAndWait(participants, drain);
+        drain();
+        report.hash = stripe.hash();
+        shared.barrier.arriveAndWait(participants, []() {});
+        if (shared.stop.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        if (shared.rowsEpoch.load(std::memory_order_acquire) != rowsEpoch) {
+            rowsEpoch = shared.rowsEpoch.load(std::memory_order_acquire);
+            stripe.setRows(shared.rows[shard], shared.rows[shard + 1]);
+            send(toNext, stripe.toNext());
+            send(toPrev, stripe.toPrev());
+            send(cellsToNext, stripe.cellsToNext());
+            send(cellsToPrev, stripe.cellsToPrev());
+            report.movedShips += stripe.toNext().size() + stripe.toPrev().size();
+            report.movedCells += stripe.cellsToNext().size() + stripe.cellsToPrev().size();
+            shared.barrier.arriveAndWait(participants, drain);
+            drain();
+            shared.barrier.arriveAndWait(participants, []() {});
+        }
+    }
+}
+
+/*
+Новые границы полос по стоимости строк: строка стоит столько, сколько в ней лодок, умноженное
+на время одной лодки в ее полосе за последний интервал. Граница i ставится туда, где сумма
+стоимостей строк выше нее достигает i / shards общей. Чтобы строки передавались только
+соседям за один обмен, граница не уходит за старые соседние границы; полосы не пустеют.
+Вернет false, если ни одна граница не сдвинулась.
+*/
+inline bool balanceRows(unsigned shards, uint64_t height, const uint32_t* rowShips, const uint64_t* intervalNs,
+    std::array<uint64_t, MAX_SHARDS + 1>& rows)
+{
+    std::vector<double> rowCost(height);
+    double total = 0;
+    for (unsigned shard = 0; shard < shards; shard++) {
+        uint64_t ships = 0;
+        for (uint64_t row = rows[shard]; row < rows[shard + 1]; row++) {
+            ships += rowShips[row];
+        }
+        double shipNs = ships > 0 ? static_cast<double>(intervalNs[shard]) / ships : 0.0;
+        for (uint64_t row = rows[shard]; row < rows[shard + 1]; row++) {
+            rowCost[row] = rowShips[row] * shipNs;
+            total += rowCost[row];
+        }
+    }
+    if (total <= 0) {
+        return false;
+    }
+
+    std::array<uint64_t, MAX_SHARDS + 1> balanced = rows;
+    double prefix = 0;
+    uint64_t row = 0;
+    for (unsigned boundary = 1; boundary < shards; boundary++) {
+        double target = total * boundary / shards;
+        while (row < height && prefix + rowCost[row] <= target) {
+            prefix += rowCost[row];
+            row++;
+        }
+        uint64_t low = std::max(rows[boundary - 1], balanced[boundary - 1] + 1);
+        uint64_t high = std::min(rows[boundary + 1], height - (shards - boundary));
+        balanced[boundary] = std::clamp(row, low, high);
+    }
+    if (balanced == rows) {
+        return false;
+    }
+    rows = balanced;
+    return true;
+}
+
+// Сводка координатора по тикам прогона.
+struct ShardedTotals {
+    uint64_t ticks = 0;
+    uint64_t exchangedShips = 0;
+    StripeStats last;
+    std::array<uint64_t, MAX_SHARDS> tickNsSum {};
+    std::array<uint64_t, MAX_SHARDS> tickNsMax {};
+    std::array<uint64_t, MAX_SHARDS> ships {};
+    uint64_t rebalances = 0;
+    uint64_t rebalanceNs = 0;
+    uint64_t movedRows = 0;
+    // Отношение самого долгого времени полосы к среднему за первый и последний интервалы.
+    double firstImbalance = 0;
+    double lastImbalance = 0;
+    // Сумма хешей полос после последнего тика.
+    uint64_t hash = 0;
+    // Первый тик, на котором хеш разошелся с эталоном; 0 - не расходился.
+    uint64_t divergedTick = 0;
+};
+
+// Хеш состояния для вывода: 16 шестнадцатеричных цифр.
+inline std::string formatStateHash(uint64_t hash)
+{
+    char text[19];
+    std::snprintf(text, sizeof(text), "0x%016llx", static_cast<unsigned long long>(hash));
+    return text;
+}
+
+/*
+Сверяет хеш тика с эталонным прогоном одной полосой. При расхождении печатает, какие полосы
+разошлись: для каждой эталон заново считает хеш ее строк.
+*/
+inline bool verifyShardHashes(const StripeSimulation& reference, const ShardShared& shared, unsigned shards,
+    uint64_t tick, uint64_t hash, std::ostream& out)
+{
+    if (reference.hash() == hash) {
+        return true;
+    }
+    out << "State hash mismatch at tick " << tick << ": expected " << formatStateHash(reference.hash()) << ", got " << formatStateHash(hash) << "\n";
+    for (unsigned shard = 0; shard < shards; shard++) {
+        const ShardReport& report = shared.reports[shard];
+        uint64_t expected = reference.hashRows(report.rowBegin, report.rowEnd);
+        if (expected != report.hash) {
+            out << "Shard " << shard << " diverged: rows " << report.rowBegin << "-" << report.rowEnd - 1
+                << ", expected " << formatStateHash(expected) << ", got " << formatStateHash(report.hash) << "\n";
+        }
+    }
+    out << std::flush;
+    return false;
+}
+
+/*
+Прогон, поделенный на shards горизонтальных полос, сначала одинаковой высоты. Каждая полоса -
+отдельный процесс (или поток с --shard-threads) со своими лодками и клетками, лодки между
+соседними полосами передаются через очереди в общей памяти на границе тиков.
+Координатор (вызывающий процесс) после каждого тика складывает отчеты полос и останавливает
+прогон, когда лодки закончились или достигнут maxTicks. С rebalanceInterval он раз в интервал
+сдвигает границы полос к равной стоимости (см. balanceRows).
+
+Каждый тик координатор складывает хеши полос в хеш карты; он совпадает с хешем прогона
+одной полосой. С verify координатор сам ведет такой прогон в ногу с полосами и останавливает
+прогон на первом расхождении.
+*/
+inline bool runSharded(const ShardedConfig& config, std::ostream& out, std::string& error)
+{
+    using Clock = std::chrono::steady_clock;
+    const unsigned shards = config.shards;
+    const uint64_t height = config.simulation.height;
+    if (shards == 0 || shards > MAX_SHARDS || shards > height) {
+        error = "число полос должно быть от 1 до " + std::to_string(std::min<uint64_t>(MAX_SHARDS, height));
+        return false;
+    }
+
+    std::size_t bytes = ShardShared::bytes(shards, height);
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        error = std::string("mmap: ") + std::strerror(errno);
+        return false;
+    }
+    ShardShared& shared = *new (memory) ShardShared();
+    for (unsigned i = 0; i < 2 * shards; i++) {
+        new (&shared.ring(i)) ShardRing();
+        new (&shared.cellRing(shards, i)) ShardCellRing();
+    }
+    for (unsigned shard = 0; shard <= shards; shard++) {
+        shared.rows[shard] = height * shard / shards;
+    }
+
+    /*
+    Начальная популяция существует в одном экземпляре: файл популяции читается на месте,
+    а без файла координатор один раз генерирует лодки параллельно. Полосы только читают
+    эти страницы, поэтому после fork они остаются общими, и полоса копирует себе лишь свои лодки.
+    */
+    const SimulationConfig& simulation = config.simulation;
+    ShipArray generated;
+    const uint64_t* fleet = simulation.population ? simulation.population->ships() : nullptr;
+    if (!fleet) {
+        generated.resize(simulation.shipCount);
+        ShipGenerator(simulation.scenario, simulation.width, simulation.height, simulation.typeWeights, simulation.seed)
+            .fillParallel(generated.data(), generated.size());
+        fleet = generated.data();
+    }
+
+    std::vector<pid_t> children;
+    std::vector<std::thread> threads;
+    for (unsigned shard = 0; shard < shards; shard++) {
+        if (config.threads) {
+            threads.emplace_back([&config, &shared, shard, fleet]() { runShardWorker(config, shared, shard, fleet); });
+            continue;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            runShardWorker(config, shared, shard, fleet);
+            _exit(0);
+        }
+        if (pid < 0) {
+            error = std::string("fork: ") + std::strerror(errno);
+            for (pid_t child : children) {
+                kill(child, SIGKILL);
+                waitpid(child, nullptr, 0);
+            }
+            munmap(memory, bytes);
+            return false;
+        }
+        children.push_back(pid);
+    }
+
+    // Упавший процесс полосы никогда не придет на барьер - проверяем детей, пока ждем.
+    // После команды остановки дети выходят сами, это не ошибка.
+    bool failed = false;
+    auto watchChildren = [&]() {
+        int status;
+        if (!failed && !children.empty() && !shared.stop.load(std::memory_order_acquire)
+            && waitpid(-1, &status, WNOHANG) > 0) {
+            failed = true;
+            for (pid_t child : children) {
+                kill(child, SIGKILL);
+            }
+        }
+        if (failed) {
+            // Открываем барьер сами, чтобы выйти из ожидания.
+            shared.barrier.generation.fetch_add(1, std::memory_order_acq_rel);
+        }
+    };
+
+    ShardedTotals totals;
+    std::array<uint64_t, MAX_SHARDS> intervalNs {};
+    std::optional<StripeSimulation> reference;
+    if (config.verify) {
+        reference.emplace(config.simulation, 0, height);
+        reference->initShips(fleet, simulation.shipCount);
+    }
+    auto start = Clock::now();
+    while (!failed) {
+        shared.barrier.arriveAndWait(shards + 1, watchChildren);
+        if (failed) {
+            break;
+        }
+        totals.ticks++;
+        if (totals.ticks == 1) {
+            // К первому барьеру все полосы забрали свои лодки, сгенерированная популяция больше не нужна.
+            ShipArray().swap(generated);
+        }
+        StripeStats global;
+        for (unsigned shard = 0; shard < shards; shard++) {
+            const ShardReport& report = shared.reports[shard];
+            const StripeStats& stats = report.stats;
+            global.activeShips += stats.activeShips;
+            global.fishSum += stats.fishSum;
+            global.minFishCount = std::min(global.minFishCount, stats.minFishCount);
+            global.maxFishCount = std::max(global.maxFishCount, stats.maxFishCount);
+            global.cells += stats.cells;
+            global.sentShips += stats.sentShips;
+            for (int type = 0; type < SHIP_TYPE_COUNT; type++) {
+                global.shipsByType[type] += stats.shipsByType[type];
+                global.finishedShips[type] += stats.finishedShips[type];
+            }
+            totals.tickNsSum[shard] += report.tickNs;
+            totals.tickNsMax[shard] = std::max(totals.tickNsMax[shard], report.tickNs);
+            totals.ships[shard] = stats.activeShips;
+            intervalNs[shard] += report.tickNs;
+        }
+        totals.exchangedShips += global.sentShips;
+        totals.last = global;
+        if (global.activeShips == 0 || totals.ticks >= config.maxTicks) {
+            shared.stop.store(true, std::memory_order_release);
+        }
+
+        bool rebalance = false;
+        if (config.rebalanceInterval > 0 && totals.ticks % config.rebalanceInterval == 0) {
+            uint64_t sum = 0;
+            uint64_t max = 0;
+            for (unsigned shard = 0; shard < shards; shard++) {
+                sum += intervalNs[shard];
+                max = std::max(max, intervalNs[shard]);
+            }
+            double imbalance = sum > 0 ? static_cast<double>(max) * shards / sum : 1.0;
+            if (totals.firstImbalance == 0) {
+                totals.firstImbalance = imbalance;
+            }
+            totals.lastImbalance = imbalance;
+            std::array<uint64_t, MAX_SHARDS + 1> rows = shared.rows;
+            if (shards > 1 && imbalance > config.rebalanceThreshold
+                && balanceRows(shards, height, shared.rowShips(shards), intervalNs.data(), rows)) {
+                for (unsigned boundary = 1; boundary < shards; boundary++) {
+                    totals.movedRows += rows[boundary] > shared.rows[boundary] ? rows[boundary] - shared.rows[boundary]
+                                                                               : shared.rows[boundary] - rows[boundary];
+                }
+                shared.rows = rows;
+                shared.rowsEpoch.fetch_add(1, std::memory_order_release);
+                rebalance = true;
+            }
+            intervalNs.fill(0);
+        }
+
+        shared.barrier.arriveAndWait(shards + 1, watchChildren);
+        if (failed) {
+            break;
+        }
+        // Хеши полос записаны до второго барьера и не меняются до следующего первого.
+        totals.hash = 0;
+        for (unsigned shard = 0; shard < shards; shard++) {
+            totals.hash += shared.reports[shard].hash;
+        }
+        if (reference) {
+            reference->step();
+            if (!verifyShardHashes(*reference, shared, shards, totals.ticks, totals.hash, out)) {
+                totals.divergedTick = totals.ticks;
+            }
+        }
+        if (shared.stop.load(std::memory_order_acquire)) {
+            break;
+        }
+        if (rebalance) {
+            // Вторая пара барьеров тика: полосы обмениваются строками.
+            auto rebalanceStart = Clock::now();
+            shared.barrier.arriveAndWait(shards + 1, watchChildren);
+            shared.barrier.arriveAndWait(shards + 1, watchChildren);
+            totals.rebalanceNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - rebalanceStart).count();
+            totals.rebalances++;
+        }
+        if (totals.divergedTick != 0) {
+            // Полосы уже начали следующий тик: доводим их до проверки остановки.
+            shared.stop.store(true, std::memory_order_release);
+            shared.barrier.arriveAndWait(shards + 1, watchChildren);
+            shared.barrier.arriveAndWait(shards + 1, watchChildren);
+            break;
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (pid_t child : children) {
+        waitpid(child, nullptr, 0);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    std::array<uint64_t, MAX_SHARDS + 1> rows = shared.rows;
+    uint64_t movedShips = 0;
+    uint64_t movedCells = 0;
+    for (unsigned shard = 0; shard < shards; shard++) {
+        movedShips += shared.reports[shard].movedShips;
+        movedCells += shared.reports[shard].movedCells;
+    }
+    munmap(memory, bytes);
+    if (failed) {
+        error = "процесс полосы завершился раньше времени";
+        return false;
+    }
+    if (totals.divergedTick != 0) {
+        error = "состояние полос разошлось с прогоном одной полосой на тике " + std::to_string(totals.divergedTick);
+        return false;
+    }
+
+    const StripeStats& last = totals.last;
+    out << "Shards: " << shards << (config.threads ? " (threads)" : " (processes)") << "\n"
+        << "Ticks: " << totals.ticks << ", seconds: " << seconds
+        << ", ticks/s: " << (seconds > 0 ? totals.ticks / seconds : 0.0) << "\n"
+        << "Ships exchanged between shards: " << totals.exchangedShips << "\n";
+    if (config.rebalanceInterval > 0) {
+        out << "Rebalances: " << totals.rebalances << " (every " << config.rebalanceInterval << " ticks, threshold "
+            << config.rebalanceThreshold << "), ms total " << totals.rebalanceNs / 1e6 << " mean "
+            << (totals.rebalances > 0 ? totals.rebalanceNs / 1e6 / totals.rebalances : 0.0) << "\n"
+            << "Rebalance moved: rows " << totals.movedRows << ", ships " << movedShips << ", cells " << movedCells << "\n"
+            << "Imbalance (slowest/mean shard): first interval " << totals.firstImbalance
+            << ", last interval " << totals.lastImbalance << "\n";
+    }
+    for (unsigned shard = 0; shard < shards; shard++) {
+        out << "Shard " << shard << ": rows " << rows[shard] << "-" << rows[shard + 1] - 1
+            << ", ships " << totals.ships[shard]
+            << ", tick ms mean " << (totals.ticks > 0 ? totals.tickNsSum[shard] / 1e6 / totals.ticks : 0.0)
+            << " max " << totals.tickNsMax[shard] / 1e6 << "\n";
+    }
+    out << "Active ships: " << last.activeShips << " (greedy " << last.shipsByType[ShipType::GREEDY]
+        << ", lazy " << last.shipsByType[ShipType::LAZY] << ", restless " << last.shipsByType[ShipType::RESTLESS]
+        << ", seeker " << last.shipsByType[ShipType::SEEKER] << ")\n"
+        << "Finished ships: greedy " << last.finishedShips[ShipType::GREEDY] << ", lazy " << last.finishedShips[ShipType::LAZY]
+        << ", restless " << last.finishedShips[ShipType::RESTLESS] << ", seeker " << last.finishedShips[ShipType::SEEKER] << "\n";
+    if (last.activeShips == 0) {
+        out << "Ticks until all ships leave: " << totals.ticks << "\n";
+    }
+    out << "State hash: " << formatStateHash(totals.hash) << (config.verify ? " (matches single-stripe run every tick)" : "") << "\n" << std::flush;
+    return true;
+}
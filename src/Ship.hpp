@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Parallel.hpp"
+
+// Тип лодки
+enum ShipType {
+    // Жадная
+    GREEDY = 0,
+    // Ленивая
+    LAZY = 1,
+    // Непоседливая
+    RESTLESS = 2,
+    // Искатель: плывет к самой рыбной известной клетке рядом
+    SEEKER = 3,
+};
+
+// Количество типов лодок.
+constexpr int SHIP_TYPE_COUNT = 4;
+
+// Состояние лодки
+enum ShipState {
+    // Плывет
+    FLOATING = 0,
+    // Ждет конца рыбалки
+    FISHING = 1,
+    // Накопила победное число рыбы и уплывает
+    FINISHING = 2,
+    // Ушла с карты
+    DEAD = 3,
+};
+
+/*
+Данные лодки упакованы в 64-битное число.
+Ниже расшифровка, начиная со старшего бита:
+
+[2 бита - паддинг]
+[4 бита - смещение по y]
+[4 бита - смещение по x]
+[34 бита - положение лодки (от 0 до 10^10-1 < 2^34 => 34 бита требуется)]
+[14 бит - сколько рыбы выловила лодка (от 0 до 10000 < 2^14 => 14 бит требуется)]
+[2 бита - таймер закидывания сети (1-3 тика)]
+[2 бита - состояние лодки]
+[2 бита - тип лодки]
+
+Положение лодки хранится как одно число p < 100'000 * 100'000 (10^10).
+Cмещения - когда лодка куда-то плывет, можно хранить не новую координату,
+а смещение от текущей по x и y, декрементируя их каждый тик.
+По 4 бита выбраны, чтобы в целом обеспечить 16 значений на координату:
+от 0 до 15 или от -8 до +7, реализуя смещения в плюс и минус координату.
+Таким образом, следующую клетку лодка выберет в радиусе 7-8 клеток.
+*/
+
+// Константы сдвигов и масок для различных значений лодки.
+constexpr int STATE_SHIFT = 2;
+constexpr int TIMER_SHIFT = 4;
+constexpr int FISH_SHIFT = 6;
+constexpr int POSITION_SHIFT = 20;
+constexpr int OFFSET_X_SHIFT = 54;
+constexpr int OFFSET_Y_SHIFT = 58;
+constexpr uint64_t MASK_2BIT = 0x3ULL;
+constexpr uint64_t MASK_4BIT = 0xFULL;
+constexpr uint64_t MASK_14BIT = 0x3FFFULL;
+constexpr uint64_t MASK_34BIT = 0x3FFFFFFFFULL;
+
+// Слово пустого слота: мертвая лодка без данных.
+constexpr uint64_t DEAD_SHIP = static_cast<uint64_t>(ShipState::DEAD) << STATE_SHIFT;
+
+// Устанавливает указанное значение с указанной маской и смещением. Вернет обновленное число.
+inline uint64_t setbits(uint64_t n, uint64_t shift, uint64_t mask, uint64_t value)
+{
+    n &= ~(mask << shift); // Обнуляем значение.
+    n |= ((value & mask) << shift); // Устанавливаем новое.
+    return n;
+}
+
+// Массив лодок. Память не зануляется при resize, ее заполняют потоки-владельцы.
+using ShipArray = std::vector<uint64_t, DefaultInitAllocator<uint64_t>>;
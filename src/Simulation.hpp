@@ -0,0 +1,1436 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "Behaviour.hpp"
+#include "CellTable.hpp"
+#include "FishIndex.hpp"
+#include "PerfCounters.hpp"
+#include "Population.hpp"
+#include "Scenario.hpp"
+#include "Script.hpp"
+#include "Ship.hpp"
+
+// Режим поступления новых лодок.
+enum ArrivalMode {
+    // Популяция только убывает.
+    NO_ARRIVALS = 0,
+    // Ровно rate лодок за тик в среднем (дробная часть накапливается).
+    FIXED_RATE = 1,
+    // Число лодок за тик по распределению Пуассона со средним rate.
+    POISSON = 2,
+};
+
+// Параметры поступления новых лодок для длительных прогонов с постоянной нагрузкой.
+struct ArrivalConfig {
+    ArrivalMode mode = ArrivalMode::NO_ARRIVALS;
+    // Среднее число новых лодок за тик.
+    double rate = 0;
+    // Относительные веса типов новых лодок.
+    std::array<uint32_t, SHIP_TYPE_COUNT> typeWeights { 1, 1, 1 };
+    // Ушедшая с карты лодка сразу заменяется новой в том же слоте.
+    bool respawn = false;
+    // Максимальное число слотов лодок, 0 - равно shipCount. Лодки сверх него отбрасываются.
+    uint64_t capacity = 0;
+};
+
+// Параметры постепенного освобождения памяти в длительных прогонах.
+struct CompactionConfig {
+    bool enabled = true;
+    // Доля мертвых слотов, при которой начинается уплотнение массива лодок.
+    double deadSlotFraction = 0.25;
+    // Сколько живых лодок переносится в освободившиеся слоты за тик.
+    uint64_t shipMovesPerTick = 4096;
+    // Как часто проверяется заполненность таблицы клеток, тиков. Сам переезд в меньший массив постепенный.
+    uint64_t cellCheckInterval = 64;
+    /*
+    Таблица клеток уменьшается, когда занято меньше этой доли слотов. Сразу после роста
+    занята четверть слотов, поэтому порог ниже четверти, иначе таблица сжималась бы обратно.
+    */
+    double minCellLoadFactor = 0.1;
+};
+
+// Память, занятая контейнерами симуляции, в байтах.
+struct MemoryUsage {
+    uint64_t ships = 0;
+    uint64_t cells = 0;
+    uint64_t timers = 0;
+    uint64_t freeSlots = 0;
+
+    uint64_t total() const noexcept { return ships + cells + timers + freeSlots; }
+};
+
+// Веса типов пригодны для выбора типа: хотя бы один не нулевой.
+inline bool typeWeightsValid(const std::array<uint32_t, SHIP_TYPE_COUNT>& weights) noexcept
+{
+    uint64_t total = 0;
+    for (uint32_t weight : weights) {
+        total += weight;
+    }
+    return total > 0;
+}
+
+// Параметры одной симуляции.
+struct SimulationConfig {
+    uint64_t width = 10'000;
+    uint64_t height = 10'000;
+    uint64_t shipCount = 100'000;
+    // Не больше MASK_14BIT - столько помещается в счетчик рыбы лодки.
+    uint64_t winFishCount = 10'000;
+    // Диапазон улова за одну рыбалку.
+    int catchMin = 1;
+    int catchMax = 10;
+    // Диапазон таймера обновления клетки в тиках.
+    int cellTimerMin = 15;
+    int cellTimerMax = 30;
+    // Относительные веса типов лодок при генерации (GREEDY, LAZY, RESTLESS, SEEKER).
+    std::array<uint32_t, SHIP_TYPE_COUNT> typeWeights { 1, 1, 1 };
+    // Начальная расстановка лодок.
+    ScenarioConfig scenario;
+    // Если задан, лодки копируются из открытого файла популяции вместо генерации.
+    // shipCount, width и height должны совпадать с файлом.
+    const PopulationFile* population = nullptr;
+    ArrivalConfig arrivals;
+    // Копить гистограммы тиков ухода лодок (нужны сериям прогонов; растут с числом тиков).
+    bool recordFinishTicks = false;
+    /*
+    Сколько истекших клеток удаляется за тик, остальные ждут следующих тиков.
+    0 - вдвое больше скользящего среднего числа истечений за тик.
+    */
+    uint64_t expiryBudget = 0;
+    CompactionConfig compaction;
+    // Простые переходы лодок по таблице (см. buildTransitions); false - каждая лодка через stepShip.
+    bool transitionTable = true;
+    // Сколько лодок ведут сценарии-корутины (Script.hpp) и какой встроенный сценарий.
+    uint64_t scriptShips = 0;
+    ScriptKind script = ScriptKind::GREEDY_SCRIPT;
+    // Если задан, лодки сценариев запускают его вместо встроенного (свои эксперименты, тесты).
+    ShipScript (*customScript)(ScriptShip&) = nullptr;
+    uint64_t seed = 0;
+
+    uint64_t positionBound() const noexcept { return width * height - 1; }
+    // Проверяет, что параметры помещаются в упакованное представление лодки.
+    bool valid() const noexcept
+    {
+        return width > 0 && height > 0 && positionBound() <= MASK_34BIT
+            && winFishCount > 0 && winFishCount <= MASK_14BIT
+            && catchMin >= 0 && catchMin <= catchMax && catchMax <= 255
+            && cellTimerMin >= 1 && cellTimerMin <= cellTimerMax
+            && typeWeightsValid(typeWeights) && typeWeightsValid(arrivals.typeWeights);
+    }
+};
+
+// Запрос на массовое добавление лодок в прямоугольник карты во время прогона.
+struct InjectionRequest {
+    // Левый верхний угол и размер прямоугольника в клетках.
+    uint64_t x = 0;
+    uint64_t y = 0;
+    uint64_t width = 1;
+    uint64_t height = 1;
+    uint64_t count = 0;
+    // Расстановка внутри прямоугольника и соотношение типов.
+    ScenarioPlacement placement = ScenarioPlacement::UNIFORM;
+    std::array<uint32_t, SHIP_TYPE_COUNT> typeWeights { 1, 1, 1 };
+};
+
+// Фазы тика, время которых замеряется отдельно.
+enum TickPhase {
+    // Истечение клеток и освобождение памяти.
+    EXPIRY = 0,
+    // Добавление и поступление новых лодок.
+    SPAWN = 1,
+    // Обход лодок.
+    SHIPS = 2,
+    // Лодки сценариев.
+    SCRIPTS = 3,
+};
+constexpr int TICK_PHASE_COUNT = 4;
+
+inline const char* tickPhaseName(int phase)
+{
+    static const char* names[TICK_PHASE_COUNT] = { "expiry", "spawn", "ships", "scripts" };
+    return names[phase];
+}
+
+using TickPhaseTimes = std::array<uint64_t, TICK_PHASE_COUNT>;
+using TickPhaseCounters = std::array<PerfValues, TICK_PHASE_COUNT>;
+
+// Статистика живых лодок, собираемая во время тика.
+struct SimulationStats {
+    uint64_t greedyCount = 0;
+    uint64_t lazyCount = 0;
+    uint64_t restlessCount = 0;
+    uint64_t seekerCount = 0;
+    uint64_t minFishCount = std::numeric_limits<int>::max();
+    uint64_t maxFishCount = 0;
+    double_t meanFishCount = 0;
+};
+
+// Изменение клетки за тик: новое количество рыбы или удаление из таблицы.
+struct CellChange {
+    uint64_t cell;
+    uint8_t fish;
+    bool removed;
+};
+
+// Изменение слота лодки за тик: слово лодки до и после.
+struct ShipChange {
+    uint64_t slot;
+    uint64_t before;
+    uint64_t after;
+};
+
+// Биты лодки, которые видны при отрисовке: тип, состояние и положение.
+constexpr uint64_t SHIP_VISIBLE_MASK = MASK_2BIT | (MASK_2BIT << STATE_SHIFT) | (MASK_34BIT << POSITION_SHIFT);
+
+/*
+Журнал изменений последнего тика, по которому удаленный просмотр отправляет только разницу.
+Записи идут в порядке изменений, одна клетка или слот может встречаться несколько раз.
+Лодка попадает в журнал, только если изменились видимые биты (SHIP_VISIBLE_MASK).
+*/
+struct ChangeJournal {
+    std::vector<CellChange> cells;
+    std::vector<ShipChange> ships;
+};
+
+/*
+Одна независимая симуляция.
+Все состояние, включая генератор случайных чисел, хранится в экземпляре,
+поэтому несколько симуляций можно безопасно выполнять в разных потоках.
+*/
+class Simulation {
+public:
+    using CellMap = CellTable;
+
+    explicit Simulation(const SimulationConfig& config);
+
+    // Пересоздает начальное состояние с новым сидом, переиспользуя уже выделенную память.
+    void reset(uint64_t seed);
+
+    // Выполняет один тик симуляции.
+    void step();
+
+    bool finished() const noexcept { return m_activeShips == 0 && m_activeScriptShips == 0; }
+    uint64_t tick() const noexcept { return m_tick; }
+    uint64_t activeShips() const noexcept { return m_activeShips; }
+    // Сколько лодок пришло, сколько не поместилось в capacity и сколько заменено при уходе.
+    uint64_t arrivedShips() const noexcept { return m_arrivedShips; }
+    uint64_t droppedArrivals() const noexcept { return m_droppedArrivals; }
+    uint64_t respawnedShips() const noexcept { return m_respawnedShips; }
+    uint64_t freeSlots() const noexcept { return m_freeSlots.size(); }
+    // Сколько лодок последнего тика прошли полный переход, а не переход по таблице.
+    uint64_t slowShips() const noexcept { return m_slowCount; }
+    // Живые лодки сценариев и сколько раз продолжались их сценарии.
+    uint64_t scriptShips() const noexcept { return m_activeScriptShips; }
+    uint64_t scriptResumes() const noexcept { return m_scriptResumes; }
+    const FramePool& framePool() const noexcept { return m_scriptWorld.pool; }
+    // Слоты лодок сценариев; ушедшая без замены лодка остается в слоте с alive == false.
+    const std::vector<ScriptShip>& scriptFleet() const noexcept { return m_scriptShips; }
+    // Истекшие клетки, удаление которых отложено до следующих тиков.
+    uint64_t expiryBacklog() const noexcept { return m_expiryBacklog.size() - m_expiryBacklogHead; }
+
+    /*
+    Ставит в очередь массовое добавление лодок.
+    Лодки генерируются параллельно в фоне, а в симуляцию попадают на границе
+    первого тика после готовности - вызывающий поток (и отрисовка) не ждет генерации.
+    */
+    void requestInjection(const InjectionRequest& request);
+    uint64_t pendingInjections() const noexcept { return m_pendingInjections.size(); }
+    uint64_t injectedShips() const noexcept { return m_injectedShips; }
+
+    // Текущая память контейнеров и ее максимум за прогон (по каждому контейнеру отдельно).
+    MemoryUsage memoryUsage() const;
+    const MemoryUsage& memoryHighWater() const noexcept { return m_memoryHighWater; }
+    const SimulationConfig& config() const noexcept { return m_config; }
+    const SimulationStats& stats() const noexcept { return m_stats; }
+    // Длительность фаз последнего тика в наносекундах.
+    const TickPhaseTimes& phaseNs() const noexcept { return m_phaseNs; }
+    /*
+    Аппаратные счетчики, которые читаются на границах фаз (nullptr - не читать).
+    Счетчики считают поток, в котором они открыты, поэтому step() должен вызываться в нем же.
+    */
+    void setPerfCounters(const PerfCounters* counters) noexcept { m_perfCounters = counters; }
+    // Приращения аппаратных счетчиков по фазам последнего тика.
+    const TickPhaseCounters& phaseCounters() const noexcept { return m_phaseCounters; }
+    const CellMap& cells() const noexcept { return m_activeCells; }
+    // Тик, к которому показываются клетки: последний сделанный. Истекшие к нему клетки
+    // для наблюдателей уже удалены, даже если еще ждут удаления в очереди (см. expireCells).
+    uint32_t cellsTick() const noexcept { return static_cast<uint32_t>(m_tick - 1); }
+    // Сводка рыбы по плиткам; включается при первом решении искателя.
+    const FishIndex& fishIndex() const noexcept { return m_fishIndex; }
+    const ShipArray& ships() const noexcept { return m_ships; }
+    // Вести журнал изменений (для удаленного просмотра). Журнал очищается в начале каждого тика.
+    void setJournalEnabled(bool enabled) noexcept { m_journalEnabled = enabled; }
+    const ChangeJournal& journal() const noexcept { return m_journal; }
+
+    /*
+    Гистограмма тиков, на которых лодки каждого типа ушли с карты.
+    Индекс - номер тика, значение - количество ушедших на нем лодок.
+    */
+    const std::vector<uint64_t>& finishTicks(int shipType) const noexcept { return m_finishTicks[shipType]; }
+
+private:
+    void initShips();
+    void initScripts();
+    // Ставит в слот index лодку сценария на случайную клетку и запускает ей сценарий.
+    void spawnScriptShip(uint64_t index);
+    void stepScripts();
+    /*
+    Улов на клетке position: случайный улов, не больше рыбы клетки. Клетка, которой нет в таблице,
+    активируется. В cellFish записывается рыба клетки после улова. Вернет выловленное.
+    */
+    uint8_t catchFish(uint64_t position, uint32_t& cellSlot, uint8_t& cellFish);
+    // Переход лодки слота i со всеми правилами; вернет новое слово лодки.
+    uint64_t stepShip(uint64_t i, uint64_t ship);
+    void buildTransitions();
+    void recordFinish(uint8_t shipType);
+    void processArrivals();
+    void applyInjections();
+    void commitShips(const ShipArray& staged);
+    // Достает свободный слот, пропуская слоты за концом уже уплотненного массива.
+    bool takeFreeSlot(uint64_t& slot);
+    void compact(std::vector<uint64_t>& expired, uint64_t expiredCount);
+    void compactShips();
+    void shrinkCells();
+    void trackMemory();
+    // Запоминает начало первой фазы тика и закрывает очередную фазу.
+    void beginPhases();
+    void endPhase(TickPhase phase);
+    // Удаляет истекшие клетки слота expiring, не больше бюджета за тик вместе с отложенными.
+    void expireCells(std::vector<uint64_t>& expiring);
+    // Новая лодка из потока поступлений.
+    uint64_t nextArrival();
+    void journalCell(uint64_t cell, uint8_t fish, bool removed);
+    void journalShip(uint64_t slot, uint64_t before, uint64_t after);
+    void updateFishIndex(uint64_t cell, uint8_t before, uint8_t after)
+    {
+        if (m_fishIndex.enabled()) {
+            m_fishIndex.update(cell, before, after);
+        }
+    }
+    /*
+    Смещение (0-15, как в слове лодки) от позиции position до самой рыбной живой клетки в радиусе
+    смещения, не выходя за края карты. Вернет false, если рыбы рядом нет.
+    */
+    bool seekRichest(uint64_t position, uint64_t& offsetX, uint64_t& offsetY);
+
+    /*
+    Переход лодки за тик без генератора и таблицы клеток: delta прибавляется к слову лодки,
+    positionDelta - к ее положению, чтобы заметить перенос через край карты.
+    slow - переход делает stepShip (прибытие, улов, уход с карты).
+    */
+    struct ShipTransition {
+        uint64_t delta;
+        uint64_t positionDelta;
+        bool slow;
+    };
+    // Ключ таблицы переходов: состояние, таймер и знаки смещений (положительное, отрицательное).
+    static constexpr int TRANSITION_COUNT = 256;
+    static uint8_t transitionKey(uint64_t ship) noexcept
+    {
+        const uint64_t offsetX = (ship >> OFFSET_X_SHIFT) & MASK_4BIT;
+        const uint64_t offsetY = (ship >> OFFSET_Y_SHIFT) & MASK_4BIT;
+        return static_cast<uint8_t>(((ship >> STATE_SHIFT) & MASK_2BIT) << 6 | ((ship >> TIMER_SHIFT) & MASK_2BIT) << 4
+            | (offsetX > 8) << 3 | (offsetX < 8) << 2 | (offsetY > 8) << 1 | (offsetY < 8));
+    }
+
+    // Случайные значения для политик поведения: из общего генератора, в порядке запросов.
+    struct BehaviourDraw {
+        Simulation& sim;
+        int timer() { return sim.m_shipTimerRng(sim.m_rng); }
+        int offsetX() { return sim.m_shipOffsetRng(sim.m_rng); }
+        int offsetY() { return sim.m_shipOffsetRng(sim.m_rng); }
+        bool richestOffset(uint64_t ship, uint64_t& offsetX, uint64_t& offsetY)
+        {
+            return sim.seekRichest((ship >> POSITION_SHIFT) & MASK_34BIT, offsetX, offsetY);
+        }
+    };
+
+    SimulationConfig m_config;
+    uint64_t m_positionBound;
+    int m_cellTimerSlots;
+
+    // Инициализация распределений для значений симуляции.
+    std::uniform_int_distribution<int> m_shipTimerRng { 1, 3 };
+    std::uniform_int_distribution<int> m_shipOffsetRng { 0, 15 };
+    std::uniform_int_distribution<int> m_catchRng;
+    std::uniform_int_distribution<int> m_fishRng { 0, 15 };
+    std::uniform_int_distribution<int> m_cellTimerRnd;
+
+    std::mt19937 m_rng;
+
+    /*
+    Карта для хранения только активных клеток.
+    Ключ - координата клетки, аналогична положению лодки - индекс от 0 до 10^10-1.
+    Значение - количество рыбы на клетке (0-15).
+    */
+    CellMap m_activeCells;
+    FishIndex m_fishIndex;
+
+    /*
+    Вектор для кольцевого буфера таймеров клеток.
+    Значение - вектор индексов клеток, которые будут переведены в неопределенное состояние,
+    когда указатель кольцевого буфера дойдет до их индекса.
+    */
+    std::vector<std::vector<uint64_t>> m_cellsTimers;
+
+    ShipArray m_ships;
+    /*
+    Слот клетки лодки в таблице клеток, запомненный при последней рыбалке (индексы как у m_ships).
+    Жадная и ленивая лодки рыбачат на одной клетке много раз подряд и находят ее без пробирования.
+    Таблица сверяет слот с ключом, поэтому устаревшее значение (после переезда таблицы,
+    истечения клетки или смены лодки в слоте) стоит только обычного поиска.
+    */
+    std::vector<uint32_t> m_cellSlots;
+    std::array<ShipTransition, TRANSITION_COUNT> m_transitions;
+    // Слоты лодок, отложенных до второго прохода тика.
+    std::vector<uint64_t> m_slowShips;
+    uint64_t m_slowCount = 0;
+
+    /*
+    Лодки сценариев. Сценарий держит ссылку на свою лодку, поэтому массив резервируется
+    в конструкторе и не перевыделяется; пул кадров объявлен раньше, чтобы пережить сценарии.
+    */
+    ScriptWorld m_scriptWorld;
+    std::vector<ScriptShip> m_scriptShips;
+    uint64_t m_activeScriptShips = 0;
+    uint64_t m_scriptResumes = 0;
+    uint64_t m_scriptStarts = 0;
+
+    /*
+    Слоты ушедших лодок, в которые ставятся новые.
+    Массив лодок растет только пока свободных слотов нет и не достигнут capacity.
+    */
+    std::vector<uint64_t> m_freeSlots;
+    uint64_t m_capacity;
+    ShipGenerator m_arrivalGenerator;
+    std::poisson_distribution<uint64_t> m_arrivalRng;
+    double m_arrivalCredit = 0;
+    uint64_t m_arrivalIndex = 0;
+    uint64_t m_arrivedShips = 0;
+    uint64_t m_droppedArrivals = 0;
+    uint64_t m_respawnedShips = 0;
+
+    // Сгенерированные в фоне, но еще не добавленные лодки.
+    std::vector<std::future<ShipArray>> m_pendingInjections;
+    uint64_t m_injectionIndex = 0;
+    uint64_t m_injectedShips = 0;
+
+    /*
+    Очередь отложенных удалений: клетки из слотов таймеров, не уместившиеся в бюджет тика.
+    Они уже считаются истекшими при поиске, поэтому откладывание не меняет ход симуляции.
+    */
+    std::vector<uint64_t> m_expiryBacklog;
+    uint64_t m_expiryBacklogHead = 0;
+    // Скользящее среднее размера слота таймеров; по нему выбирается бюджет, если он не задан.
+    double m_expiryRate = 0;
+
+    // Емкость слота таймеров и число слотов таблицы клеток, ниже которых память не освобождается.
+    uint64_t m_cellsPerTimer = 0;
+    uint64_t m_cellSlotBaseline = 0;
+    // Идет уплотнение массива лодок (продолжается, пока не закончатся мертвые слоты).
+    bool m_compactingShips = false;
+    MemoryUsage m_memoryHighWater;
+
+    uint64_t m_activeShips = 0;
+    uint64_t m_tick = 1;
+    SimulationStats m_stats;
+    std::array<std::vector<uint64_t>, SHIP_TYPE_COUNT> m_finishTicks;
+    TickPhaseTimes m_phaseNs {};
+    TickPhaseCounters m_phaseCounters {};
+    const PerfCounters* m_perfCounters = nullptr;
+    std::chrono::steady_clock::time_point m_phaseStart;
+    PerfValues m_phaseStartCounters {};
+    bool m_journalEnabled = false;
+    ChangeJournal m_journal;
+};
+
+inline Simulation::Simulation(const SimulationConfig& config)
+    : m_config(config)
+    , m_positionBound(config.positionBound())
+    , m_cellTimerSlots(config.cellTimerMax)
+    , m_catchRng(config.catchMin, config.catchMax)
+    , m_cellTimerRnd(config.cellTimerMin, config.cellTimerMax)
+    , m_capacity(std::max(config.arrivals.capacity, config.shipCount))
+    , m_arrivalGenerator(config.scenario, config.width, config.height, config.arrivals.typeWeights, mix64(config.seed ^ 0xA221BA15ULL))
+    , m_arrivalRng(config.arrivals.rate > 0 ? config.arrivals.rate : 1.0)
+{
+    // Инициализируем примерным количеством активных клеток == числу кораблей.
+    m_activeCells.reserve(m_config.shipCount);
+    m_cellSlotBaseline = m_activeCells.slotCount();
+
+    /*
+    Инициализируем кольцевой буфер максимальным значением таймера клетки.
+
+    Посчитаем среднее истечение клеток за ход, чтобы избежать реаллока векторов, если клеток истечет больше.
+    Средний таймер - (15 + 30) / 2 = 22.5 тика.
+    Активных клеток в среднем == число кораблей.
+    Округлим до тысяч и инициализируем векторы кольцевого буффера.
+    */
+    m_cellsTimers.resize(m_cellTimerSlots);
+    // Резервируем все слоты сразу, чтобы поступления не перевыделяли массив лодок.
+    m_ships.reserve(m_capacity);
+    m_cellSlots.reserve(m_capacity);
+    m_slowShips.reserve(m_capacity);
+    buildTransitions();
+    m_scriptShips.reserve(m_config.scriptShips);
+    m_scriptWorld.width = m_config.width;
+    m_scriptWorld.height = m_config.height;
+    double meanCellTimer = (m_config.cellTimerMin + m_config.cellTimerMax) / 2.0;
+    m_cellsPerTimer = ceil(m_config.shipCount / meanCellTimer / 1000) * 1000;
+    for (auto& cells : m_cellsTimers) {
+        cells.reserve(m_cellsPerTimer);
+    }
+
+    reset(m_config.seed);
+}
+
+inline void Simulation::reset(uint64_t seed)
+{
+    m_config.seed = seed;
+    std::seed_seq seq { static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) };
+    m_rng.seed(seq);
+
+    // clear() сохраняет выделенную память, поэтому повторные прогоны не аллоцируют заново.
+    m_activeCells.clear();
+    m_fishIndex.clear();
+    for (auto& cells : m_cellsTimers) {
+        cells.clear();
+    }
+    for (auto& counts : m_finishTicks) {
+        counts.clear();
+    }
+
+    m_tick = 1;
+    m_stats = SimulationStats {};
+    m_phaseNs = TickPhaseTimes {};
+    m_phaseCounters = TickPhaseCounters {};
+    m_expiryBacklog.clear();
+    m_expiryBacklogHead = 0;
+    m_expiryRate = static_cast<double>(m_cellsPerTimer);
+    m_freeSlots.clear();
+    m_capacity = std::max(m_config.arrivals.capacity, m_config.shipCount);
+    m_arrivalGenerator = ShipGenerator(m_config.scenario, m_config.width, m_config.height, m_config.arrivals.typeWeights, mix64(seed ^ 0xA221BA15ULL));
+    m_arrivalRng.reset();
+    m_arrivalCredit = 0;
+    m_arrivalIndex = 0;
+    m_arrivedShips = 0;
+    m_droppedArrivals = 0;
+    m_respawnedShips = 0;
+    m_pendingInjections.clear();
+    m_injectionIndex = 0;
+    m_injectedShips = 0;
+    m_compactingShips = false;
+    m_journal.cells.clear();
+    m_journal.ships.clear();
+    initShips();
+    initScripts();
+    m_memoryHighWater = memoryUsage();
+}
+
+inline void Simulation::initShips()
+{
+    // Память под лодки не зануляется: ее впервые трогают потоки, заполняющие свои куски.
+    m_ships.resize(m_config.shipCount);
+    m_cellSlots.assign(m_config.shipCount, CellTable::NO_SLOT);
+
+    if (m_config.population) {
+        m_config.population->copyTo(m_ships.data(), m_config.scenario.threads);
+        m_activeShips = 0;
+        for (uint64_t i = 0; i < m_ships.size(); i++) {
+            if (((m_ships[i] >> STATE_SHIFT) & MASK_2BIT) != ShipState::DEAD) {
+                m_activeShips++;
+            } else {
+                // Слоты мертвых лодок из файла сразу доступны для новых.
+                m_freeSlots.push_back(i);
+            }
+        }
+        return;
+    }
+
+    // Генерируем лодки сразу в режиме рыбалки согласно сценарию расстановки.
+    ShipGenerator generator(m_config.scenario, m_config.width, m_config.height, m_config.typeWeights, m_config.seed);
+    generator.fillParallel(m_ships.data(), m_ships.size());
+    m_activeShips = m_config.shipCount;
+}
+
+inline void Simulation::initScripts()
+{
+    // Уничтоженные сценарии возвращают кадры в пул, и новые берут их оттуда же.
+    m_scriptShips.clear();
+    m_scriptShips.resize(m_config.scriptShips);
+    m_activeScriptShips = 0;
+    m_scriptResumes = 0;
+    m_scriptStarts = 0;
+    for (uint64_t i = 0; i < m_scriptShips.size(); i++) {
+        spawnScriptShip(i);
+    }
+}
+
+inline void Simulation::spawnScriptShip(uint64_t index)
+{
+    ScriptShip& ship = m_scriptShips[index];
+    ship.world = &m_scriptWorld;
+    // Каждый запуск, включая замену ушедшей лодки, получает свой поток случайных чисел.
+    ship.seed(counterRandom(m_config.seed, m_scriptStarts++, 0x5C41F7ULL));
+    ship.x = ship.random(m_config.width);
+    ship.y = ship.random(m_config.height);
+    ship.fish = 0;
+    ship.action = ScriptAction::WAIT;
+    ship.wait = 0;
+    ship.cellSlot = CellTable::NO_SLOT;
+    ship.lastCatch = ScriptCatch {};
+    ship.alive = true;
+    ship.script = m_config.customScript ? m_config.customScript(ship) : startScript(m_config.script, ship);
+    m_activeScriptShips++;
+}
+
+inline uint64_t Simulation::nextArrival()
+{
+    // Поступления нумеруются отдельно от начальных лодок и не зависят от m_rng.
+    return m_arrivalGenerator(m_arrivalIndex++);
+}
+
+inline void Simulation::processArrivals()
+{
+    const ArrivalConfig& arrivals = m_config.arrivals;
+    if (arrivals.mode == ArrivalMode::NO_ARRIVALS || arrivals.rate <= 0) {
+        return;
+    }
+
+    uint64_t count = 0;
+    if (arrivals.mode == ArrivalMode::POISSON) {
+        count = m_arrivalRng(m_rng);
+    } else {
+        m_arrivalCredit += arrivals.rate;
+        count = static_cast<uint64_t>(m_arrivalCredit);
+        m_arrivalCredit -= static_cast<double>(count);
+    }
+
+    for (uint64_t n = 0; n < count; n++) {
+        uint64_t slot;
+        if (takeFreeSlot(slot)) {
+            // Слот ушедшей лодки.
+        } else if (m_ships.size() < m_capacity) {
+            slot = m_ships.size();
+            m_ships.push_back(DEAD_SHIP);
+            m_cellSlots.push_back(CellTable::NO_SLOT);
+        } else {
+            // Все слоты заняты живыми лодками.
+            m_droppedArrivals += count - n;
+            break;
+        }
+        uint64_t ship = nextArrival();
+        journalShip(slot, m_ships[slot], ship);
+        m_ships[slot] = ship;
+        m_activeShips++;
+        m_arrivedShips++;
+    }
+}
+
+inline void Simulation::requestInjection(const InjectionRequest& request)
+{
+    ScenarioConfig scenario = m_config.scenario;
+    scenario.placement = request.placement;
+    ShipGenerator generator(scenario, m_config.width, m_config.height, request.typeWeights,
+        mix64(m_config.seed ^ (0x1D1EC7ULL + m_injectionIndex++)));
+    generator.setRegion(request.x, request.y, request.width, request.height);
+
+    uint64_t count = request.count;
+    m_pendingInjections.push_back(std::async(std::launch::async, [generator, count]() {
+        ShipArray staged(count);
+        generator.fillParallel(staged.data(), staged.size());
+        return staged;
+    }));
+}
+
+inline void Simulation::applyInjections()
+{
+    // Добавляем только готовые пачки, не дожидаясь остальных.
+    for (std::size_t i = 0; i < m_pendingInjections.size();) {
+        if (m_pendingInjections[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            i++;
+            continue;
+        }
+        ShipArray staged = m_pendingInjections[i].get();
+        m_pendingInjections.erase(m_pendingInjections.begin() + i);
+        commitShips(staged);
+    }
+}
+
+/*
+Добавляет пачку готовых лодок одной операцией.
+Сначала занимаются свободные слоты, остаток дописывается в конец массива.
+Емкость массива растет не меньше чем вдвое, так что добавление амортизированно линейно,
+а новая память не зануляется и заполняется параллельно.
+*/
+inline void Simulation::commitShips(const ShipArray& staged)
+{
+    uint64_t taken = 0;
+    uint64_t slot;
+    while (taken < staged.size() && takeFreeSlot(slot)) {
+        journalShip(slot, m_ships[slot], staged[taken]);
+        m_ships[slot] = staged[taken++];
+    }
+
+    uint64_t rest = staged.size() - taken;
+    if (rest > 0) {
+        uint64_t oldSize = m_ships.size();
+        uint64_t newSize = oldSize + rest;
+        if (newSize > m_ships.capacity()) {
+            m_ships.reserve(std::max<uint64_t>(newSize, m_ships.capacity() * 2));
+        }
+        m_ships.resize(newSize);
+        m_cellSlots.resize(newSize, CellTable::NO_SLOT);
+        const uint64_t* src = staged.data() + taken;
+        uint64_t* dst = m_ships.data() + oldSize;
+        unsigned threads = rest < (1 << 16) ? 1 : resolveThreads(m_config.scenario.threads);
+        parallelFor(rest, threads, [&](uint64_t begin, uint64_t end, unsigned) {
+            std::memcpy(dst + begin, src + begin, (end - begin) * sizeof(uint64_t));
+        });
+        if (m_journalEnabled) {
+            for (uint64_t n = 0; n < rest; n++) {
+                journalShip(oldSize + n, DEAD_SHIP, src[n]);
+            }
+        }
+        // Добавленные вручную слоты не отбираются у поступлений.
+        m_capacity = std::max<uint64_t>(m_capacity, newSize);
+    }
+
+    m_activeShips += staged.size();
+    m_injectedShips += staged.size();
+}
+
+inline bool Simulation::takeFreeSlot(uint64_t& slot)
+{
+    while (!m_freeSlots.empty()) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        if (slot < m_ships.size()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline MemoryUsage Simulation::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.ships = m_ships.capacity() * sizeof(uint64_t) + m_cellSlots.capacity() * sizeof(uint32_t) + m_slowShips.capacity() * sizeof(uint64_t)
+        + m_scriptShips.capacity() * sizeof(ScriptShip) + m_scriptWorld.pool.memoryBytes();
+    usage.cells = m_activeCells.memoryBytes() + m_fishIndex.memoryBytes();
+    usage.timers = m_cellsTimers.capacity() * sizeof(std::vector<uint64_t>);
+    for (const auto& cells : m_cellsTimers) {
+        usage.timers += cells.capacity() * sizeof(uint64_t);
+    }
+    usage.timers += m_expiryBacklog.capacity() * sizeof(uint64_t);
+    usage.freeSlots = m_freeSlots.capacity() * sizeof(uint64_t);
+    return usage;
+}
+
+/*
+Постепенное освобождение памяти, выполняется в начале каждого тика.
+Работа за тик ограничена: один слот таймеров, не больше shipMovesPerTick переносов лодок
+и проверка таблицы клеток раз в cellCheckInterval тиков.
+*/
+inline void Simulation::compact(std::vector<uint64_t>& expired, uint64_t expiredCount)
+{
+    const CompactionConfig& compaction = m_config.compaction;
+    if (compaction.enabled) {
+        /*
+        Слот таймеров только что опустел. Если после всплеска он держит намного больше памяти,
+        чем истекло клеток, заменяем его вектором по размеру последнего истечения с запасом.
+        */
+        uint64_t target = std::max<uint64_t>(m_cellsPerTimer, expiredCount + expiredCount / 4);
+        if (expired.capacity() > 2 * target) {
+            std::vector<uint64_t> fresh;
+            fresh.reserve(target);
+            expired.swap(fresh);
+        }
+
+        compactShips();
+
+        if (compaction.cellCheckInterval > 0 && m_tick % compaction.cellCheckInterval == 0) {
+            shrinkCells();
+        }
+    }
+}
+
+// Обновляет максимум памяти контейнеров; вызывается в конце тика, когда контейнеры наибольшие.
+inline void Simulation::trackMemory()
+{
+    MemoryUsage usage = memoryUsage();
+    m_memoryHighWater.ships = std::max(m_memoryHighWater.ships, usage.ships);
+    m_memoryHighWater.cells = std::max(m_memoryHighWater.cells, usage.cells);
+    m_memoryHighWater.timers = std::max(m_memoryHighWater.timers, usage.timers);
+    m_memoryHighWater.freeSlots = std::max(m_memoryHighWater.freeSlots, usage.freeSlots);
+}
+
+/*
+Уплотнение массива лодок: последние живые лодки переносятся в слоты ушедших,
+а мертвые лодки в конце массива отбрасываются. Начинается, когда мертвых слотов
+становится больше deadSlotFraction, и идет порциями, пока они не закончатся.
+*/
+inline void Simulation::compactShips()
+{
+    const CompactionConfig& compaction = m_config.compaction;
+    uint64_t dead = m_ships.size() - m_activeShips;
+    if (!m_compactingShips) {
+        if (dead == 0 || static_cast<double>(dead) < compaction.deadSlotFraction * static_cast<double>(m_ships.size())) {
+            return;
+        }
+        m_compactingShips = true;
+    }
+
+    auto isDead = [](uint64_t ship) {
+        return ((ship >> STATE_SHIFT) & MASK_2BIT) == ShipState::DEAD;
+    };
+    for (uint64_t moves = 0; moves < compaction.shipMovesPerTick; moves++) {
+        while (!m_ships.empty() && isDead(m_ships.back())) {
+            m_ships.pop_back();
+            m_cellSlots.pop_back();
+        }
+        uint64_t slot;
+        if (!takeFreeSlot(slot)) {
+            break;
+        }
+        // После отбрасывания хвоста последняя лодка жива, а свободный слот - раньше нее.
+        journalShip(slot, m_ships[slot], m_ships.back());
+        journalShip(m_ships.size() - 1, m_ships.back(), DEAD_SHIP);
+        m_ships[slot] = m_ships.back();
+        m_ships.pop_back();
+        // Запомненный слот клетки переезжает вместе с лодкой.
+        m_cellSlots[slot] = m_cellSlots.back();
+        m_cellSlots.pop_back();
+    }
+
+    if (m_ships.size() > m_activeShips) {
+        return;
+    }
+
+    // Мертвых слотов не осталось.
+    m_compactingShips = false;
+    m_freeSlots.clear();
+    if (m_freeSlots.capacity() > 1024) {
+        m_freeSlots.shrink_to_fit();
+    }
+    // Память сверх начального числа лодок (например, после массового добавления) возвращаем.
+    if (m_ships.capacity() > 2 * std::max(m_ships.size(), m_config.shipCount)) {
+        m_ships.shrink_to_fit();
+        m_cellSlots.shrink_to_fit();
+    }
+}
+
+// Уменьшает таблицу клеток, если после всплеска в ней осталось мало клеток.
+inline void Simulation::shrinkCells()
+{
+    uint64_t slots = m_activeCells.slotCount();
+    if (m_activeCells.migrating() || slots <= m_cellSlotBaseline
+        || static_cast<double>(m_activeCells.size()) >= m_config.compaction.minCellLoadFactor * static_cast<double>(slots)) {
+        return;
+    }
+    // Оставляем запас вдвое, чтобы следующий рост не начался сразу. Переезд идет постепенно.
+    m_activeCells.rehash(std::max<uint64_t>(m_cellSlotBaseline / 2, 2 * m_activeCells.size()));
+}
+
+/*
+Клетки слота истекают все в одном тике, и после массового начала рыбалки такой слот
+может быть огромным. Удаления сверх бюджета откладываются в очередь и выполняются
+в следующих тиках, старые раньше новых; слот таймеров при этом освобождается сразу.
+Для журнала и сводки по плиткам клетка удаляется в тике истечения, даже если из таблицы
+ее уберут позже: поиск и так считает ее отсутствующей.
+Автоматический бюджет вдвое больше среднего притока, поэтому очередь рассасывается,
+а всплеск размывается по среднему с окном в длину кольца таймеров.
+*/
+inline void Simulation::expireCells(std::vector<uint64_t>& expiring)
+{
+    const uint32_t tick = static_cast<uint32_t>(m_tick);
+    m_expiryRate += (static_cast<double>(expiring.size()) - m_expiryRate) / m_cellTimerSlots;
+    uint64_t budget = m_config.expiryBudget > 0
+        ? m_config.expiryBudget
+        : std::max<uint64_t>(1024, static_cast<uint64_t>(2 * m_expiryRate));
+
+    if (m_journalEnabled || m_fishIndex.enabled()) {
+        // Все клетки слота истекают сейчас, в том числе те, чье удаление уйдет в очередь.
+        for (uint64_t cell : expiring) {
+            uint8_t fish;
+            uint32_t expireTick;
+            if (m_activeCells.stored(cell, fish, expireTick) && CellTable::expired(expireTick, tick)) {
+                journalCell(cell, 0, true);
+                updateFishIndex(cell, fish, 0);
+            }
+        }
+    }
+
+    while (budget > 0 && m_expiryBacklogHead < m_expiryBacklog.size()) {
+        // Клетку могли активировать заново после истечения, тогда она не удаляется.
+        m_activeCells.eraseExpired(m_expiryBacklog[m_expiryBacklogHead++], tick);
+        budget--;
+    }
+    if (m_expiryBacklogHead == m_expiryBacklog.size()) {
+        m_expiryBacklog.clear();
+        m_expiryBacklogHead = 0;
+    } else if (m_expiryBacklogHead > m_expiryBacklog.size() / 2) {
+        // Сдвигаем хвост очереди в начало, когда обработанная часть становится больше оставшейся.
+        m_expiryBacklog.erase(m_expiryBacklog.begin(), m_expiryBacklog.begin() + m_expiryBacklogHead);
+        m_expiryBacklogHead = 0;
+    }
+
+    uint64_t now = std::min<uint64_t>(budget, expiring.size());
+    for (uint64_t i = 0; i < now; i++) {
+        // Удаляем клетку, переводя ее в неопределенное состояние.
+        m_activeCells.eraseExpired(expiring[i], tick);
+    }
+    m_expiryBacklog.insert(m_expiryBacklog.end(), expiring.begin() + now, expiring.end());
+    // Очищаем индексы удаленных клеток.
+    expiring.clear();
+}
+
+inline void Simulation::beginPhases()
+{
+    m_phaseStart = std::chrono::steady_clock::now();
+    if (m_perfCounters != nullptr) {
+        m_phaseStartCounters = m_perfCounters->read();
+    }
+}
+
+inline void Simulation::endPhase(TickPhase phase)
+{
+    auto now = std::chrono::steady_clock::now();
+    m_phaseNs[phase] = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_phaseStart).count();
+    m_phaseStart = now;
+    if (m_perfCounters != nullptr) {
+        PerfValues counters = m_perfCounters->read();
+        for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+            m_phaseCounters[phase][event] = counters[event] - m_phaseStartCounters[event];
+        }
+        m_phaseStartCounters = counters;
+    }
+}
+
+inline bool Simulation::seekRichest(uint64_t position, uint64_t& offsetX, uint64_t& offsetY)
+{
+    const uint64_t width = m_config.width;
+    if (!m_fishIndex.enabled()) {
+        // Сводка строится по таблице при первом поиске и дальше обновляется вместе с ней.
+        // На слишком большой карте ее нет, и искатели плывут в случайную сторону.
+        if (m_fishIndex.refused() || !m_fishIndex.enable(width, m_config.height)) {
+            return false;
+        }
+        m_activeCells.forEachLive(static_cast<uint32_t>(m_tick), [&](uint64_t cell, uint8_t fish) { m_fishIndex.update(cell, 0, fish); });
+    }
+
+    // Окно смещений -8..+7 по каждой оси, обрезанное краями карты, чтобы движение не заворачивало.
+    uint64_t x = position % width;
+    uint64_t y = position / width;
+    const uint32_t tick = static_cast<uint32_t>(m_tick);
+    // peek не трогает счетчики поиска: метрика попаданий остается про уловы.
+    auto fishAt = [&](uint64_t cell) -> uint8_t { return m_activeCells.peek(cell, tick); };
+    uint64_t cell;
+    if (!m_fishIndex.richest(x - std::min<uint64_t>(x, 8), y - std::min<uint64_t>(y, 8),
+            std::min(x + 7, width - 1), std::min(y + 7, m_config.height - 1), fishAt, cell)) {
+        return false;
+    }
+    offsetX = cell % width + 8 - x;
+    offsetY = cell / width + 8 - y;
+    return true;
+}
+
+inline void Simulation::journalCell(uint64_t cell, uint8_t fish, bool removed)
+{
+    if (m_journalEnabled) {
+        m_journal.cells.push_back({ cell, fish, removed });
+    }
+}
+
+inline void Simulation::journalShip(uint64_t slot, uint64_t before, uint64_t after)
+{
+    if (m_journalEnabled && ((before ^ after) & SHIP_VISIBLE_MASK) != 0) {
+        m_journal.ships.push_back({ slot, before, after });
+    }
+}
+
+inline void Simulation::recordFinish(uint8_t shipType)
+{
+    if (!m_config.recordFinishTicks) {
+        return;
+    }
+
+    auto& counts = m_finishTicks[shipType];
+    if (counts.size() <= m_tick) {
+        counts.resize(m_tick + 1, 0);
+    }
+    counts[m_tick]++;
+}
+
+inline uint8_t Simulation::catchFish(uint64_t position, uint32_t& cellSlot, uint8_t& cellFish)
+{
+    // Генерируем количество рыбы, которое выловила лодка.
+    uint8_t fishCatched = m_catchRng(m_rng);
+
+    /*
+    Логика проверки, активна ли текущая клетка.
+    Для этого ищем ее количество рыбы в таблице.
+    */
+    uint8_t* storedFish = m_activeCells.find(position, static_cast<uint32_t>(m_tick), cellSlot);
+    uint8_t cellFishCounter = 0;
+    // Рыба клетки до улова для сводки по плиткам (0 - клетки не было или она истекла).
+    uint8_t fishBefore = 0;
+    if (storedFish == nullptr) {
+        /*
+        Если клетки нет в таблице (или она истекла, но еще не удалена),
+        она была в неопределенном состоянии. Активируем ее.
+        */
+
+        // Генерируем количество рыбы на клетке
+        cellFishCounter = m_fishRng(m_rng);
+        // Корректно изменяем количество рыбы на клетке.
+        if (fishCatched > cellFishCounter) {
+            fishCatched = cellFishCounter;
+            cellFishCounter = 0;
+        } else {
+            cellFishCounter -= fishCatched;
+        }
+
+        // Генерируем таймер обновления клетки.
+        int cellTimeout = m_cellTimerRnd(m_rng);
+        // Сохраняем новое значение рыбы в таблице вместе с тиком истечения.
+        // Истекшая клетка ушла из сводки в тике истечения, поэтому fishBefore остается 0.
+        m_activeCells.activate(position, cellFishCounter, static_cast<uint32_t>(m_tick + cellTimeout), cellSlot);
+
+        int timerIdx = (m_tick + cellTimeout) % m_cellTimerSlots;
+        // Помещаем индекс текущей клетки в кольцевой буфер.
+        m_cellsTimers[timerIdx].push_back(position);
+    } else {
+        // Если клетка уже есть в таблице.
+
+        cellFishCounter = *storedFish;
+        fishBefore = cellFishCounter;
+        // Корректно изменяем количество рыбы на клетке.
+        if (fishCatched > cellFishCounter) {
+            fishCatched = cellFishCounter;
+            cellFishCounter = 0;
+        } else {
+            cellFishCounter -= fishCatched;
+        }
+
+        // Сохраняем новое значение рыбы в таблице.
+        *storedFish = cellFishCounter;
+    }
+    journalCell(position, cellFishCounter, false);
+    updateFishIndex(position, fishBefore, cellFishCounter);
+    cellFish = cellFishCounter;
+    return fishCatched;
+}
+
+/*
+Планировщик сценариев: каждая лодка выполняет тик своего действия, и если действие закончилось,
+ее сценарий продолжается до следующего co_await. Лодки идут после обычных и по порядку слотов,
+поэтому общий генератор дает тот же результат при том же сиде.
+*/
+inline void Simulation::stepScripts()
+{
+    const uint64_t width = m_config.width;
+    const uint64_t winFishCount = m_config.winFishCount;
+
+    for (uint64_t i = 0; i < m_scriptShips.size(); i++) {
+        ScriptShip& ship = m_scriptShips[i];
+        if (!ship.alive) {
+            continue;
+        }
+
+        switch (ship.action) {
+        case ScriptAction::WAIT:
+            if (ship.wait > 0 && --ship.wait > 0) {
+                continue;
+            }
+            break;
+        case ScriptAction::MOVE:
+            // Как обычная лодка: сначала по x, потом по y, клетка за тик; прибытие занимает тик.
+            if (ship.x != ship.targetX) {
+                ship.x = ship.x < ship.targetX ? ship.x + 1 : ship.x - 1;
+                continue;
+            }
+            if (ship.y != ship.targetY) {
+                ship.y = ship.y < ship.targetY ? ship.y + 1 : ship.y - 1;
+                continue;
+            }
+            break;
+        case ScriptAction::FISH: {
+            if (--ship.wait > 0) {
+                continue;
+            }
+            uint8_t cellFish = 0;
+            uint8_t caught = catchFish(ship.y * width + ship.x, ship.cellSlot, cellFish);
+            ship.lastCatch = ScriptCatch { caught, cellFish };
+            ship.fish = std::min(ship.fish + caught, winFishCount);
+            if (ship.fish == winFishCount) {
+                // Победившая лодка больше не слушает сценарий и уплывает, кадр возвращается в пул.
+                ship.script.reset();
+                ship.action = ScriptAction::LEAVE;
+                continue;
+            }
+            break;
+        }
+        case ScriptAction::LEAVE:
+            if (ship.x + 1 < width) {
+                ship.x++;
+                continue;
+            }
+            if (m_config.arrivals.respawn) {
+                spawnScriptShip(i);
+                m_activeScriptShips--;
+                m_respawnedShips++;
+            } else {
+                ship.alive = false;
+                m_activeScriptShips--;
+            }
+            continue;
+        }
+
+        ship.script.resume();
+        m_scriptResumes++;
+        if (!ship.script.running()) {
+            ship.script.reset();
+            ship.action = ScriptAction::LEAVE;
+        } else if (ship.action == ScriptAction::FISH) {
+            // Таймер рыбалки выбирается так же, как у обычной лодки.
+            ship.wait = m_shipTimerRng(m_rng);
+        }
+    }
+}
+
+/*
+Полный переход одной лодки со всеми ветвлениями: прибытие, улов, уход с карты и перенос через край.
+Остальные переходы step() делает по таблице, и для них результат этой функции такой же.
+*/
+inline uint64_t Simulation::stepShip(uint64_t i, uint64_t ship)
+{
+    const uint64_t width = m_config.width;
+    const uint64_t positionBound = m_positionBound;
+    const uint64_t winFishCount = m_config.winFishCount;
+
+    uint8_t shipType = ship & MASK_2BIT; // Тип лодки
+    uint8_t shipState = (ship >> STATE_SHIFT) & MASK_2BIT; // Состояние лодки.
+
+    switch (shipState) {
+    case ShipState::DEAD:
+        return ship;
+    case ShipState::FLOATING: {
+        // Обрабатываем передвижение судна.
+
+        uint64_t shipPosition = (ship >> POSITION_SHIFT) & MASK_34BIT;
+
+        // Получаем сдвиги до целевой позиции.
+        int64_t offsetX = (ship >> OFFSET_X_SHIFT) & MASK_4BIT;
+        offsetX -= 8; // Чтобы получить значения от -8 до 7
+        int64_t offsetY = (ship >> OFFSET_Y_SHIFT) & MASK_4BIT;
+        offsetY -= 8; // Чтобы получить значения от -8 до 7;
+
+        if (offsetX == 0 && offsetY == 0) {
+            // Если оба сдвига равны нулю, мы доплыли и можем начинать рыбачить.
+
+            // Обновляем состояние на ожидание окончания рыбалки.
+            ship = setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::FISHING);
+
+            // Устанавливаем таймер ожидания конца рыбалки.
+            ship = setbits(ship, TIMER_SHIFT, MASK_2BIT, m_shipTimerRng(m_rng));
+
+            break;
+        }
+
+        if (offsetX > 0) {
+            // Если смещение по X > 0, значит плывем в положительную сторону по x.
+            offsetX--;
+            shipPosition++;
+
+            // Проверяем на пересечение границы сверху.
+            if (shipPosition > positionBound) {
+                shipPosition = 0;
+            }
+
+            // Устанавливаем новые значение смещения и положения.
+            ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, offsetX + 8);
+            ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
+
+            break;
+        }
+
+        if (offsetX < 0) {
+            // Если смещение по X < 0, значит плывем в отрицательную сторону по x.
+            offsetX++;
+            shipPosition--;
+
+            /*
+            Проверка на underflow.
+            Логически это можно представить как движение в верхней левой клетке налево.
+            Это приведет к перемещению в positionBound координату - нижнюю правую.
+            */
+            if (shipPosition > positionBound) {
+                shipPosition = positionBound;
+            }
+
+            // Устанавливаем новые значение смещения и положения.
+            ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, offsetX + 8);
+            ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
+
+            break;
+        }
+
+        if (offsetY > 0) {
+            /*
+            Если смещение по Y > 0, значит мы должны двигаться вверх.
+            Для этого нужно уменьшить текущее положение на одну ширину карты.
+            */
+            offsetY--;
+
+            if (shipPosition < width) {
+                // Если позиция меньше ширины поля, значит мы на первой строке,
+                // и движение наверх должно перенести нас на
+                // самую нижнюю линию.
+                shipPosition = positionBound - (width - shipPosition - 1);
+            } else {
+                shipPosition -= width;
+            }
+
+            ship = setbits(ship, OFFSET_Y_SHIFT, MASK_4BIT, offsetY + 8);
+            ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
+
+            break;
+        }
+
+        if (offsetY < 0) {
+            /*
+            Если смещение по Y < 0, значит мы должны двигаться вниз.
+            Для этого нужно увеличить текущее положение на одну ширину карты.
+            */
+            offsetY++;
+
+            if (shipPosition + width > positionBound) {
+                /*
+                Если новая позиция выходит за границы, значит мы на нижней строке.
+                Движение еще ниже должно привести нас на первую строку.
+                */
+                shipPosition = width - (positionBound - shipPosition) - 1;
+            } else {
+                shipPosition += width;
+            }
+
+            ship = setbits(ship, OFFSET_Y_SHIFT, MASK_4BIT, offsetY + 8);
+            ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
+
+            break;
+        }
+
+        break;
+    }
+    case ShipState::FISHING: {
+        // Обрабатываем состояние рыбалки.
+
+        uint64_t shipPosition = (ship >> POSITION_SHIFT) & MASK_34BIT;
+
+        // Получаем текущее значение таймера ожидания улова.
+        uint8_t fishTimer = (ship >> TIMER_SHIFT) & MASK_2BIT;
+        fishTimer--;
+        ship = setbits(ship, TIMER_SHIFT, MASK_2BIT, fishTimer);
+
+        if (fishTimer > 0) {
+            break;
+        }
+
+        // Если таймер дошел до нуля, реализуем логику вылавливания рыбы.
+        // Непоседа после каждого улова уходит, ее слот запоминать незачем.
+        uint32_t noSlot = CellTable::NO_SLOT;
+        uint32_t& cellSlot = shipType == ShipType::RESTLESS ? noSlot : m_cellSlots[i];
+        uint8_t cellFishCounter = 0;
+        uint8_t fishCatched = catchFish(shipPosition, cellSlot, cellFishCounter);
+
+        // Обновляем общее количество рыбы, которое выловила лодка.
+        uint64_t shipFishCounter = (ship >> FISH_SHIFT) & MASK_14BIT;
+        shipFishCounter = std::min(shipFishCounter + fishCatched, winFishCount);
+        ship = setbits(ship, FISH_SHIFT, MASK_14BIT, shipFishCounter);
+
+        // Проверяем условие победы для лодки
+        if (shipFishCounter == winFishCount) {
+            // Лодка победила, ставим ей состояние уплывания с карты.
+            ship = setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::FINISHING);
+            break;
+        }
+
+        /*
+        Лодка еще не победила, но рыбалку закончила.
+        Дальнейшее поведение определяет политика ее типа (см. Behaviour.hpp).
+        */
+        BehaviourDraw draw { *this };
+        ship = ShipBehaviours::dispatch(shipType, [&](auto behaviour) {
+            return decltype(behaviour)::afterCatch(ship, cellFishCounter, draw);
+        });
+
+        break;
+    }
+    case ShipState::FINISHING: {
+        /*
+        Обрабатываем лодку, которая победила и уплывает с карты.
+        Для этого просто двигаем ее на +1 по x, проверяя оставшееся расстояние до края карты.
+        */
+
+        uint64_t shipPosition = (ship >> POSITION_SHIFT) & MASK_34BIT;
+
+        // Сколько клеток осталось до края карты.
+        uint64_t distanceLeft = width - (shipPosition % width + 1);
+
+        if (distanceLeft == 0) {
+            // Мы уже стоим у края карты, значит лодка исчезает.
+            recordFinish(shipType);
+            if (m_config.arrivals.respawn) {
+                // Вместо ушедшей лодки в этом же слоте появляется новая.
+                ship = nextArrival();
+                m_respawnedShips++;
+            } else {
+                ship = setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::DEAD);
+                m_activeShips--;
+                m_freeSlots.push_back(i);
+            }
+        } else {
+            // Еще осталось место для движения до края.
+            shipPosition++;
+
+            ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
+        }
+
+        break;
+    }
+    }
+
+    return ship;
+}
+
+inline void Simulation::buildTransitions()
+{
+    if (!m_config.transitionTable) {
+        // Все переходы медленные: второй проход повторяет прежний обход одной лодки за другой.
+        m_transitions.fill({ 0, 0, true });
+        return;
+    }
+    const uint64_t width = m_config.width;
+    for (int key = 0; key < TRANSITION_COUNT; key++) {
+        const uint8_t state = key >> 6;
+        const uint8_t timer = (key >> 4) & MASK_2BIT;
+        const bool xPositive = (key >> 3) & 1;
+        const bool xNegative = (key >> 2) & 1;
+        const bool yPositive = (key >> 1) & 1;
+        const bool yNegative = key & 1;
+
+        // Поля меняются на ±1 без переноса в соседние поля: смещение уходит к 8, положение остается в карте.
+        ShipTransition transition { 0, 0, true };
+        if (state == ShipState::DEAD) {
+            transition = { 0, 0, false };
+        } else if (state == ShipState::FISHING && timer >= 2) {
+            // Таймер рыбалки еще не дошел до улова.
+            transition = { static_cast<uint64_t>(-1) << TIMER_SHIFT, 0, false };
+        } else if (state == ShipState::FLOATING && xPositive) {
+            transition = { (1ULL << POSITION_SHIFT) - (1ULL << OFFSET_X_SHIFT), 1, false };
+        } else if (state == ShipState::FLOATING && xNegative) {
+            transition = { (1ULL << OFFSET_X_SHIFT) - (1ULL << POSITION_SHIFT), static_cast<uint64_t>(-1), false };
+        } else if (state == ShipState::FLOATING && yPositive) {
+            // Положительное смещение по y - вверх, на строку раньше.
+            transition = { static_cast<uint64_t>(0) - (width << POSITION_SHIFT) - (1ULL << OFFSET_Y_SHIFT), static_cast<uint64_t>(0) - width, false };
+        } else if (state == ShipState::FLOATING && yNegative) {
+            transition = { (width << POSITION_SHIFT) + (1ULL << OFFSET_Y_SHIFT), width, false };
+        }
+        // Прибытие, улов, уход с карты и невозможные сочетания знаков - через stepShip.
+        m_transitions[key] = transition;
+    }
+}
+
+inline void Simulation::step()
+{
+    const uint64_t positionBound = m_positionBound;
+
+    beginPhases();
+    if (m_journalEnabled) {
+        m_journal.cells.clear();
+        m_journal.ships.clear();
+    }
+
+    // Обрабатываем клетки.
+    // Индекс текущей группы таймеров, которые заканчиваются.
+    int expiringGroupIdx = m_tick % m_cellTimerSlots;
+    auto& expiring = m_cellsTimers[expiringGroupIdx];
+    uint64_t expiredCount = expiring.size();
+    expireCells(expiring);
+
+    compact(expiring, expiredCount);
+    endPhase(TickPhase::EXPIRY);
+
+    // Новые лодки появляются на границе тика и обрабатываются в этом же тике.
+    applyInjections();
+    processArrivals();
+    endPhase(TickPhase::SPAWN);
+
+    // Обрабатываем суда.
+    /*
+    Первый проход без ветвлений: статистика и переходы по таблице m_transitions.
+    Лодки, которым нужны генератор, таблица клеток, уход с карты или перенос через край,
+    откладываются во второй проход. Он идет в порядке слотов, а в первом проходе генератор
+    не используется, поэтому значения генератора достаются лодкам те же, что и при одном обходе.
+    */
+    const uint64_t activeShipsAtStart = m_activeShips;
+    SimulationStats stats;
+    std::array<uint64_t, SHIP_TYPE_COUNT> typeCounts {};
+    m_slowShips.resize(m_ships.size());
+    uint64_t slowCount = 0;
+    for (uint64_t i = 0; i < m_ships.size(); i++) {
+        const uint64_t ship = m_ships[i];
+
+        // Обновим статистику, но только для не-мертвых лодок.
+        const uint64_t fishCount = (ship >> FISH_SHIFT) & MASK_14BIT;
+        const bool alive = ((ship >> STATE_SHIFT) & MASK_2BIT) != ShipState::DEAD;
+        typeCounts[ship & MASK_2BIT] += alive;
+        stats.minFishCount = std::min(stats.minFishCount, alive ? fishCount : stats.minFishCount);
+        stats.maxFishCount = std::max(stats.maxFishCount, alive ? fishCount : 0);
+        // Делим на число живых лодок в начале тика, как и до разделения на проходы:
+        // ушедшие с карты в этом тике в среднее еще входят.
+        stats.meanFishCount += alive ? static_cast<double>(fishCount) / static_cast<double>(activeShipsAtStart) : 0.0;
+
+        const ShipTransition& transition = m_transitions[transitionKey(ship)];
+        const uint64_t shipPosition = (ship >> POSITION_SHIFT) & MASK_34BIT;
+        // Беззнаковое переполнение при шаге за левый или верхний край тоже дает число больше границы.
+        const bool slow = transition.slow | (shipPosition + transition.positionDelta > positionBound);
+        const uint64_t next = slow ? ship : ship + transition.delta;
+        m_slowShips[slowCount] = i;
+        slowCount += slow;
+
+        journalShip(i, ship, next);
+        m_ships[i] = next;
+    }
+    stats.greedyCount = typeCounts[ShipType::GREEDY];
+    stats.lazyCount = typeCounts[ShipType::LAZY];
+    stats.restlessCount = typeCounts[ShipType::RESTLESS];
+    stats.seekerCount = typeCounts[ShipType::SEEKER];
+    m_stats = stats;
+    m_slowCount = slowCount;
+
+    // Второй проход: отложенные лодки по полным правилам.
+    for (uint64_t k = 0; k < slowCount; k++) {
+        const uint64_t i = m_slowShips[k];
+        uint64_t ship = stepShip(i, m_ships[i]);
+        journalShip(i, m_ships[i], ship);
+        m_ships[i] = ship;
+    }
+    endPhase(TickPhase::SHIPS);
+
+    stepScripts();
+    endPhase(TickPhase::SCRIPTS);
+
+    trackMemory();
+    m_tick++;
+}
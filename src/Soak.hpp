@@ -0,0 +1,94 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#include "Latency.hpp"
+#include "Metrics.hpp"
+#include "MetricsServer.hpp"
+#include "Simulation.hpp"
+
+// Параметры длительного прогона без окна.
+struct SoakConfig {
+    SimulationConfig simulation;
+    // Сколько секунд идет прогон.
+    uint64_t durationSeconds = 60;
+    // Как часто печатать строку отчета.
+    uint64_t reportIntervalSeconds = 10;
+    // Тики дольше дедлайна считаются просроченными.
+    uint64_t tickDeadlineMs = 100;
+    // Сколько самых долгих тиков напечатать с разбивкой по фазам в конце, 0 - не печатать.
+    uint64_t slowTicks = 0;
+    // Если задан, после каждого тика в него публикуется снимок метрик.
+    MetricsServer* metrics = nullptr;
+};
+
+/*
+Длительный прогон без окна и без ограничения темпа: тики выполняются подряд,
+раз в интервал печатается строка CSV с пропускной способностью, квантилями задержки тика
+за интервал, числом просроченных тиков с начала прогона, состоянием таблицы клеток и памятью.
+Доля найденных клеток и средняя длина пробирования считаются за интервал, максимальная - с начала.
+С поступлениями или --respawn популяция держится постоянной, и все столбцы должны оставаться ровными.
+*/
+inline void runSoak(const SoakConfig& config, std::ostream& out)
+{
+    using Clock = std::chrono::steady_clock;
+    Simulation sim(config.simulation);
+
+    out << "elapsed_s,tick,active_ships,active_cells,expiry_backlog,cell_slots,cell_load,cell_rehashes,cell_hit_rate,"
+           "probe_mean,probe_max,free_slots,arrived,dropped,respawned,"
+           "ticks_per_s,tick_mean_ms,tick_p50_ms,tick_p99_ms,tick_p999_ms,tick_max_ms,overruns,sim_mb,sim_peak_mb,rss_mb,rss_peak_mb"
+        << std::endl;
+
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::seconds(config.durationSeconds);
+    auto intervalStart = start;
+    TickProfiler profiler(config.tickDeadlineMs * 1'000'000, config.slowTicks);
+    CellTableHealth lastHealth = sim.cells().health();
+
+    while (!sim.finished()) {
+        auto tickStart = Clock::now();
+        sim.step();
+        auto tickEnd = Clock::now();
+
+        uint64_t tickNs = std::chrono::duration_cast<std::chrono::nanoseconds>(tickEnd - tickStart).count();
+        profiler.recordTick(sim.tick() - 1, tickNs, sim.phaseNs());
+        if (config.metrics != nullptr) {
+            config.metrics->publish(sim, profiler);
+        }
+
+        bool done = tickEnd >= deadline;
+        if (done || tickEnd - intervalStart >= std::chrono::seconds(config.reportIntervalSeconds)) {
+            double intervalSeconds = std::chrono::duration<double>(tickEnd - intervalStart).count();
+            const LatencyHistogram& ticks = profiler.intervalTicks();
+            CellTableHealth health = sim.cells().health();
+            uint64_t lookups = health.hits + health.misses - lastHealth.hits - lastHealth.misses;
+            uint64_t probeSamples = health.probeSamples - lastHealth.probeSamples;
+            out << std::chrono::duration<double>(tickEnd - start).count() << ',' << sim.tick() - 1 << ','
+                << sim.activeShips() << ',' << health.size << ',' << sim.expiryBacklog() << ','
+                << health.slots << ',' << health.loadFactor << ',' << health.rehashes << ','
+                << (lookups > 0 ? static_cast<double>(health.hits - lastHealth.hits) / lookups : 0.0) << ','
+                << (probeSamples > 0 ? static_cast<double>(health.probeTotal - lastHealth.probeTotal) / probeSamples : 0.0) << ','
+                << health.probeMax << ',' << sim.freeSlots() << ','
+                << sim.arrivedShips() << ',' << sim.droppedArrivals() << ',' << sim.respawnedShips() << ','
+                << ticks.count() / intervalSeconds << ',' << ticks.mean() / 1e6 << ','
+                << ticks.quantile(0.5) / 1e6 << ',' << ticks.quantile(0.99) / 1e6 << ','
+                << ticks.quantile(0.999) / 1e6 << ',' << ticks.max() / 1e6 << ','
+                << profiler.overruns() << ',' << sim.memoryUsage().total() / (1 << 20) << ','
+                << sim.memoryHighWater().total() / (1 << 20) << ',' << currentRssBytes() / (1 << 20) << ','
+                << peakRssBytes() / (1 << 20) << std::endl;
+
+            intervalStart = tickEnd;
+            profiler.resetInterval();
+            lastHealth = health;
+        }
+        if (done) {
+            break;
+        }
+    }
+
+    if (config.slowTicks > 0) {
+        profiler.printSlowestTicks(out);
+    }
+}
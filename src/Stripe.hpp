@@ -0,0 +1,744 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Behaviour.hpp"
+#include "CellTable.hpp"
+#include "Random.hpp"
+#include "Scenario.hpp"
+#include "Ship.hpp"
+#include "Simulation.hpp"
+
+// Лодка, переходящая в другую полосу: упакованное слово и сквозной номер.
+struct StripeShip {
+    uint64_t ship;
+    uint64_t id;
+};
+
+// Клетка, переходящая в другую полосу при сдвиге границ.
+struct StripeCell {
+    uint64_t cell;
+    uint32_t expireTick;
+    uint8_t fish;
+};
+
+// Статистика полосы за последний тик.
+struct StripeStats {
+    // Живые лодки в конце тика, включая ушедшие к соседям.
+    uint64_t activeShips = 0;
+    std::array<uint64_t, SHIP_TYPE_COUNT> shipsByType {};
+    uint64_t fishSum = 0;
+    uint64_t minFishCount = UINT64_MAX;
+    uint64_t maxFishCount = 0;
+    uint64_t cells = 0;
+    // Лодки, ушедшие в соседние полосы за тик.
+    uint64_t sentShips = 0;
+    // Лодки, ушедшие с карты, с начала прогона по типам.
+    std::array<uint64_t, SHIP_TYPE_COUNT> finishedShips {};
+};
+
+/*
+Вклады лодки и клетки в хеш состояния. Хеш - сумма вкладов по модулю 2^64: он не зависит
+от порядка, меняется на разность вкладов при каждом изменении, а хеш всей карты равен
+сумме хешей ее полос. У клетки отдельные вклады тика истечения и рыбы, чтобы улов
+пересчитывал хеш без тика истечения. Номер клетки и тик истечения перемешиваются
+по отдельности: номер клетки бывает шире 32 бит и при сдвиге терял бы старшие биты.
+*/
+inline uint64_t shipStateHash(uint64_t id, uint64_t ship) noexcept
+{
+    return mix64(ship ^ mix64(id + 0x632BE59BD9B4E019ULL));
+}
+
+inline uint64_t cellExpiryHash(uint64_t cell, uint32_t expireTick) noexcept
+{
+    return mix64(mix64(cell) ^ expireTick ^ 0x8CB92BA72F3D8DD7ULL);
+}
+
+inline uint64_t cellFishHash(uint64_t cell, uint8_t fish) noexcept
+{
+    return mix64((cell << 8 | fish) + 0x9FB21C651E98DF25ULL);
+}
+
+/*
+Горизонтальная полоса карты - строки [rowBegin, rowEnd) со своими лодками и клетками.
+Правила те же, что в Simulation, но случайные числа берутся из counterRandom по сквозному
+номеру лодки (или позиции клетки) и номеру тика, а рыбалки одного тика на одной клетке
+разрешаются по возрастанию номера лодки. Поэтому результат не зависит от того, как карта
+поделена на полосы и в каком порядке лодки лежат в массиве. С Simulation он не совпадает:
+там все решения берутся из одного последовательного генератора.
+
+Лодки, чье поведение известно заранее, лежат отдельными группами, упорядоченными по клетке
+и номеру. Рыбачащие ленивые лодки (m_lazy) не двигаются до победы: им остается отсчитывать
+таймер. Непоседы (m_restless) после каждого улова сдвигаются на клетку вправо, поэтому
+порядок группы почти не нарушается и восстанавливается вставками. Рыбалки обеих групп
+выходят уже упорядоченными по клетке, сортировать приходится только рыбалки остальных лодок,
+а все рыбалки одной клетки за тик разрешаются за одно обращение к таблице клеток.
+
+Лодка, которая уплыла за край полосы, убирается из массива и попадает в очередь
+соседней полосы (m_toNext или m_toPrev); ее принимает receive() до следующего тика.
+Любое движение меняет строку не больше чем на одну, с заворотом последней строки на первую,
+поэтому лодки переходят только к соседям. Поступления и массовое добавление не поддерживаются.
+*/
+class StripeSimulation {
+public:
+    StripeSimulation(const SimulationConfig& config, uint64_t rowBegin, uint64_t rowEnd);
+
+    /*
+    Забирает из начальной популяции ships[0, count) лодки, стоящие в строках полосы.
+    Массив только читается, поэтому все полосы читают одну и ту же память.
+    */
+    void initShips(const uint64_t* ships, uint64_t count);
+    void step();
+    // Принимает лодку из соседней полосы; она обрабатывается со следующего тика.
+    void receive(const StripeShip& ship);
+    void receiveCell(const StripeCell& cell);
+    /*
+    Сдвигает границы полосы между тиками. Лодки и клетки строк, которые полоса отдает,
+    уходят в очереди соседей: строки выше rowBegin - в предыдущую полосу, ниже rowEnd - в следующую.
+    Крайние границы карты не двигаются, поэтому строки передаются только соседям.
+    */
+    void setRows(uint64_t rowBegin, uint64_t rowEnd);
+    // Записывает число лодок в каждой строке полосы в counts[row].
+    void countRowShips(uint32_t* counts) const;
+
+    uint64_t tick() const noexcept { return m_tick; }
+    uint64_t rowBegin() const noexcept { return m_rowBegin; }
+    uint64_t rowEnd() const noexcept { return m_rowEnd; }
+    const StripeStats& stats() const noexcept { return m_stats; }
+    // Хеш лодок и клеток полосы, поддерживается при каждом изменении.
+    uint64_t hash() const noexcept { return m_hash; }
+    // Хеш лодок и клеток в строках [rowBegin, rowEnd), посчитанный заново обходом.
+    uint64_t hashRows(uint64_t rowBegin, uint64_t rowEnd) const;
+    // Лодки, ушедшие за последний тик в следующую (ниже) и предыдущую полосы.
+    const std::vector<StripeShip>& toNext() const noexcept { return m_toNext; }
+    const std::vector<StripeShip>& toPrev() const noexcept { return m_toPrev; }
+    // Клетки, отданные соседям последним setRows.
+    const std::vector<StripeCell>& cellsToNext() const noexcept { return m_cellsToNext; }
+    const std::vector<StripeCell>& cellsToPrev() const noexcept { return m_cellsToPrev; }
+
+private:
+    // Номера потоков значений counterRandom.
+    enum Stream {
+        TIMER = 0,
+        CATCH = 1,
+        OFFSET_X = 2,
+        OFFSET_Y = 3,
+        CELL_FISH = 4,
+        CELL_TIMER = 5,
+    };
+
+    // Рыбалка, закончившаяся на этом тике: ключ (клетка, номер), слово лодки и где оно лежит.
+    // Слово копируется, чтобы при разрешении в порядке клеток не читать массивы вразброс.
+    // После улова в ship лежит слово с новым числом рыбы, а в cellFish - рыба, оставшаяся на клетке.
+    struct Catch {
+        uint64_t cell;
+        uint64_t id;
+        uint64_t ship;
+        uint64_t* slot;
+        uint8_t cellFish;
+    };
+
+    // Случайные значения для политик поведения: counterRandom по номеру лодки.
+    struct BehaviourDraw {
+        const StripeSimulation& sim;
+        uint64_t id;
+        uint64_t timer() const noexcept { return 1 + randomBelow(sim.random(id, Stream::TIMER), 3); }
+        uint64_t offsetX() const noexcept { return randomBelow(sim.random(id, Stream::OFFSET_X), 16); }
+        uint64_t offsetY() const noexcept { return randomBelow(sim.random(id, Stream::OFFSET_Y), 16); }
+        // Полоса не видит клеток соседей, а окно искателя может их задевать: ответ зависел бы
+        // от деления на полосы. Поэтому искатель здесь выбирает смещение случайно, как жадная лодка.
+        bool richestOffset(uint64_t, uint64_t&, uint64_t&) const noexcept { return false; }
+    };
+
+    static uint64_t positionOf(uint64_t ship) noexcept { return (ship >> POSITION_SHIFT) & MASK_34BIT; }
+    // Порядок групп и рыбалок: по клетке, на одной клетке - по номеру лодки.
+    static bool shipOrder(const StripeShip& a, const StripeShip& b) noexcept
+    {
+        return positionOf(a.ship) < positionOf(b.ship) || (positionOf(a.ship) == positionOf(b.ship) && a.id < b.id);
+    }
+    static bool catchOrder(const Catch& a, const Catch& b) noexcept
+    {
+        return a.cell < b.cell || (a.cell == b.cell && a.id < b.id);
+    }
+    // Вливает принятые лодки в группу с сохранением порядка.
+    static void mergeArrivals(std::vector<StripeShip>& group, std::vector<StripeShip>& arrivals);
+    // Досортировывает группу, порядок которой нарушили сдвиги лодок.
+    static void restoreOrder(std::vector<StripeShip>& group);
+
+    uint64_t random(uint64_t index, Stream stream) const noexcept { return counterRandom(m_tickSeed, index, stream); }
+    bool owns(uint64_t position) const noexcept;
+    // Кладет лодку в полосу: в группу ленивых или непосед, остальные - в m_ships.
+    void admit(uint64_t ship, uint64_t id);
+    // Убирает вклад лодки из полосы; если она уплыла к соседу, кладет ее в его очередь.
+    void send(uint64_t ship, uint64_t id);
+    // Убирает лодку index из m_ships в конце тика.
+    void leave(uint64_t index, uint64_t ship);
+    void countShip(uint64_t ship) noexcept;
+    // Тик плывущей лодки: шаг к цели или начало рыбалки. Вернет новое слово лодки.
+    uint64_t floatShip(uint64_t ship, uint64_t id);
+    void stepLazy();
+    void stepRestless();
+    void stepShips();
+    // Рыба клетки; клетку в неопределенном состоянии активирует.
+    uint8_t* cellFish(uint64_t cell);
+    // Улов лодки, у которой закончилась рыбалка, на клетке с cellFish рыбы.
+    void catchFish(Catch& caught, uint8_t& cellFish);
+    // Разрешает рыбалки тика клетку за клеткой, а потом решения после улова - пачками по типам.
+    void resolveCatches();
+    // Решение после улова для пачки рыбалок одного типа; записывает итоговые слова лодок.
+    template <typename Behaviour>
+    void applyBehaviour(const std::vector<Catch>& catches);
+    // Переносит победивших лодок групп в m_ships и убирает из m_restless ушедших из группы.
+    void settleGroups();
+    template <typename Fn>
+    void forEachShip(Fn&& fn) const;
+
+    SimulationConfig m_config;
+    uint64_t m_positionBound;
+    uint64_t m_rowBegin;
+    uint64_t m_rowEnd;
+    uint64_t m_tick = 1;
+    uint64_t m_tickSeed = 0;
+    uint64_t m_hash = 0;
+
+    ShipArray m_ships;
+    // Сквозной номер лодки (номер в начальной популяции) для каждого элемента m_ships.
+    std::vector<uint64_t> m_ids;
+    // Рыбачащие ленивые лодки и плывущие или рыбачащие непоседы по возрастанию (клетка, номер).
+    std::vector<StripeShip> m_lazy;
+    std::vector<StripeShip> m_restless;
+    // Лодки, пришедшие в группы между тиками (от соседей или начавшие рыбачить); вливаются в начале тика.
+    std::vector<StripeShip> m_lazyArrivals;
+    std::vector<StripeShip> m_restlessArrivals;
+    CellTable m_cells;
+    std::vector<std::vector<uint64_t>> m_cellsTimers;
+
+    // Рыбалки тика по типам лодок.
+    std::array<std::vector<Catch>, SHIP_TYPE_COUNT> m_catches;
+    // Лодки, покидающие m_ships, и непоседы, ушедшие из m_restless к соседям или в m_restlessArrivals.
+    std::vector<uint64_t> m_leaving;
+    std::vector<uint64_t> m_restlessRemoved;
+    std::vector<StripeShip> m_toNext;
+    std::vector<StripeShip> m_toPrev;
+    std::vector<StripeCell> m_cellsToNext;
+    std::vector<StripeCell> m_cellsToPrev;
+    StripeStats m_stats;
+};
+
+inline StripeSimulation::StripeSimulation(const SimulationConfig& config, uint64_t rowBegin, uint64_t rowEnd)
+    : m_config(config)
+    , m_positionBound(config.positionBound())
+    , m_rowBegin(rowBegin)
+    , m_rowEnd(rowEnd)
+{
+    m_cellsTimers.resize(m_config.cellTimerMax);
+}
+
+inline bool StripeSimulation::owns(uint64_t position) const noexcept
+{
+    uint64_t row = position / m_config.width;
+    return row >= m_rowBegin && row < m_rowEnd;
+}
+
+inline void StripeSimulation::initShips(const uint64_t* ships, uint64_t count)
+{
+    // Каждая полоса проходит общую популяцию на месте и оставляет себе свои лодки.
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t ship = ships[i];
+        if (((ship >> STATE_SHIFT) & MASK_2BIT) != ShipState::DEAD && owns(positionOf(ship))) {
+            admit(ship, i);
+        }
+    }
+    mergeArrivals(m_lazy, m_lazyArrivals);
+    mergeArrivals(m_restless, m_restlessArrivals);
+    m_stats.activeShips = m_ships.size() + m_lazy.size() + m_restless.size();
+}
+
+inline void StripeSimulation::receive(const StripeShip& ship)
+{
+    admit(ship.ship, ship.id);
+}
+
+inline void StripeSimulation::admit(uint64_t ship, uint64_t id)
+{
+    m_hash += shipStateHash(id, ship);
+    uint8_t shipState = (ship >> STATE_SHIFT) & MASK_2BIT;
+    switch (ship & MASK_2BIT) {
+    case ShipType::LAZY: {
+        if (shipState == ShipState::FISHING) {
+            m_lazyArrivals.push_back({ ship, id });
+            return;
+        }
+        break;
+    }
+    case ShipType::RESTLESS: {
+        if (shipState == ShipState::FISHING || shipState == ShipState::FLOATING) {
+            m_restlessArrivals.push_back({ ship, id });
+            return;
+        }
+        break;
+    }
+    }
+    m_ships.push_back(ship);
+    m_ids.push_back(id);
+}
+
+inline void StripeSimulation::mergeArrivals(std::vector<StripeShip>& group, std::vector<StripeShip>& arrivals)
+{
+    if (arrivals.empty()) {
+        return;
+    }
+    std::sort(arrivals.begin(), arrivals.end(), shipOrder);
+    std::size_t middle = group.size();
+    group.insert(group.end(), arrivals.begin(), arrivals.end());
+    std::inplace_merge(group.begin(), group.begin() + middle, group.end(), shipOrder);
+    arrivals.clear();
+}
+
+inline void StripeSimulation::restoreOrder(std::vector<StripeShip>& group)
+{
+    // В группе остаются лодки, сдвинутые на клетку: они обгоняют немногих, и хватает вставок.
+    // Если сдвигов все же больше, чем лодок, дешевле отсортировать заново.
+    uint64_t shifts = 0;
+    for (uint64_t i = 1; i < group.size(); i++) {
+        StripeShip ship = group[i];
+        uint64_t j = i;
+        while (j > 0 && shipOrder(ship, group[j - 1])) {
+            group[j] = group[j - 1];
+            j--;
+        }
+        group[j] = ship;
+        shifts += i - j;
+        if (shifts > group.size()) {
+            std::sort(group.begin(), group.end(), shipOrder);
+            return;
+        }
+    }
+}
+
+template <typename Fn>
+inline void StripeSimulation::forEachShip(Fn&& fn) const
+{
+    for (uint64_t i = 0; i < m_ships.size(); i++) {
+        fn(m_ships[i], m_ids[i]);
+    }
+    for (const auto* group : { &m_lazy, &m_lazyArrivals, &m_restless, &m_restlessArrivals }) {
+        for (const StripeShip& ship : *group) {
+            fn(ship.ship, ship.id);
+        }
+    }
+}
+
+inline void StripeSimulation::receiveCell(const StripeCell& cell)
+{
+    m_cells.activate(cell.cell, cell.fish, cell.expireTick);
+    m_hash += cellExpiryHash(cell.cell, cell.expireTick) + cellFishHash(cell.cell, cell.fish);
+    // Полный тик истечения восстанавливаем по разности с текущим (тики в таблице 32-битные).
+    uint64_t expireTick = m_tick + static_cast<int32_t>(cell.expireTick - static_cast<uint32_t>(m_tick));
+    m_cellsTimers[expireTick % m_cellsTimers.size()].push_back(cell.cell);
+}
+
+inline void StripeSimulation::setRows(uint64_t rowBegin, uint64_t rowEnd)
+{
+    m_rowBegin = rowBegin;
+    m_rowEnd = rowEnd;
+    m_toNext.clear();
+    m_toPrev.clear();
+    m_cellsToNext.clear();
+    m_cellsToPrev.clear();
+
+    const uint64_t width = m_config.width;
+    auto handOver = [&](uint64_t ship, uint64_t id) {
+        uint64_t position = positionOf(ship);
+        if (owns(position)) {
+            return false;
+        }
+        (position / width < rowBegin ? m_toPrev : m_toNext).push_back({ ship, id });
+        m_hash -= shipStateHash(id, ship);
+        return true;
+    };
+    for (uint64_t i = m_ships.size(); i-- > 0;) {
+        if (handOver(m_ships[i], m_ids[i])) {
+            m_ships[i] = m_ships.back();
+            m_ids[i] = m_ids.back();
+            m_ships.pop_back();
+            m_ids.pop_back();
+        }
+    }
+    // Группы сдвигаются без перестановок, чтобы сохранить порядок по клетке.
+    mergeArrivals(m_lazy, m_lazyArrivals);
+    mergeArrivals(m_restless, m_restlessArrivals);
+    for (auto* group : { &m_lazy, &m_restless }) {
+        group->erase(std::remove_if(group->begin(), group->end(),
+                         [&](const StripeShip& ship) { return handOver(ship.ship, ship.id); }),
+            group->end());
+    }
+
+    m_cells.forEachWithExpiry([&](uint64_t cell, uint8_t fish, uint32_t expireTick) {
+        if (!owns(cell)) {
+            (cell / width < rowBegin ? m_cellsToPrev : m_cellsToNext).push_back({ cell, expireTick, fish });
+        }
+    });
+    // Слоты таймеров отданных клеток остаются: eraseExpired не найдет в таблице этих клеток.
+    for (const auto* cells : { &m_cellsToPrev, &m_cellsToNext }) {
+        for (const StripeCell& cell : *cells) {
+            m_cells.erase(cell.cell);
+            m_hash -= cellExpiryHash(cell.cell, cell.expireTick) + cellFishHash(cell.cell, cell.fish);
+        }
+    }
+}
+
+inline void StripeSimulation::countRowShips(uint32_t* counts) const
+{
+    const uint64_t width = m_config.width;
+    std::fill(counts + m_rowBegin, counts + m_rowEnd, 0);
+    forEachShip([&](uint64_t ship, uint64_t) { counts[positionOf(ship) / width]++; });
+}
+
+inline uint64_t StripeSimulation::hashRows(uint64_t rowBegin, uint64_t rowEnd) const
+{
+    const uint64_t width = m_config.width;
+    auto inRows = [&](uint64_t position) { return position / width >= rowBegin && position / width < rowEnd; };
+    uint64_t hash = 0;
+    forEachShip([&](uint64_t ship, uint64_t id) {
+        if (inRows(positionOf(ship))) {
+            hash += shipStateHash(id, ship);
+        }
+    });
+    m_cells.forEachWithExpiry([&](uint64_t cell, uint8_t fish, uint32_t expireTick) {
+        if (inRows(cell)) {
+            hash += cellExpiryHash(cell, expireTick) + cellFishHash(cell, fish);
+        }
+    });
+    return hash;
+}
+
+inline void StripeSimulation::send(uint64_t ship, uint64_t id)
+{
+    // Вклад лодки уходит вместе с ней: сосед добавит его в receive().
+    m_hash -= shipStateHash(id, ship);
+    uint64_t position = positionOf(ship);
+    if (((ship >> STATE_SHIFT) & MASK_2BIT) == ShipState::DEAD || owns(position)) {
+        return;
+    }
+    // Следующая полоса начинается со строки m_rowEnd (после последней строки - с первой).
+    std::vector<StripeShip>& queue = position / m_config.width == m_rowEnd % m_config.height ? m_toNext : m_toPrev;
+    queue.push_back({ ship, id });
+    m_stats.sentShips++;
+}
+
+inline void StripeSimulation::leave(uint64_t index, uint64_t ship)
+{
+    m_leaving.push_back(index);
+    send(ship, m_ids[index]);
+}
+
+inline void StripeSimulation::step()
+{
+    const uint32_t tick = static_cast<uint32_t>(m_tick);
+    m_tickSeed = mix64(m_config.seed ^ (m_tick * 0xD1B54A32D192ED03ULL));
+
+    auto& expiring = m_cellsTimers[m_tick % m_cellsTimers.size()];
+    for (uint64_t cell : expiring) {
+        uint8_t fish;
+        uint32_t expireTick;
+        if (m_cells.eraseExpired(cell, tick, &fish, &expireTick)) {
+            m_hash -= cellExpiryHash(cell, expireTick) + cellFishHash(cell, fish);
+        }
+    }
+    expiring.clear();
+    mergeArrivals(m_lazy, m_lazyArrivals);
+    mergeArrivals(m_restless, m_restlessArrivals);
+
+    std::array<uint64_t, SHIP_TYPE_COUNT> finished = m_stats.finishedShips;
+    m_stats = StripeStats {};
+    m_stats.finishedShips = finished;
+    for (auto& catches : m_catches) {
+        catches.clear();
+    }
+    m_leaving.clear();
+    m_restlessRemoved.clear();
+    m_toNext.clear();
+    m_toPrev.clear();
+
+    stepLazy();
+    stepRestless();
+    stepShips();
+    resolveCatches();
+    settleGroups();
+
+    // Удаляем с конца, чтобы перенесенная на место удаленной лодка сама не подлежала удалению.
+    std::sort(m_leaving.begin(), m_leaving.end());
+    for (auto it = m_leaving.rbegin(); it != m_leaving.rend(); ++it) {
+        m_ships[*it] = m_ships.back();
+        m_ids[*it] = m_ids.back();
+        m_ships.pop_back();
+        m_ids.pop_back();
+    }
+
+    // Ушедшие к соседям лодки еще в пути, но живы.
+    m_stats.activeShips = m_ships.size() + m_lazy.size() + m_lazyArrivals.size() + m_restless.size()
+        + m_restlessArrivals.size() + m_stats.sentShips;
+    m_stats.cells = m_cells.size();
+    m_tick++;
+}
+
+inline void StripeSimulation::stepLazy()
+{
+    // Ленивым лодкам остается только отсчитать таймер.
+    for (StripeShip& entry : m_lazy) {
+        uint64_t ship = entry.ship;
+        countShip(ship);
+        uint8_t fishTimer = ((ship >> TIMER_SHIFT) & MASK_2BIT) - 1;
+        ship = setbits(ship, TIMER_SHIFT, MASK_2BIT, fishTimer);
+        m_hash += shipStateHash(entry.id, ship) - shipStateHash(entry.id, entry.ship);
+        entry.ship = ship;
+        if (fishTimer == 0) {
+            m_catches[ShipType::LAZY].push_back({ positionOf(ship), entry.id, ship, &entry.ship, 0 });
+        }
+    }
+}
+
+inline void StripeSimulation::stepRestless()
+{
+    // Рыбачащие непоседы стоят на месте, поэтому их рыбалки выходят в порядке группы.
+    for (uint64_t i = 0; i < m_restless.size(); i++) {
+        StripeShip& entry = m_restless[i];
+        uint64_t ship = entry.ship;
+        countShip(ship);
+        if (((ship >> STATE_SHIFT) & MASK_2BIT) == ShipState::FISHING) {
+            uint8_t fishTimer = ((ship >> TIMER_SHIFT) & MASK_2BIT) - 1;
+            ship = setbits(ship, TIMER_SHIFT, MASK_2BIT, fishTimer);
+            if (fishTimer == 0) {
+                m_catches[ShipType::RESTLESS].push_back({ positionOf(ship), entry.id, ship, &entry.ship, 0 });
+            }
+            m_hash += shipStateHash(entry.id, ship) - shipStateHash(entry.id, entry.ship);
+            entry.ship = ship;
+            continue;
+        }
+
+        uint64_t position = positionOf(ship);
+        ship = floatShip(ship, entry.id);
+        m_hash += shipStateHash(entry.id, ship) - shipStateHash(entry.id, entry.ship);
+        entry.ship = ship;
+        uint64_t moved = positionOf(ship);
+        if (!owns(moved)) {
+            m_restlessRemoved.push_back(i);
+            send(ship, entry.id);
+        } else if (moved != position && moved != position + 1) {
+            // Спуск на строку или заворот карты: лодка обгоняет многих, ее проще влить заново.
+            m_restlessRemoved.push_back(i);
+            m_restlessArrivals.push_back(entry);
+        }
+    }
+}
+
+inline void StripeSimulation::stepShips()
+{
+    const uint64_t width = m_config.width;
+    for (uint64_t i = 0; i < m_ships.size(); i++) {
+        uint64_t ship = m_ships[i];
+        uint8_t shipType = ship & MASK_2BIT;
+        uint64_t shipPosition = positionOf(ship);
+        countShip(ship);
+
+        switch ((ship >> STATE_SHIFT) & MASK_2BIT) {
+        case ShipState::FLOATING: {
+            ship = floatShip(ship, m_ids[i]);
+            if (((ship >> STATE_SHIFT) & MASK_2BIT) == ShipState::FISHING && shipType == ShipType::LAZY) {
+                // Ленивая лодка больше не двигается: со следующего тика она в m_lazy.
+                m_leaving.push_back(i);
+                m_lazyArrivals.push_back({ ship, m_ids[i] });
+            } else if (!owns(positionOf(ship))) {
+                leave(i, ship);
+            }
+            break;
+        }
+        case ShipState::FISHING: {
+            uint8_t fishTimer = ((ship >> TIMER_SHIFT) & MASK_2BIT) - 1;
+            ship = setbits(ship, TIMER_SHIFT, MASK_2BIT, fishTimer);
+            if (fishTimer == 0) {
+                // Рыбалки разрешаются после обхода, в порядке, не зависящем от деления на полосы.
+                m_catches[shipType].push_back({ shipPosition, m_ids[i], ship, &m_ships[i], 0 });
+            }
+            break;
+        }
+        case ShipState::FINISHING: {
+            // Лодка уплывает вправо внутри своей строки и исчезает у края карты.
+            if (shipPosition % width + 1 == width) {
+                m_stats.finishedShips[shipType]++;
+                ship = setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::DEAD);
+                leave(i, ship);
+            } else {
+                ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition + 1);
+            }
+            break;
+        }
+        }
+        m_hash += shipStateHash(m_ids[i], ship) - shipStateHash(m_ids[i], m_ships[i]);
+        m_ships[i] = ship;
+    }
+}
+
+inline void StripeSimulation::settleGroups()
+{
+    auto finishing = [](uint64_t ship) { return ((ship >> STATE_SHIFT) & MASK_2BIT) == ShipState::FINISHING; };
+    // Победившая лодка уплывает с карты как обычная; остальные сдвигаются без перестановок.
+    uint64_t kept = 0;
+    for (const StripeShip& ship : m_lazy) {
+        if (finishing(ship.ship)) {
+            m_ships.push_back(ship.ship);
+            m_ids.push_back(ship.id);
+        } else {
+            m_lazy[kept++] = ship;
+        }
+    }
+    m_lazy.resize(kept);
+
+    kept = 0;
+    uint64_t removed = 0;
+    for (uint64_t i = 0; i < m_restless.size(); i++) {
+        const StripeShip ship = m_restless[i];
+        if (removed < m_restlessRemoved.size() && m_restlessRemoved[removed] == i) {
+            removed++;
+        } else if (finishing(ship.ship)) {
+            m_ships.push_back(ship.ship);
+            m_ids.push_back(ship.id);
+        } else {
+            m_restless[kept++] = ship;
+        }
+    }
+    m_restless.resize(kept);
+    restoreOrder(m_restless);
+}
+
+inline void StripeSimulation::countShip(uint64_t ship) noexcept
+{
+    uint64_t fishCount = (ship >> FISH_SHIFT) & MASK_14BIT;
+    m_stats.shipsByType[ship & MASK_2BIT]++;
+    m_stats.fishSum += fishCount;
+    m_stats.minFishCount = std::min(m_stats.minFishCount, fishCount);
+    m_stats.maxFishCount = std::max(m_stats.maxFishCount, fishCount);
+}
+
+// Движение то же, что в Simulation::step: сначала по x, потом по y, по клетке за тик.
+inline uint64_t StripeSimulation::floatShip(uint64_t ship, uint64_t id)
+{
+    const uint64_t width = m_config.width;
+    const uint64_t positionBound = m_positionBound;
+    uint64_t shipPosition = positionOf(ship);
+    int64_t offsetX = static_cast<int64_t>((ship >> OFFSET_X_SHIFT) & MASK_4BIT) - 8;
+    int64_t offsetY = static_cast<int64_t>((ship >> OFFSET_Y_SHIFT) & MASK_4BIT) - 8;
+    if (offsetX == 0 && offsetY == 0) {
+        ship = setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::FISHING);
+        return setbits(ship, TIMER_SHIFT, MASK_2BIT, 1 + randomBelow(random(id, Stream::TIMER), 3));
+    }
+    if (offsetX > 0) {
+        offsetX--;
+        shipPosition = shipPosition == positionBound ? 0 : shipPosition + 1;
+        ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, offsetX + 8);
+    } else if (offsetX < 0) {
+        offsetX++;
+        shipPosition = shipPosition == 0 ? positionBound : shipPosition - 1;
+        ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, offsetX + 8);
+    } else if (offsetY > 0) {
+        offsetY--;
+        shipPosition = shipPosition < width ? positionBound - (width - shipPosition - 1) : shipPosition - width;
+        ship = setbits(ship, OFFSET_Y_SHIFT, MASK_4BIT, offsetY + 8);
+    } else {
+        offsetY++;
+        shipPosition = shipPosition + width > positionBound ? width - (positionBound - shipPosition) - 1 : shipPosition + width;
+        ship = setbits(ship, OFFSET_Y_SHIFT, MASK_4BIT, offsetY + 8);
+    }
+    return setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
+}
+
+inline uint8_t* StripeSimulation::cellFish(uint64_t cell)
+{
+    const uint32_t tick = static_cast<uint32_t>(m_tick);
+    uint8_t* fish = m_cells.find(cell, tick);
+    if (fish != nullptr) {
+        return fish;
+    }
+    // Клетка была в неопределенном состоянии: рыба и таймер зависят только от клетки и тика.
+    uint8_t cellFishCounter = static_cast<uint8_t>(randomBelow(random(cell, Stream::CELL_FISH), 16));
+    uint64_t timerRange = static_cast<uint64_t>(m_config.cellTimerMax - m_config.cellTimerMin + 1);
+    uint64_t cellTimeout = m_config.cellTimerMin + randomBelow(random(cell, Stream::CELL_TIMER), timerRange);
+    m_cellsTimers[(m_tick + cellTimeout) % m_cellsTimers.size()].push_back(cell);
+    m_hash += cellExpiryHash(cell, static_cast<uint32_t>(m_tick + cellTimeout)) + cellFishHash(cell, cellFishCounter);
+    return m_cells.activate(cell, cellFishCounter, static_cast<uint32_t>(m_tick + cellTimeout));
+}
+
+// Правила улова те же, что в Simulation::step; что лодка делает дальше, решает applyBehaviour.
+inline void StripeSimulation::catchFish(Catch& caught, uint8_t& cellFish)
+{
+    uint64_t catchRange = static_cast<uint64_t>(m_config.catchMax - m_config.catchMin + 1);
+    uint8_t fishCatched = static_cast<uint8_t>(m_config.catchMin + randomBelow(random(caught.id, Stream::CATCH), catchRange));
+    fishCatched = std::min(fishCatched, cellFish);
+    cellFish -= fishCatched;
+    caught.cellFish = cellFish;
+
+    uint64_t shipFishCounter = std::min<uint64_t>(((caught.ship >> FISH_SHIFT) & MASK_14BIT) + fishCatched, m_config.winFishCount);
+    caught.ship = setbits(caught.ship, FISH_SHIFT, MASK_14BIT, shipFishCounter);
+    if (shipFishCounter == m_config.winFishCount) {
+        caught.ship = setbits(caught.ship, STATE_SHIFT, MASK_2BIT, ShipState::FINISHING);
+    }
+}
+
+/*
+Рыбалки разных клеток друг от друга не зависят, а на одной клетке идут по возрастанию номера
+лодки. Списки типов упорядочиваются по (клетка, номер) - рыбалки групп уже так упорядочены - и
+сливаются: клетка ищется (или активируется) один раз на все свои рыбалки тика. Решение после
+улова зависит только от лодки и оставшейся на клетке рыбы, поэтому его принимает ядро своего
+типа над всем списком сразу.
+*/
+inline void StripeSimulation::resolveCatches()
+{
+    for (auto& catches : m_catches) {
+        if (!std::is_sorted(catches.begin(), catches.end(), catchOrder)) {
+            std::sort(catches.begin(), catches.end(), catchOrder);
+        }
+    }
+
+    std::array<std::size_t, SHIP_TYPE_COUNT> next {};
+    // Рыбалка с наименьшим ключом среди голов списков или nullptr, если списки кончились.
+    auto head = [&]() -> Catch* {
+        Catch* first = nullptr;
+        for (int type = 0; type < SHIP_TYPE_COUNT; type++) {
+            if (next[type] < m_catches[type].size() && (first == nullptr || catchOrder(m_catches[type][next[type]], *first))) {
+                first = &m_catches[type][next[type]];
+            }
+        }
+        return first;
+    };
+    for (Catch* caught = head(); caught != nullptr;) {
+        const uint64_t cell = caught->cell;
+        uint8_t* fish = cellFish(cell);
+        uint8_t fishBefore = *fish;
+        for (; caught != nullptr && caught->cell == cell; caught = head()) {
+            catchFish(*caught, *fish);
+            next[caught->ship & MASK_2BIT]++;
+        }
+        m_hash += cellFishHash(cell, *fish) - cellFishHash(cell, fishBefore);
+    }
+
+    ShipBehaviours::forEach([&](auto behaviour) {
+        applyBehaviour<decltype(behaviour)>(m_catches[decltype(behaviour)::TYPE]);
+    });
+}
+
+template <typename Behaviour>
+inline void StripeSimulation::applyBehaviour(const std::vector<Catch>& catches)
+{
+    for (const Catch& caught : catches) {
+        uint64_t ship = caught.ship;
+        if (((ship >> STATE_SHIFT) & MASK_2BIT) != ShipState::FINISHING) {
+            BehaviourDraw draw { *this, caught.id };
+            ship = Behaviour::afterCatch(ship, caught.cellFish, draw);
+        }
+        m_hash += shipStateHash(caught.id, ship) - shipStateHash(caught.id, *caught.slot);
+        *caught.slot = ship;
+    }
+}
@@ -0,0 +1,541 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include "Ensemble.hpp"
+#include "Options.hpp"
+#include "Parallel.hpp"
+#include "Simulation.hpp"
+
+/*
+Описание сетки параметров для перебора.
+Каждый список - значения одной оси, точки сетки - их декартово произведение.
+Пустой список означает единственное значение из базовой конфигурации.
+*/
+struct SweepConfig {
+    SimulationConfig base;
+    std::vector<uint64_t> widths;
+    std::vector<uint64_t> heights;
+    std::vector<uint64_t> shipCounts;
+    std::vector<uint64_t> winFishCounts;
+    std::vector<std::pair<int, int>> catchRanges;
+    std::vector<std::pair<int, int>> cellTimerRanges;
+    std::vector<std::array<uint32_t, SHIP_TYPE_COUNT>> typeMixes;
+
+    // Не меньше minRuns прогонов на точку, затем до maxRuns, пока метрики не сойдутся.
+    uint64_t minRuns = 5;
+    uint64_t maxRuns = 100;
+    // Допустимая относительная стандартная ошибка средних отслеживаемых метрик.
+    double tolerance = 0.01;
+    uint64_t maxTicks = 1'000'000;
+    // Ограничение суммарной оценки памяти одновременно идущих прогонов. 0 - 80% физической памяти.
+    uint64_t memoryBudgetBytes = 0;
+    unsigned threads = 0;
+};
+
+// Одна точка сетки.
+struct SweepPoint {
+    SimulationConfig config;
+    // Номер точки в исходном порядке сетки, из него выводятся сиды прогонов.
+    uint64_t index = 0;
+    // Значения параметров в формате CSV, по ним точки узнаются при возобновлении.
+    std::string key;
+    // Относительная оценка длительности одного прогона.
+    double cost = 0;
+    uint64_t memoryBytes = 0;
+};
+
+// Среднее и дисперсия с накоплением по одному значению (алгоритм Уэлфорда).
+struct RunningStat {
+    uint64_t count = 0;
+    double mean = 0;
+    double m2 = 0;
+
+    void add(double value)
+    {
+        count++;
+        double delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+    }
+
+    // Относительная стандартная ошибка среднего.
+    double relativeError() const
+    {
+        if (count < 2 || mean == 0) {
+            return count < 2 ? INFINITY : 0;
+        }
+        return std::sqrt(m2 / (count - 1) / count) / std::abs(mean);
+    }
+};
+
+inline std::string_view trim(std::string_view text)
+{
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// Делит строку по разделителю, обрезая пробелы у частей.
+inline std::vector<std::string_view> splitList(std::string_view text, char separator)
+{
+    std::vector<std::string_view> parts;
+    while (true) {
+        std::size_t pos = text.find(separator);
+        parts.push_back(trim(text.substr(0, pos)));
+        if (pos == std::string_view::npos) {
+            return parts;
+        }
+        text.remove_prefix(pos + 1);
+    }
+}
+
+/*
+Читает сетку из текстового файла вида:
+
+    # комментарий
+    ships = 1000, 10000
+    win-fish = 100, 1000
+    catch = 1-10, 1-5
+    cell-timer = 15-30
+    types = 1:1:1, 2:1:1
+    min-runs = 5
+    max-runs = 200
+    tolerance = 0.01
+
+Также поддерживаются width, height, max-ticks и memory-mb.
+*/
+inline bool loadSweepGrid(const std::string& path, SweepConfig& config, std::string& error)
+{
+    std::ifstream in(path);
+    if (!in) {
+        error = "не удалось открыть файл сетки " + path;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::string_view text = line;
+        text = trim(text.substr(0, text.find('#')));
+        if (text.empty()) {
+            continue;
+        }
+
+        std::size_t eq = text.find('=');
+        if (eq == std::string_view::npos) {
+            error = "строка " + std::to_string(lineNumber) + ": ожидается 'ключ = значения'";
+            return false;
+        }
+        std::string_view key = trim(text.substr(0, eq));
+        std::vector<std::string_view> values = splitList(text.substr(eq + 1), ',');
+
+        bool ok = true;
+        auto parseUints = [&](std::vector<uint64_t>& dst) {
+            for (std::string_view v : values) {
+                std::optional<uint64_t> n = parseUint(v);
+                ok = ok && n.has_value();
+                dst.push_back(n.value_or(0));
+            }
+        };
+        auto parseRanges = [&](std::vector<std::pair<int, int>>& dst) {
+            for (std::string_view v : values) {
+                std::vector<std::string_view> bounds = splitList(v, '-');
+                std::optional<uint64_t> lo = bounds.size() == 2 ? parseUint(bounds[0]) : std::nullopt;
+                std::optional<uint64_t> hi = bounds.size() == 2 ? parseUint(bounds[1]) : std::nullopt;
+                ok = ok && lo && hi;
+                dst.emplace_back(static_cast<int>(lo.value_or(0)), static_cast<int>(hi.value_or(0)));
+            }
+        };
+        auto parseScalar = [&]() -> uint64_t {
+            std::optional<uint64_t> n = values.size() == 1 ? parseUint(values[0]) : std::nullopt;
+            ok = ok && n.has_value();
+            return n.value_or(0);
+        };
+
+        if (key == "width") {
+            parseUints(config.widths);
+        } else if (key == "height") {
+            parseUints(config.heights);
+        } else if (key == "ships") {
+            parseUints(config.shipCounts);
+        } else if (key == "win-fish") {
+            parseUints(config.winFishCounts);
+        } else if (key == "catch") {
+            parseRanges(config.catchRanges);
+        } else if (key == "cell-timer") {
+            parseRanges(config.cellTimerRanges);
+        } else if (key == "types") {
+            for (std::string_view v : values) {
+                std::vector<std::string_view> weights = splitList(v, ':');
+                std::array<uint32_t, SHIP_TYPE_COUNT> mix {};
+                // Вес искателей можно не указывать.
+                ok = ok && (weights.size() == SHIP_TYPE_COUNT || weights.size() + 1 == SHIP_TYPE_COUNT);
+                for (std::size_t t = 0; ok && t < weights.size(); t++) {
+                    std::optional<uint64_t> n = parseUint(weights[t]);
+                    ok = n.has_value();
+                    mix[t] = static_cast<uint32_t>(n.value_or(0));
+                }
+                config.typeMixes.push_back(mix);
+            }
+        } else if (key == "min-runs") {
+            config.minRuns = parseScalar();
+        } else if (key == "max-runs") {
+            config.maxRuns = parseScalar();
+        } else if (key == "max-ticks") {
+            config.maxTicks = parseScalar();
+        } else if (key == "memory-mb") {
+            config.memoryBudgetBytes = parseScalar() << 20;
+        } else if (key == "tolerance") {
+            std::string value(values.size() == 1 ? values[0] : "");
+            char* end = nullptr;
+            config.tolerance = std::strtod(value.c_str(), &end);
+            ok = !value.empty() && end == value.c_str() + value.size() && config.tolerance >= 0;
+        } else {
+            error = "строка " + std::to_string(lineNumber) + ": неизвестный параметр " + std::string(key);
+            return false;
+        }
+
+        if (!ok) {
+            error = "строка " + std::to_string(lineNumber) + ": некорректное значение параметра " + std::string(key);
+            return false;
+        }
+    }
+
+    if (config.minRuns == 0 || config.maxRuns < config.minRuns) {
+        error = "должно выполняться 0 < min-runs <= max-runs";
+        return false;
+    }
+    return true;
+}
+
+inline const char* sweepCsvHeader()
+{
+    return "width,height,ships,win_fish,catch_min,catch_max,cell_timer_min,cell_timer_max,"
+           "greedy_weight,lazy_weight,restless_weight,seeker_weight,"
+           "runs,completed,converged,ticks_mean,ticks_rel_err,ticks_p50,ticks_p95,"
+           "greedy_finish_mean,lazy_finish_mean,restless_finish_mean,seeker_finish_mean";
+}
+
+// Количество столбцов-параметров в начале строки CSV.
+constexpr int SWEEP_KEY_COLUMNS = 12;
+
+/*
+Грубая оценка памяти одного прогона. Активных клеток порядка числа лодок: на них таблица клеток
+(слоты с заполнением не больше половины) и индекс в кольцевом буфере таймеров. На лодку - ее слово,
+запомненный слот клетки и место в списке второго прохода тика. Сводка рыбы нужна только искателям.
+*/
+inline uint64_t estimateMemoryBytes(const SimulationConfig& config)
+{
+    uint64_t bytes = CellTable::memoryBytesFor(config.shipCount) + config.shipCount * sizeof(uint64_t);
+    bytes += config.shipCount * (sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint64_t));
+    if (config.typeWeights[ShipType::SEEKER] > 0) {
+        uint64_t tiles = (config.width + FishIndex::TILE - 1) / FishIndex::TILE * ((config.height + FishIndex::TILE - 1) / FishIndex::TILE);
+        bytes += std::min(tiles * (sizeof(uint16_t) + FishIndex::LEVELS), FishIndex::MAX_BYTES);
+    }
+    return bytes;
+}
+
+// Разворачивает сетку в список точек, отсортированный от самых долгих к самым быстрым.
+inline std::vector<SweepPoint> expandGrid(const SweepConfig& config)
+{
+    auto orBase = [](auto values, auto base) {
+        if (values.empty()) {
+            values.push_back(base);
+        }
+        return values;
+    };
+    const SimulationConfig& base = config.base;
+    auto widths = orBase(config.widths, base.width);
+    auto heights = orBase(config.heights, base.height);
+    auto shipCounts = orBase(config.shipCounts, base.shipCount);
+    auto winFishCounts = orBase(config.winFishCounts, base.winFishCount);
+    auto catchRanges = orBase(config.catchRanges, std::make_pair(base.catchMin, base.catchMax));
+    auto cellTimerRanges = orBase(config.cellTimerRanges, std::make_pair(base.cellTimerMin, base.cellTimerMax));
+    auto typeMixes = orBase(config.typeMixes, base.typeWeights);
+
+    std::vector<SweepPoint> points;
+    for (uint64_t width : widths)
+        for (uint64_t height : heights)
+            for (uint64_t ships : shipCounts)
+                for (uint64_t winFish : winFishCounts)
+                    for (auto catchRange : catchRanges)
+                        for (auto cellTimerRange : cellTimerRanges)
+                            for (auto typeMix : typeMixes) {
+                                SweepPoint point;
+                                point.config = base;
+                                point.config.width = width;
+                                point.config.height = height;
+                                point.config.shipCount = ships;
+                                point.config.winFishCount = winFish;
+                                point.config.catchMin = catchRange.first;
+                                point.config.catchMax = catchRange.second;
+                                point.config.cellTimerMin = cellTimerRange.first;
+                                point.config.cellTimerMax = cellTimerRange.second;
+                                point.config.typeWeights = typeMix;
+                                point.index = points.size();
+
+                                std::ostringstream key;
+                                key << width << ',' << height << ',' << ships << ',' << winFish << ','
+                                    << catchRange.first << ',' << catchRange.second << ','
+                                    << cellTimerRange.first << ',' << cellTimerRange.second << ','
+                                    << typeMix[0] << ',' << typeMix[1] << ',' << typeMix[2] << ',' << typeMix[3];
+                                point.key = key.str();
+
+                                // Длительность прогона растет с числом лодок и рыбой для победы
+                                // и обратно пропорциональна среднему улову.
+                                double meanCatch = (catchRange.first + catchRange.second) / 2.0 + 1.0;
+                                point.cost = static_cast<double>(ships) * static_cast<double>(winFish) / meanCatch;
+                                point.memoryBytes = estimateMemoryBytes(point.config);
+                                points.push_back(point);
+                            }
+
+    std::stable_sort(points.begin(), points.end(), [](const SweepPoint& a, const SweepPoint& b) {
+        return a.cost > b.cost;
+    });
+    return points;
+}
+
+// Читает ключи уже записанных точек из существующего файла результатов.
+inline std::set<std::string> readCompletedPoints(const std::string& path)
+{
+    std::string_view header = sweepCsvHeader();
+    auto columnsInHeader = std::count(header.begin(), header.end(), ',');
+
+    std::set<std::string> completed;
+    std::ifstream in(path);
+    std::string line;
+    bool first = true;
+    while (std::getline(in, line)) {
+        if (first) {
+            first = false;
+            continue;
+        }
+        // Оборванная при падении строка короче заголовка и не учитывается.
+        if (std::count(line.begin(), line.end(), ',') != columnsInHeader) {
+            continue;
+        }
+        // Ключ - первые SWEEP_KEY_COLUMNS столбцов.
+        std::size_t pos = 0;
+        for (int column = 0; column < SWEEP_KEY_COLUMNS; column++) {
+            pos = line.find(',', pos) + 1;
+        }
+        completed.insert(line.substr(0, pos - 1));
+    }
+    return completed;
+}
+
+// Физическая память машины; sysconf с _SC_PHYS_PAGES есть и на Linux, и на macOS.
+inline uint64_t physicalMemoryBytes()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && pageSize > 0) {
+        return static_cast<uint64_t>(pages) * static_cast<uint64_t>(pageSize);
+    }
+#endif
+    return 8ULL << 30;
+}
+
+/*
+Перебирает точки сетки на всех ядрах и дописывает по строке CSV на каждую законченную точку.
+
+Прогоны раздаются по точкам от самых долгих к самым быстрым, так что в конце
+не остается одного длинного хвоста. На одной точке могут одновременно работать несколько потоков.
+Точка перестает получать новые прогоны, когда выполнено minRuns и относительная ошибка
+средних всех отслеживаемых метрик не больше tolerance, либо выполнено maxRuns.
+Новый прогон стартует, только если оценка его памяти помещается в бюджет вместе с уже идущими,
+поэтому тяжелые конфигурации не запускаются на всех ядрах сразу.
+Точки, уже записанные в файл результатов, пропускаются - так перебор продолжается после падения.
+*/
+inline bool runSweep(const SweepConfig& config, const std::string& outPath, std::ostream& log, std::string& error)
+{
+    struct PointState {
+        EnsembleReport report;
+        RunningStat ticks;
+        std::array<RunningStat, SHIP_TYPE_COUNT> finish;
+        uint64_t started = 0;
+        uint64_t inflight = 0;
+        bool converged = false;
+        bool written = false;
+    };
+
+    std::vector<SweepPoint> points = expandGrid(config);
+    for (const SweepPoint& point : points) {
+        if (!point.config.valid()) {
+            error = "точка " + point.key + " не помещается в упакованное представление лодки";
+            return false;
+        }
+    }
+
+    std::set<std::string> completed = readCompletedPoints(outPath);
+    std::vector<PointState> states(points.size());
+    uint64_t remaining = 0;
+    for (std::size_t p = 0; p < points.size(); p++) {
+        states[p].written = completed.count(points[p].key) > 0;
+        remaining += states[p].written ? 0 : 1;
+    }
+    log << "Sweep: " << points.size() << " points, " << points.size() - remaining << " already done" << std::endl;
+
+    bool writeHeader = completed.empty();
+    std::ofstream out(outPath, writeHeader ? std::ios::trunc : std::ios::app);
+    if (!out) {
+        error = "не удалось открыть файл результатов " + outPath;
+        return false;
+    }
+    if (writeHeader) {
+        out << sweepCsvHeader() << "\n";
+        out.flush();
+    } else {
+        // Строка, оборванная при падении, не должна склеиться со следующей.
+        std::ifstream tail(outPath, std::ios::binary | std::ios::ate);
+        if (tail.tellg() > 0) {
+            tail.seekg(-1, std::ios::end);
+            if (tail.get() != '\n') {
+                out << "\n";
+            }
+        }
+    }
+
+    uint64_t budget = config.memoryBudgetBytes ? config.memoryBudgetBytes : physicalMemoryBytes() / 10 * 8;
+    unsigned threads = resolveThreads(config.threads);
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    uint64_t memoryInUse = 0;
+    uint64_t running = 0;
+
+    // Может ли точка получить еще один прогон.
+    auto wantsRun = [&](const PointState& state) {
+        return !state.written && !state.converged && state.started < config.maxRuns;
+    };
+
+    // Записывает строку точки, когда по ней больше не будет прогонов. Вызывается под мьютексом.
+    auto finishPoint = [&](std::size_t p) {
+        PointState& state = states[p];
+        if (state.written || state.inflight > 0 || wantsRun(state)) {
+            return;
+        }
+        state.written = true;
+        remaining--;
+        out << points[p].key << ',' << state.report.runs << ',' << state.report.completedRuns << ','
+            << (state.converged ? 1 : 0) << ',' << state.ticks.mean << ',' << state.ticks.relativeError() << ','
+            << histogramQuantile(state.report.ticksToEmpty, 0.5) << ','
+            << histogramQuantile(state.report.ticksToEmpty, 0.95);
+        for (const RunningStat& finish : state.finish) {
+            out << ',' << finish.mean;
+        }
+        out << "\n";
+        out.flush();
+        log << "Point " << points[p].key << ": " << state.report.runs << " runs, mean ticks " << state.ticks.mean << std::endl;
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            pinCurrentThread(t);
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                // Первая по порядку (самая долгая) точка, которой нужен прогон и которая помещается в память.
+                std::size_t chosen = points.size();
+                bool anyWanted = false;
+                for (std::size_t p = 0; p < points.size(); p++) {
+                    if (!wantsRun(states[p])) {
+                        continue;
+                    }
+                    anyWanted = true;
+                    if (running == 0 || memoryInUse + points[p].memoryBytes <= budget) {
+                        chosen = p;
+                        break;
+                    }
+                }
+                if (chosen == points.size()) {
+                    if (!anyWanted) {
+                        wake.notify_all();
+                        return;
+                    }
+                    wake.wait(lock);
+                    continue;
+                }
+
+                PointState& state = states[chosen];
+                uint64_t run = state.started++;
+                state.inflight++;
+                running++;
+                memoryInUse += points[chosen].memoryBytes;
+                lock.unlock();
+
+                SimulationConfig simConfig = points[chosen].config;
+                simConfig.scenario.threads = 1;
+                simConfig.recordFinishTicks = true;
+                simConfig.seed = runSeed(runSeed(config.base.seed, points[chosen].index), run);
+                Simulation sim(simConfig);
+                while (!sim.finished() && sim.tick() <= config.maxTicks) {
+                    sim.step();
+                }
+
+                lock.lock();
+                state.report.addRun(sim);
+                if (sim.finished()) {
+                    state.ticks.add(static_cast<double>(sim.tick() - 1));
+                }
+                for (int type = 0; type < SHIP_TYPE_COUNT; type++) {
+                    // Среднее время ухода лодок данного типа в этом прогоне.
+                    const std::vector<uint64_t>& counts = sim.finishTicks(type);
+                    double sum = 0;
+                    uint64_t n = 0;
+                    for (std::size_t tick = 0; tick < counts.size(); tick++) {
+                        sum += static_cast<double>(tick) * counts[tick];
+                        n += counts[tick];
+                    }
+                    if (n > 0) {
+                        state.finish[type].add(sum / n);
+                    }
+                }
+
+                bool converged = state.report.runs >= config.minRuns && state.ticks.relativeError() <= config.tolerance;
+                for (const RunningStat& finish : state.finish) {
+                    converged = converged && (finish.count == 0 || finish.relativeError() <= config.tolerance);
+                }
+                state.converged = state.converged || converged;
+
+                state.inflight--;
+                running--;
+                memoryInUse -= points[chosen].memoryBytes;
+                finishPoint(chosen);
+                wake.notify_all();
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return true;
+}
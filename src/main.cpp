@@ -1,102 +1,193 @@
 #include <SFML/Graphics.hpp>
-#include <algorithm>
+#include <chrono>
 #include <cstdint>
-#include <unordered_map>
 #include <vector>
-#include <math.h>
 #include <random>
 #include <iostream>
 
 #include "Renderer.hpp"
+#include "Bench.hpp"
 #include "InfoPanel.hpp"
+#include "Latency.hpp"
+#include "MetricsServer.hpp"
+#include "Simulation.hpp"
+#include "Ensemble.hpp"
+#include "Options.hpp"
+#include "PerfCounters.hpp"
+#include "Population.hpp"
+#include "Remote.hpp"
+#include "Sharded.hpp"
+#include "Soak.hpp"
+#include "Sweep.hpp"
 
 #define WIDTH 10'000ULL
 #define HEIGHT 10'000ULL
-#define POSITION_BOUND WIDTH* HEIGHT - 1
 #define SHIP_COUNT 100'000ULL
 #define WIN_FISH_COUNT 10'000LL
 #define TICKS_PER_SECOND 10
 #define TICK_DURATION_MS (1000 / TICKS_PER_SECOND)
+#define INJECT_SHIP_COUNT 100'000ULL // Сколько лодок добавляет клавиша I в видимую область.
 
-// Тип лодки
-enum ShipType {
-    // Жадная
-    GREEDY = 0,
-    // Ленивая
-    LAZY = 1,
-    // Непоседливая
-    RESTLESS = 2,
-};
+int main(int argc, char** argv)
+{
+    Options options;
+    options.simulation.width = WIDTH;
+    options.simulation.height = HEIGHT;
+    options.simulation.shipCount = SHIP_COUNT;
+    options.simulation.winFishCount = WIN_FISH_COUNT;
+    options.tickDeadlineMs = TICK_DURATION_MS;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (options.help) {
+        printUsage(std::cout);
+        return 0;
+    }
+    if (!options.seedSet) {
+        options.simulation.seed = std::random_device {}();
+    }
 
-// Состояние лодки
-enum ShipState {
-    // Плывет
-    FLOATING = 0,
-    // Ждет конца рыбалки
-    FISHING = 1,
-    // Накопила победное число рыбы и уплывает
-    FINISHING = 2,
-    // Ушла с карты
-    DEAD = 3,
-};
+    if (!options.writePopulationFile.empty()) {
+        // Генерируем популяцию параллельно и сохраняем для последующих запусков.
+        const SimulationConfig& config = options.simulation;
+        ShipGenerator generator(config.scenario, config.width, config.height, config.typeWeights, config.seed);
+        ShipArray ships(config.shipCount);
+        generator.fillParallel(ships.data(), ships.size());
+        std::string error;
+        if (!writePopulationFile(options.writePopulationFile, config.width, config.height, ships, error)) {
+            std::cout << "Ошибка: " << error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
 
-/*
-Данные лодки упакованы в 64-битное число.
-Ниже расшифровка, начиная со старшего бита:
+    PopulationFile population;
+    if (!options.populationFile.empty()) {
+        // Число лодок, а для бинарного файла и размер карты, берутся из файла.
+        CsvParseOptions csv;
+        csv.width = options.simulation.width;
+        csv.height = options.simulation.height;
+        csv.maxFish = options.simulation.winFishCount;
+        csv.seed = options.simulation.seed;
+        std::string error;
+        if (!population.openFromFile(options.populationFile, csv, error)) {
+            std::cout << "Ошибка: " << error << std::endl;
+            return 1;
+        }
+        options.simulation.width = population.width();
+        options.simulation.height = population.height();
+        options.simulation.shipCount = population.count();
+        options.simulation.population = &population;
+    }
 
-[2 бита - паддинг]
-[4 бита - смещение по y]
-[4 бита - смещение по x]
-[34 бита - положение лодки (от 0 до 10^10-1 < 2^34 => 34 бита требуется)]
-[14 бит - сколько рыбы выловила лодка (от 0 до 10000 < 2^14 => 14 бит требуется)]
-[2 бита - таймер закидывания сети (1-3 тика)]
-[2 бита - состояние лодки]
-[2 бита - тип лодки]
+    MetricsServer metrics;
+    if (options.metricsPort > 0) {
+        std::string error;
+        if (!metrics.start(static_cast<uint16_t>(options.metricsPort), error)) {
+            std::cout << "Ошибка: " << error << std::endl;
+            return 1;
+        }
+    }
 
-Положение лодки хранится как одно число p < 100'000 * 100'000 (10^10).
-Cмещения - когда лодка куда-то плывет, можно хранить не новую координату,
-а смещение от текущей по x и y, декрементируя их каждый тик.
-По 4 бита выбраны, чтобы в целом обеспечить 16 значений на координату:
-от 0 до 15 или от -8 до +7, реализуя смещения в плюс и минус координату.
-Таким образом, следующую клетку лодка выберет в радиусе 7-8 клеток.
-*/
+    if (options.benchTicks > 0) {
+        // Замер производительности без окна.
+        BenchConfig bench;
+        bench.simulation = options.simulation;
+        bench.ticks = options.benchTicks;
+        bench.tickDeadlineMs = options.tickDeadlineMs;
+        bench.perf = options.perf;
+        runBench(bench, std::cout);
+        return 0;
+    }
 
-// Константы сдвигов и масок для различных значений лодки.
-constexpr int STATE_SHIFT = 2;
-constexpr int TIMER_SHIFT = 4;
-constexpr int FISH_SHIFT = 6;
-constexpr int POSITION_SHIFT = 20;
-constexpr int OFFSET_X_SHIFT = 54;
-constexpr int OFFSET_Y_SHIFT = 58;
-constexpr uint64_t MASK_2BIT = 0x3ULL;
-constexpr uint64_t MASK_4BIT = 0xFULL;
-constexpr uint64_t MASK_14BIT = 0x3FFFULL;
-constexpr uint64_t MASK_34BIT = 0x3FFFFFFFFULL;
+    if (options.soakSeconds > 0) {
+        // Длительный прогон без окна.
+        SoakConfig soak;
+        soak.simulation = options.simulation;
+        soak.durationSeconds = options.soakSeconds;
+        soak.reportIntervalSeconds = options.reportIntervalSeconds;
+        soak.tickDeadlineMs = options.tickDeadlineMs;
+        soak.slowTicks = options.slowTicks;
+        soak.metrics = metrics.running() ? &metrics : nullptr;
+        runSoak(soak, std::cout);
+        return 0;
+    }
 
-// Инициализация распределений для значений симуляции.
-std::uniform_int_distribution<int> shipTypeRng { 0, 2 };
-std::uniform_int_distribution<int> shipTimerRng { 1, 3 };
-std::uniform_int_distribution<int64_t> shipPositionRng { 0, POSITION_BOUND };
-std::uniform_int_distribution<int> shipOffsetRng { 0, 15 };
-std::uniform_int_distribution<int> catchRng { 1, 10 };
-std::uniform_int_distribution<int> fishRng { 0, 15 };
-std::uniform_int_distribution<int> cellTimerRnd { 15, 30 };
+    if (!options.serveAddress.empty()) {
+        // Симуляция без окна, ее область рисуют клиенты --connect.
+        ServeConfig serve;
+        serve.simulation = options.simulation;
+        serve.address = options.serveAddress;
+        serve.tickMs = TICK_DURATION_MS;
+        serve.tickDeadlineMs = options.tickDeadlineMs;
+        serve.metrics = metrics.running() ? &metrics : nullptr;
+        std::string error;
+        if (!runServe(serve, std::cout, error)) {
+            std::cout << "Ошибка: " << error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
 
-std::mt19937 rng(std::random_device {}());
+    if (options.shards > 0) {
+        // Прогон без окна, поделенный на полосы карты.
+        ShardedConfig sharded;
+        sharded.simulation = options.simulation;
+        sharded.shards = options.shards;
+        sharded.threads = options.shardThreads;
+        sharded.maxTicks = options.maxTicks;
+        sharded.rebalanceInterval = options.rebalanceInterval;
+        sharded.rebalanceThreshold = options.rebalanceThreshold;
+        sharded.verify = options.verifyShards;
+        std::string error;
+        if (!runSharded(sharded, std::cout, error)) {
+            std::cout << "Ошибка: " << error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
 
-// Устанавливает указанное значение с указанной маской и смещением. Вернет обновленное число.
-inline uint64_t setbits(uint64_t n, uint64_t shift, uint64_t mask, uint64_t value)
-{
-    n &= ~(mask << shift); // Обнуляем значение.
-    n |= ((value & mask) << shift); // Устанавливаем новое.
-    return n;
-}
+    if (options.ensemble) {
+        // Серия прогонов без окна.
+        EnsembleConfig ensemble;
+        ensemble.simulation = options.simulation;
+        ensemble.runs = options.runs;
+        ensemble.threads = options.threads;
+        ensemble.maxTicks = options.maxTicks;
+        EnsembleReport report = runEnsemble(ensemble);
+        report.print(std::cout);
+        return 0;
+    }
+
+    if (!options.sweepGrid.empty()) {
+        // Перебор сетки параметров без окна.
+        SweepConfig sweep;
+        sweep.base = options.simulation;
+        sweep.threads = options.threads;
+        sweep.maxTicks = options.maxTicks;
+        std::string error;
+        if (!loadSweepGrid(options.sweepGrid, sweep, error) || !runSweep(sweep, options.sweepOut, std::cout, error)) {
+            std::cout << "Ошибка: " << error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Удаленный просмотр: размер карты присылает сервер.
+    RemoteView remote;
+    if (!options.connectAddress.empty()) {
+        std::string error;
+        if (!remote.connect(options.connectAddress, error)) {
+            std::cout << "Ошибка: " << error << std::endl;
+            return 1;
+        }
+        options.simulation.width = remote.width();
+        options.simulation.height = remote.height();
+    }
 
-int main()
-{
     // Инициализация отрисовки.
     sf::RenderWindow window(sf::VideoMode(sf::Vector2u(800, 600)), "GrandFishing");
-    Renderer renderer(window, WIDTH, HEIGHT, 12);
+    Renderer renderer(window, options.simulation.width, options.simulation.height, 12);
     // Инициализация панели информации.
     sf::Font font;
     if (!font.openFromFile("Inter.ttf")) {
@@ -105,414 +196,146 @@ int main()
     }
     InfoPanel info(window, font);
 
-    /*
-    Карта для хранения только активных клеток.
-    Ключ - координата клетки, аналогична положению лодки - индекс от 0 до 10^10-1.
-    Значение - количество рыбы на клетке (0-15).
-
-    Инициализируем примерным количеством активных клеток == числу кораблей.
-    */
-    std::unordered_map<uint64_t, uint8_t> activeCells;
-    activeCells.reserve(SHIP_COUNT);
-
-    /*
-    Вектор для кольцевого буфера таймеров клеток.
-    Значение - вектор индексов клеток, которые будут переведены в неопределенное состояние,
-    когда указатель кольцевого буфера дойдет до их индекса.
+    if (!options.connectAddress.empty()) {
+        // Окно только рисует присланное сервером, симуляции в этом процессе нет.
+        using Clock = std::chrono::steady_clock;
+        auto rateStart = Clock::now();
+        uint64_t rateBytes = 0;
+        double bytesPerSecond = 0;
+        std::string error;
+        while (window.isOpen()) {
+            while (const std::optional event = window.pollEvent()) {
+                renderer.handleEvent(event);
+            }
+            uint64_t x, y, w, h;
+            renderer.getVisibleCells(x, y, w, h);
+            remote.requestViewport(x, y, w, h);
+            if (!remote.receive(error)) {
+                std::cout << "Ошибка: " << error << std::endl;
+                break;
+            }
 
-    Инициализируем максимальным значением таймера клетки - 30.
-    */
-    std::vector<std::vector<uint64_t>> cellsTimers(30);
+            auto now = Clock::now();
+            double elapsed = std::chrono::duration<double>(now - rateStart).count();
+            if (elapsed >= 1.0) {
+                bytesPerSecond = (remote.bytesReceived() - rateBytes) / elapsed;
+                rateBytes = remote.bytesReceived();
+                rateStart = now;
+            }
 
-    /*
-    Посчитаем среднее истечение клеток за ход, чтобы избежать реаллока векторов, если клеток истечет больше.
-    Средний таймер - (15 + 30) / 2 = 22.5 секунды.
-    Активных клеток в среднем == число кораблей - 100'000.
-    Среднее истечение клеток за ход - 100'000 / 22.5.
-    Округлим до тысяч и инициализируем векторы кольцевого буффера.
-    */
-    int64_t cellsPerTimer = ceil(SHIP_COUNT / 22.5 / 1000) * 1000;
-    for (auto& cells : cellsTimers) {
-        cells.reserve(cellsPerTimer);
+            std::vector<std::string> lines;
+            lines.push_back("Server: " + options.connectAddress);
+            lines.push_back("Tick: " + std::to_string(remote.tick()));
+            lines.push_back("Ships in view: " + std::to_string(remote.ships().size()));
+            lines.push_back("Cells in view: " + std::to_string(remote.cells().size()));
+            lines.push_back("Received KB/s: " + std::to_string(static_cast<uint64_t>(bytesPerSecond / 1024)));
+            info.setLines(lines);
+            renderer.drawScene(remote.cells(), REMOTE_VIEW_TICK, remote.ships());
+            info.draw();
+            window.display();
+        }
+        if (window.isOpen())
+            window.close();
+        return 0;
     }
 
-    /*
-    Вектор лодок.
-    */
-    std::vector<uint64_t> ships(SHIP_COUNT);
-    // Инициализируем лодки.
-    for (int i = 0; i < SHIP_COUNT; i++) {
-        // Генерируем лодку сразу в режиме рыбалки.
-        uint64_t ship = 0;
-        ship |= shipTypeRng(rng); // Тип лодки.
-        ship |= ShipState::FISHING << STATE_SHIFT; // Состояние лодки.
-        ship |= shipTimerRng(rng) << TIMER_SHIFT; // Таймер ожидания конца улова.
-        ship |= shipPositionRng(rng) << POSITION_SHIFT; // Позиция лодки.
-
-        ships[i] = ship;
+    // Инициализация симуляции: карта клеток, таймеры и лодки.
+    Simulation sim(options.simulation);
+
+    // Аппаратные счетчики считают этот поток - в нем же выполняются тики.
+    PerfCounters counters;
+    if (options.perf) {
+        std::string error;
+        if (counters.open(error)) {
+            sim.setPerfCounters(&counters);
+        } else {
+            std::cout << "Счетчики недоступны: " << error << std::endl;
+        }
     }
 
     // Данные для симуляции.
-    int activeShips = SHIP_COUNT;
-    uint64_t tick = 1;
     using Clock = std::chrono::steady_clock;
     auto lastTick = Clock::now();
     std::chrono::milliseconds tickDuration(TICK_DURATION_MS);
-    // Отладочная информация
-    uint64_t greedyCount = 0;
-    uint64_t lazyCount = 0;
-    uint64_t restlessCount = 0;
-    uint64_t minFishCount = std::numeric_limits<int>::max();
-    uint64_t maxFishCount = 0;
-    double_t meanFishCount = 0;
+    // Задержки тиков и кадров за все время работы окна.
+    TickProfiler profiler(options.tickDeadlineMs * 1'000'000, options.slowTicks);
+    auto lastFrame = Clock::now();
 
     // Основной цикл, симулирующий один тик.
-    while (activeShips > 0 && window.isOpen()) {
+    while (!sim.finished() && window.isOpen()) {
         // Обрабатываем события SFML.
         while (const std::optional event = window.pollEvent()) {
             renderer.handleEvent(event);
+
+            if (const auto* key = event->getIf<sf::Event::KeyPressed>()) {
+                if (key->code == sf::Keyboard::Key::I) {
+                    // Добавляем лодки в видимую часть карты, они появятся на одном из следующих тиков.
+                    InjectionRequest request;
+                    renderer.getVisibleCells(request.x, request.y, request.width, request.height);
+                    request.count = INJECT_SHIP_COUNT;
+                    request.typeWeights = options.simulation.typeWeights;
+                    sim.requestInjection(request);
+                }
+            }
         }
 
         // Отрисовываем сцену.
+        const SimulationStats& stats = sim.stats();
         std::vector<std::string> lines;
-        lines.push_back("Tick: " + std::to_string(tick));
-        lines.push_back("Greedy: " + std::to_string(greedyCount));
-        lines.push_back("Lazy: " + std::to_string(lazyCount));
-        lines.push_back("Restless: " + std::to_string(restlessCount));
-        lines.push_back("Min fish catched: " + std::to_string(minFishCount));
-        lines.push_back("Max fish catched: " + std::to_string(maxFishCount));
-        lines.push_back("Mean fish catched: " + std::to_string(meanFishCount));
+        lines.push_back("Tick: " + std::to_string(sim.tick()));
+        lines.push_back("Ships: " + std::to_string(sim.activeShips()) + (sim.pendingInjections() ? " (+pending)" : ""));
+        lines.push_back("Greedy: " + std::to_string(stats.greedyCount));
+        lines.push_back("Lazy: " + std::to_string(stats.lazyCount));
+        lines.push_back("Restless: " + std::to_string(stats.restlessCount));
+        lines.push_back("Seeker: " + std::to_string(stats.seekerCount));
+        if (options.simulation.scriptShips > 0) {
+            lines.push_back("Scripted: " + std::to_string(sim.scriptShips()));
+        }
+        lines.push_back("Min fish catched: " + std::to_string(stats.minFishCount));
+        lines.push_back("Max fish catched: " + std::to_string(stats.maxFishCount));
+        lines.push_back("Mean fish catched: " + std::to_string(stats.meanFishCount));
+        lines.push_back("Tick ms p50/p99/p99.9/max: " + formatQuantiles(profiler.ticks()));
+        lines.push_back("Frame ms p50/p99/p99.9/max: " + formatQuantiles(profiler.frames()));
+        lines.push_back("Tick overruns: " + std::to_string(profiler.overruns()));
+        if (counters.available()) {
+            for (int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+                lines.push_back(formatPhaseCounters(profiler, phase));
+            }
+        }
         info.setLines(lines);
-        renderer.drawScene(activeCells, ships);
+        renderer.drawScene(sim.cells(), sim.cellsTick(), sim.ships());
         info.draw();
         window.display();
 
+        auto frameEnd = Clock::now();
+        profiler.recordFrame(std::chrono::duration_cast<std::chrono::nanoseconds>(frameEnd - lastFrame).count());
+        lastFrame = frameEnd;
+
         // Не выполняем шаги симуляции, если с последнего тика прошло меньше tickDuration времени.
         auto now = Clock::now();
         if (now - lastTick < tickDuration) {
             continue;
         }
 
-        // Обрабатываем клетки.
-        // Индекс текущей группы таймеров, которые заканчиваются.
-        int expiringGroupIdx = tick % 30;
-        auto& expiring = cellsTimers[expiringGroupIdx];
-        for (uint64_t cellIdx : expiring) {
-            // Удаляем клетку, переводя ее в неопределенное состояние.
-            activeCells.erase(cellIdx);
+        uint64_t ships = sim.activeShips();
+        auto tickStart = Clock::now();
+        sim.step();
+        profiler.recordTick(sim.tick() - 1, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - tickStart).count(), sim.phaseNs());
+        if (counters.available()) {
+            profiler.recordCounters(sim.phaseCounters(), ships);
         }
-        // Очищаем индексы удаленных клеток.
-        expiring.clear();
-
-        // Обрабатываем суда.
-        lazyCount = 0;
-        greedyCount = 0;
-        restlessCount = 0;
-        minFishCount = std::numeric_limits<int>::max();
-        maxFishCount = 0;
-        meanFishCount = 0;
-        for (int i = 0; i < SHIP_COUNT; i++) {
-            uint64_t ship = ships[i];
-
-            uint8_t shipType = ship & MASK_2BIT; // Тип лодки
-            uint8_t shipState = (ship >> STATE_SHIFT) & MASK_2BIT; // Состояние лодки.
-            uint64_t fishCount = (ship >> FISH_SHIFT) & MASK_14BIT; // Количество рыбы, которое выловила лодка.
-
-            // Обновим статистику, но только для не-мертвых лодок.
-            if (shipState != ShipState::DEAD) {
-                switch (shipType) {
-                case ShipType::GREEDY: {
-                    greedyCount++;
-                    break;
-                }
-                case ShipType::LAZY: {
-                    lazyCount++;
-                    break;
-                }
-                case ShipType::RESTLESS: {
-                    restlessCount++;
-                    break;
-                }
-                }
-
-                minFishCount = std::min(minFishCount, fishCount);
-                maxFishCount = std::max(maxFishCount, fishCount);
-                meanFishCount += static_cast<double>(fishCount) / static_cast<double>(activeShips);
-            }
-
-            // Обновляем лодку
-            switch (shipState) {
-            case ShipState::DEAD:
-                continue;
-            case ShipState::FLOATING: {
-                // Обрабатываем передвижение судна.
-
-                uint64_t shipPosition = (ship >> POSITION_SHIFT) & MASK_34BIT;
-
-                // Получаем сдвиги до целевой позиции.
-                int64_t offsetX = (ship >> OFFSET_X_SHIFT) & MASK_4BIT;
-                offsetX -= 8; // Чтобы получить значения от -8 до 7
-                int64_t offsetY = (ship >> OFFSET_Y_SHIFT) & MASK_4BIT;
-                offsetY -= 8; // Чтобы получить значения от -8 до 7;
-
-                if (offsetX == 0 && offsetY == 0) {
-                    // Если оба сдвига равны нулю, мы доплыли и можем начинать рыбачить.
-
-                    // Обновляем состояние на ожидание окончания рыбалки.
-                    ship = setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::FISHING);
-
-                    // Устанавливаем таймер ожидания конца рыбалки.
-                    ship = setbits(ship, TIMER_SHIFT, MASK_2BIT, shipTimerRng(rng));
-
-                    break;
-                }
-
-                if (offsetX > 0) {
-                    // Если смещение по X > 0, значит плывем в положительную сторону по x.
-                    offsetX--;
-                    shipPosition++;
-
-                    // Проверяем на пересечение границы сверху.
-                    if (shipPosition > POSITION_BOUND) {
-                        shipPosition = 0;
-                    }
-
-                    // Устанавливаем новые значение смещения и положения.
-                    ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, offsetX + 8);
-                    ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
-
-                    break;
-                }
-
-                if (offsetX < 0) {
-                    // Если смещение по X < 0, значит плывем в отрицательную сторону по x.
-                    offsetX++;
-                    shipPosition--;
-
-                    /*
-                    Проверка на underflow.
-                    Логически это можно представить как движение в верхней левой клетке налево.
-                    Это приведет к перемещению в POSITION_BOUND координату - нижнюю правую.
-                    */
-                    if (shipPosition > POSITION_BOUND) {
-                        shipPosition = POSITION_BOUND;
-                    }
-
-                    // Устанавливаем новые значение смещения и положения.
-                    ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, offsetX + 8);
-                    ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
-
-                    break;
-                }
-
-                if (offsetY > 0) {
-                    /*
-                    Если смещение по Y > 0, значит мы должны двигаться вверх.
-                    Для этого нужно уменьшить текущее положение на одну ширину карты.
-                    */
-                    offsetY--;
-
-                    if (shipPosition < WIDTH) {
-                        // Если позиция меньше ширины поля, значит мы на первой строке,
-                        // и движение наверх должно перенести нас на
-                        // самую нижнюю линию.
-                        shipPosition = POSITION_BOUND - (WIDTH - shipPosition - 1);
-                    } else {
-                        shipPosition -= WIDTH;
-                    }
-
-                    ship = setbits(ship, OFFSET_Y_SHIFT, MASK_4BIT, offsetY + 8);
-                    ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
-
-                    break;
-                }
-
-                if (offsetY < 0) {
-                    /*
-                    Если смещение по Y < 0, значит мы должны двигаться вниз.
-                    Для этого нужно увеличить текущее положение на одну ширину карты.
-                    */
-                    offsetY++;
-
-                    if (shipPosition + WIDTH > POSITION_BOUND) {
-                        /*
-                        Если новая позиция выходит за границы, значит мы на нижней строке.
-                        Движение еще ниже должно привести нас на первую строку.
-                        */
-                        shipPosition = WIDTH - (POSITION_BOUND - shipPosition) - 1;
-                    } else {
-                        shipPosition += WIDTH;
-                    }
-
-                    ship = setbits(ship, OFFSET_Y_SHIFT, MASK_4BIT, offsetY + 8);
-                    ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
-
-                    break;
-                }
-
-                break;
-            }
-            case ShipState::FISHING: {
-                // Обрабатываем состояние рыбалки.
-
-                uint64_t shipPosition = (ship >> POSITION_SHIFT) & MASK_34BIT;
-
-                // Получаем текущее значение таймера ожидания улова.
-                uint8_t fishTimer = (ship >> TIMER_SHIFT) & MASK_2BIT;
-                fishTimer--;
-                ship = setbits(ship, TIMER_SHIFT, MASK_2BIT, fishTimer);
-
-                if (fishTimer > 0) {
-                    break;
-                }
-
-                // Если таймер дошел до нуля, реализуем логику вылавливания рыбы.
-
-                // Генерируем количество рыбы, которое выловила лодка.
-                uint8_t fishCatched = catchRng(rng);
-
-                /*
-                Логика проверки, активна ли текущая клетка.
-                Для этого ищем итератор.
-                */
-                auto it = activeCells.find(shipPosition);
-                uint8_t cellFishCounter = 0;
-                if (it == activeCells.end()) {
-                    /*
-                    Если итератор равен end(), текущая клетка была в неопределенном состоянии.
-                    Активируем ее.
-                    */
-
-                    // Генерируем количество рыбы на клетке
-                    cellFishCounter = fishRng(rng);
-                    // Корректно изменяем количество рыбы на клетке.
-                    if (fishCatched > cellFishCounter) {
-                        fishCatched = cellFishCounter;
-                        cellFishCounter = 0;
-                    } else {
-                        cellFishCounter -= fishCatched;
-                    }
-
-                    // Сохраняем новое значение рыбы в карте.
-                    activeCells[shipPosition] = cellFishCounter;
-
-                    // Генерируем таймер обновления клетки.
-                    int cellTimeout = cellTimerRnd(rng);
-                    int timerIdx = (tick + cellTimeout) % 30;
-                    // Помещаем индекс текущей клетки в кольцевой буфер.
-                    cellsTimers[timerIdx].push_back(shipPosition);
-                } else {
-                    // Если клетка уже есть в карте.
-
-                    cellFishCounter = it->second;
-                    // Корректно изменяем количество рыбы на клетке.
-                    if (fishCatched > cellFishCounter) {
-                        fishCatched = cellFishCounter;
-                        cellFishCounter = 0;
-                    } else {
-                        cellFishCounter -= fishCatched;
-                    }
-
-                    // Сохраняем новое значение рыбы в карте.
-                    it->second = cellFishCounter;
-                }
-
-                // Обновляем общее количество рыбы, которое выловила лодка.
-                uint64_t shipFishCounter = (ship >> FISH_SHIFT) & MASK_14BIT;
-                shipFishCounter = std::min(static_cast<long long int>(shipFishCounter + fishCatched), WIN_FISH_COUNT);
-                ship = setbits(ship, FISH_SHIFT, MASK_14BIT, shipFishCounter);
-
-                // Проверяем условие победы для лодки
-                if (shipFishCounter == WIN_FISH_COUNT) {
-                    // Лодка победила, ставим ей состояние уплывания с карты.
-                    ship = setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::FINISHING);
-                    break;
-                }
-
-                /*
-                Лодка еще не победила, но рыбалку закончила.
-                Определяем дальнейшее поведение лодки согласно ее типу.
-                */
-                switch (shipType) {
-                case ShipType::GREEDY: {
-                    // Жадная лодка рыбачит, пока не выловит все на текущей клетке.
-
-                    if (cellFishCounter == 0) {
-                        // На текущей клетке закончилась рыба.
-
-                        // Генерируем случайные смещения для лодки.
-                        ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, shipOffsetRng(rng));
-                        ship = setbits(ship, OFFSET_Y_SHIFT, MASK_4BIT, shipOffsetRng(rng));
-                        // Ставим лодке состояние плавания.
-                        ship = setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::FLOATING);
-
-                        break;
-                    }
-
-                    // На текущей клетке еще не закончилась рыба.
-
-                    // Просто переустанавливаем таймер ожидания улова.
-                    ship = setbits(ship, TIMER_SHIFT, MASK_2BIT, shipTimerRng(rng));
-
-                    break;
-                }
-                case ShipType::LAZY: {
-                    /*
-                    Ленивая лодка никогда никуда не двигается.
-                    Просто переустанавливаем таймер ожидания улова.
-                    */
-                    ship = setbits(ship, TIMER_SHIFT, MASK_2BIT, shipTimerRng(rng));
-
-                    break;
-                }
-                case ShipType::RESTLESS: {
-                    // Непоседа просто двигается на 1 клетку вправо.
-
-                    // Устанавливаем сдвиг на 1 по x и состояние плавания.
-                    ship = setbits(ship, OFFSET_X_SHIFT, MASK_4BIT, 1 + 8);
-                    ship = setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::FLOATING);
-
-                    break;
-                }
-                }
-
-                break;
-            }
-            case ShipState::FINISHING: {
-                /*
-                Обрабатываем лодку, которая победила и уплывает с карты.
-                Для этого просто двигаем ее на +1 по x, проверяя оставшееся расстояние до края карты.
-                */
-
-                uint64_t shipPosition = (ship >> POSITION_SHIFT) & MASK_34BIT;
-
-                // Сколько клеток осталось до края карты.
-                uint64_t distanceLeft = WIDTH - (shipPosition % WIDTH + 1);
-
-                if (distanceLeft == 0) {
-                    // Мы уже стоим у края карты, значит лодка исчезает.
-                    ship = setbits(ship, STATE_SHIFT, MASK_2BIT, ShipState::DEAD);
-                    activeShips--;
-                } else {
-                    // Еще осталось место для движения до края.
-                    shipPosition++;
-
-                    ship = setbits(ship, POSITION_SHIFT, MASK_34BIT, shipPosition);
-                }
-
-                break;
-            }
-            }
-
-            ships[i] = ship;
+        if (metrics.running()) {
+            metrics.publish(sim, profiler);
         }
-
-        tick++;
         lastTick += tickDuration;
     }
 
     if (window.isOpen())
         window.close();
 
+    if (options.slowTicks > 0) {
+        profiler.printSlowestTicks(std::cout);
+    }
+
     return 0;
-}
\ No newline at end of file
+}
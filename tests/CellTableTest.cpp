@@ -0,0 +1,141 @@
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "CellTable.hpp"
+#include "Check.hpp"
+
+// Эталон: клетка -> рыба и тик истечения.
+using CellModel = std::unordered_map<uint64_t, std::pair<uint8_t, uint32_t>>;
+
+// Сверяет таблицу с эталоном целиком: размер, обход и поиск каждой клетки.
+static void checkContents(const CellTable& table, const CellModel& model, uint32_t tick)
+{
+    check(table.size() == model.size(), "size matches the model");
+    uint64_t visited = 0;
+    bool same = true;
+    table.forEachWithExpiry([&](uint64_t cell, uint8_t fish, uint32_t expireTick) {
+        auto it = model.find(cell);
+        same = same && it != model.end() && it->second.first == fish && it->second.second == expireTick;
+        visited++;
+    });
+    check(same && visited == model.size(), "forEach visits exactly the model cells");
+
+    const CellTableHealth before = table.health();
+    for (const auto& [cell, entry] : model) {
+        const bool alive = !CellTable::expired(entry.second, tick);
+        const uint8_t* fish = table.find(cell, tick);
+        if (!check(alive ? fish != nullptr && *fish == entry.first : fish == nullptr, "const find matches the model")
+            || !check(table.peek(cell, tick) == (alive ? entry.first : 0), "peek matches the model")) {
+            return;
+        }
+    }
+    const CellTableHealth after = table.health();
+    check(after.hits == before.hits && after.misses == before.misses, "const find and peek do not count lookups");
+}
+
+int main()
+{
+    std::mt19937_64 rng(7);
+    CellTable table;
+    CellModel model;
+    // Ключи из узкого диапазона с плотными сериями, чтобы цепочки пробирования пересекались.
+    const uint64_t keyRange = 1 << 16;
+    std::vector<uint32_t> slots(keyRange, CellTable::NO_SLOT);
+    auto randomCell = [&]() {
+        return rng() % 4 == 0 ? (rng() % 64) * 1024 + rng() % 8 : rng() % keyRange;
+    };
+
+    uint32_t tick = 0;
+    bool sawMigration = false;
+    uint64_t peakSlots = 0;
+    for (int phase = 0; phase < 3; phase++) {
+        // Рост, потом почти полное опустошение и сжатие, потом снова рост.
+        const unsigned activateShare = phase == 1 ? 10 : 70;
+        for (int op = 0; op < 200'000; op++) {
+            const uint64_t cell = randomCell();
+            const unsigned kind = rng() % 100;
+            if (kind < activateShare) {
+                const uint8_t fish = static_cast<uint8_t>(rng() % 10);
+                const uint32_t expireTick = tick + 1 + static_cast<uint32_t>(rng() % 30);
+                auto it = model.find(cell);
+                uint8_t previous = 0;
+                uint8_t* stored = table.activate(cell, fish, expireTick, slots[cell], &previous);
+                check(stored != nullptr && *stored == fish, "activate returns the stored fish");
+                check(it == model.end() || previous == it->second.first, "activate reports the previous fish");
+                model[cell] = { fish, expireTick };
+            } else if (kind < activateShare + 10) {
+                auto it = model.find(cell);
+                const bool alive = it != model.end() && !CellTable::expired(it->second.second, tick);
+                uint8_t* fish = table.find(cell, tick, slots[cell]);
+                if (check(alive ? fish != nullptr && *fish == it->second.first : fish == nullptr, "find matches the model")
+                    && fish != nullptr && *fish > 0) {
+                    // Улов пишется через найденный указатель.
+                    (*fish)--;
+                    it->second.first--;
+                }
+            } else if (kind < activateShare + 20) {
+                auto it = model.find(cell);
+                const bool expected = it != model.end() && CellTable::expired(it->second.second, tick);
+                uint8_t fish = 0;
+                uint32_t expireTick = 0;
+                const bool erased = table.eraseExpired(cell, tick, &fish, &expireTick);
+                check(erased == expected, "eraseExpired removes only expired cells");
+                if (expected) {
+                    check(fish == it->second.first && expireTick == it->second.second, "eraseExpired reports the removed cell");
+                    model.erase(it);
+                }
+            } else {
+                check(table.erase(cell) == (model.erase(cell) == 1), "erase matches the model");
+            }
+
+            sawMigration = sawMigration || table.migrating();
+            peakSlots = std::max(peakSlots, table.slotCount());
+            if (op % 1000 == 0) {
+                tick++;
+            }
+            if (op % 25'000 == 0) {
+                checkContents(table, model, tick);
+            }
+        }
+        checkContents(table, model, tick);
+
+        if (phase == 1) {
+            // После опустошения таблица переезжает в меньший массив постепенно, по мере операций.
+            const uint64_t slotsBefore = table.slotCount();
+            table.rehash(2 * table.size());
+            check(table.migrating(), "shrinking rehash starts a migration");
+            for (int op = 0; op < 100'000 && table.migrating(); op++) {
+                const uint64_t cell = randomCell();
+                if (table.erase(cell)) {
+                    model.erase(cell);
+                }
+            }
+            check(!table.migrating(), "migration finishes after enough operations");
+            check(table.slotCount() < slotsBefore, "shrinking rehash leaves fewer slots");
+            checkContents(table, model, tick);
+        }
+    }
+
+    check(sawMigration, "table migrated while growing");
+    check(table.health().rehashes >= 2, "growth and shrink are both counted as rehashes");
+    check(peakSlots >= 2 * keyRange / 4, "table grew past its initial size");
+
+    // Запомненный слот устаревает после переезда и удаления, но поиск все равно находит клетку.
+    CellTable small;
+    uint32_t slot = CellTable::NO_SLOT;
+    small.activate(5, 9, 100, slot);
+    for (uint64_t cell = 100; cell < 2000; cell++) {
+        small.activate(cell, 1, 100);
+    }
+    small.erase(5);
+    small.activate(5, 3, 100);
+    const uint8_t* fish = small.find(5, 0, slot);
+    check(fish != nullptr && *fish == 3, "stale remembered slot falls back to probing");
+    uint32_t foreign = 12345;
+    check(small.find(1'000'000, 0, foreign) == nullptr, "foreign remembered slot is harmless");
+
+    return failures() == 0 ? 0 : 1;
+}
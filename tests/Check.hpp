@@ -0,0 +1,21 @@
+#pragma once
+#include <iostream>
+
+/*
+Минимальные проверки для тестов: check печатает проваленное условие и запоминает провал,
+failures() в конце main дает код возврата для ctest. Проверки работают и с NDEBUG.
+*/
+inline int& failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline bool check(bool condition, const char* what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures()++;
+    }
+    return condition;
+}
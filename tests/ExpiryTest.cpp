@@ -0,0 +1,48 @@
+#include <cstdint>
+#include <unordered_map>
+
+#include "Check.hpp"
+#include "Simulation.hpp"
+
+int main()
+{
+    // Малый бюджет удалений: после стартового всплеска большая часть истечений уходит в очередь.
+    SimulationConfig config;
+    config.width = 200;
+    config.height = 150;
+    config.shipCount = 30'000;
+    config.winFishCount = 300;
+    config.typeWeights = { 1, 1, 1, 1 };
+    config.expiryBudget = 64;
+    config.seed = 5;
+
+    Simulation simulation(config);
+    simulation.setJournalEnabled(true);
+
+    // Наблюдатель видит только журнал и должен получать ровно живые клетки таблицы.
+    std::unordered_map<uint64_t, uint8_t> mirror;
+    uint64_t peakBacklog = 0;
+    bool same = true;
+    for (int tick = 0; tick < 400 && same && !simulation.finished(); tick++) {
+        simulation.step();
+        for (const CellChange& change : simulation.journal().cells) {
+            if (change.removed) {
+                mirror.erase(change.cell);
+            } else {
+                mirror[change.cell] = change.fish;
+            }
+        }
+        peakBacklog = std::max(peakBacklog, simulation.expiryBacklog());
+
+        uint64_t live = 0;
+        bool match = true;
+        simulation.cells().forEachLive(simulation.cellsTick(), [&](uint64_t cell, uint8_t fish) {
+            auto it = mirror.find(cell);
+            match = match && it != mirror.end() && it->second == fish;
+            live++;
+        });
+        same = check(match && live == mirror.size(), "journal mirror holds exactly the live cells");
+    }
+    check(peakBacklog > 1000, "expiry backlog builds up after the start-up burst");
+    return failures() == 0 ? 0 : 1;
+}
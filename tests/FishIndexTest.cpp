@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <random>
+
+#include "Check.hpp"
+#include "FishIndex.hpp"
+#include "Simulation.hpp"
+
+// Сводка, построенная заново из живых клеток таблицы.
+static FishIndex rebuild(const Simulation& simulation)
+{
+    FishIndex index;
+    index.enable(simulation.config().width, simulation.config().height);
+    simulation.cells().forEachLive(simulation.cellsTick(), [&](uint64_t cell, uint8_t fish) { index.update(cell, 0, fish); });
+    return index;
+}
+
+static bool sameTiles(const FishIndex& a, const FishIndex& b)
+{
+    if (a.tileCount() != b.tileCount()) {
+        return false;
+    }
+    for (uint64_t tile = 0; tile < a.tileCount(); tile++) {
+        if (a.levelMask(tile) != b.levelMask(tile) || a.levelCounts(tile) != b.levelCounts(tile)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+Перебором 16x16: наибольшая рыба в прямоугольнике, из равных - первая по плиткам
+(строки плиток, затем столбцы), а внутри плитки - по строкам, как обещает richest.
+*/
+template <typename FishAt>
+static bool bruteRichest(uint64_t width, uint64_t x0, uint64_t y0, uint64_t x1, uint64_t y1, FishAt&& fishAt, uint64_t& cell)
+{
+    const uint64_t tile = FishIndex::TILE;
+    uint8_t best = 0;
+    for (uint64_t ty = y0 / tile; ty <= y1 / tile; ty++) {
+        for (uint64_t tx = x0 / tile; tx <= x1 / tile; tx++) {
+            for (uint64_t y = std::max(ty * tile, y0); y <= std::min(ty * tile + tile - 1, y1); y++) {
+                for (uint64_t x = std::max(tx * tile, x0); x <= std::min(tx * tile + tile - 1, x1); x++) {
+                    uint8_t fish = fishAt(y * width + x);
+                    if (fish > best) {
+                        best = fish;
+                        cell = y * width + x;
+                    }
+                }
+            }
+        }
+    }
+    return best > 0;
+}
+
+int main()
+{
+    // Искатели в большинстве, а малый бюджет удалений держит истекшие клетки в очереди.
+    SimulationConfig config;
+    config.width = 160;
+    config.height = 120;
+    config.shipCount = 15'000;
+    config.winFishCount = 400;
+    config.typeWeights = { 1, 1, 1, 5 };
+    config.arrivals.respawn = true;
+    config.expiryBudget = 256;
+    config.seed = 9;
+
+    Simulation simulation(config);
+    std::mt19937_64 rng(3);
+    uint64_t queries = 0;
+    uint64_t found = 0;
+    uint64_t peakBacklog = 0;
+    bool same = true;
+    for (int tick = 0; tick < 3000 && same; tick++) {
+        simulation.step();
+        peakBacklog = std::max(peakBacklog, simulation.expiryBacklog());
+        if (!simulation.fishIndex().enabled()) {
+            continue;
+        }
+        // Уловы, истечения и повторные активации поддерживают сводку такой же, как при постройке заново.
+        same = check(sameTiles(simulation.fishIndex(), rebuild(simulation)), "incremental summary matches a rebuild");
+
+        const uint32_t cellsTick = simulation.cellsTick();
+        auto fishAt = [&](uint64_t cell) -> uint8_t { return simulation.cells().peek(cell, cellsTick); };
+        FishIndex index = simulation.fishIndex();
+        for (int query = 0; query < 20 && same; query++) {
+            const uint64_t x = rng() % config.width;
+            const uint64_t y = rng() % config.height;
+            const uint64_t x0 = x - std::min<uint64_t>(x, 8), y0 = y - std::min<uint64_t>(y, 8);
+            const uint64_t x1 = std::min(x + 7, config.width - 1), y1 = std::min(y + 7, config.height - 1);
+            uint64_t cell = 0, expected = 0;
+            const bool hit = index.richest(x0, y0, x1, y1, fishAt, cell);
+            const bool expectedHit = bruteRichest(config.width, x0, y0, x1, y1, fishAt, expected);
+            same = check(hit == expectedHit && (!hit || cell == expected), "richest matches a brute-force window scan");
+            queries++;
+            found += hit;
+        }
+    }
+    check(simulation.fishIndex().enabled(), "seekers built the summary");
+    check(peakBacklog > 0, "some expiries were deferred");
+    check(found > queries / 2, "most windows contain fish");
+    return failures() == 0 ? 0 : 1;
+}
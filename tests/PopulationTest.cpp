@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "Check.hpp"
+#include "Population.hpp"
+#include "Scenario.hpp"
+
+// Перезаписывает файл path содержимым data.
+static void writeBytes(const std::string& path, const std::string& data)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+}
+
+// Читает файл path целиком.
+static std::string readBytes(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Подменяет лодку index в содержимом бинарного файла.
+static std::string withShip(std::string data, uint64_t index, uint64_t ship)
+{
+    std::memcpy(data.data() + sizeof(PopulationHeader) + index * sizeof(uint64_t), &ship, sizeof(ship));
+    return data;
+}
+
+int main()
+{
+    const std::string path = (std::filesystem::temp_directory_path() / "grandfishing_population_test.bin").string();
+    const uint64_t width = 300;
+    const uint64_t height = 200;
+    CsvParseOptions csv;
+    csv.maxFish = 300;
+
+    // Бинарный файл возвращает те же лодки, что были записаны.
+    ScenarioConfig scenario;
+    ShipGenerator generator(scenario, width, height, { 1, 1, 1, 1 }, 42);
+    ShipArray ships(100'000);
+    generator.fillParallel(ships.data(), ships.size());
+    ships[5] = DEAD_SHIP;
+    std::string error;
+    check(writePopulationFile(path, width, height, ships, error), "population file is written");
+    {
+        PopulationFile population;
+        check(population.openFromFile(path, csv, error), "written population opens");
+        check(population.width() == width && population.height() == height, "map size comes from the header");
+        check(population.count() == ships.size(), "ship count comes from the header");
+        ShipArray loaded(population.count());
+        population.copyTo(loaded.data(), 4);
+        check(std::equal(ships.begin(), ships.end(), loaded.begin()), "binary round trip keeps every ship word");
+    }
+
+    // Каждое некорректное слово отклоняется с номером лодки.
+    const std::string original = readBytes(path);
+    const uint64_t ship = ships[777];
+    const uint64_t badShips[] = {
+        setbits(ship, POSITION_SHIFT, MASK_34BIT, width * height),
+        setbits(ship, TIMER_SHIFT, MASK_2BIT, 0),
+        setbits(ship, FISH_SHIFT, MASK_14BIT, csv.maxFish + 1),
+        ship | 1ULL << 63,
+    };
+    for (uint64_t bad : badShips) {
+        writeBytes(path, withShip(original, 777, bad));
+        PopulationFile population;
+        error.clear();
+        check(!population.openFromFile(path, csv, error), "corrupt ship word is rejected");
+        check(error.find("777") != std::string::npos, "error names the corrupt ship");
+    }
+    // Мертвая лодка - пустой слот, остальные ее поля не проверяются.
+    writeBytes(path, withShip(original, 777, DEAD_SHIP | MASK_34BIT << POSITION_SHIFT));
+    {
+        PopulationFile population;
+        check(population.openFromFile(path, csv, error), "dead ship word is accepted as is");
+    }
+    // Обрезанный файл не совпадает с заголовком.
+    writeBytes(path, original.substr(0, original.size() - 4));
+    {
+        PopulationFile population;
+        check(!population.openFromFile(path, csv, error), "truncated population is rejected");
+    }
+
+    // CSV упаковывается в те же поля, а строка вне карты отклоняется с номером.
+    csv.width = width;
+    csv.height = height;
+    writeBytes(path, "x,y,type,fish,state\n12,40,greedy,0,fishing\n13,41,2,150,floating\n");
+    {
+        PopulationFile population;
+        check(population.openFromFile(path, csv, error), "csv population opens");
+        ShipArray loaded(population.count());
+        population.copyTo(loaded.data(), 1);
+        check(loaded.size() == 2, "csv row count");
+        check(loaded.size() == 2 && ((loaded[0] >> POSITION_SHIFT) & MASK_34BIT) == 40 * width + 12, "csv position");
+        check(loaded.size() == 2 && (loaded[1] & MASK_2BIT) == ShipType::RESTLESS, "csv type");
+        check(loaded.size() == 2 && ((loaded[1] >> FISH_SHIFT) & MASK_14BIT) == 150, "csv fish");
+    }
+    writeBytes(path, "12,40,greedy,0,fishing\n300,0,lazy,0,fishing\n");
+    {
+        PopulationFile population;
+        error.clear();
+        check(!population.openFromFile(path, csv, error), "csv row outside the map is rejected");
+        check(error.find("строка 2") != std::string::npos, "csv error names the row");
+    }
+
+    std::filesystem::remove(path);
+    return failures() == 0 ? 0 : 1;
+}
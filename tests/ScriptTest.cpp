@@ -0,0 +1,93 @@
+#include <cstdint>
+#include <vector>
+
+#include "Check.hpp"
+#include "Simulation.hpp"
+
+// Тики, на которых продолжался сценарий трассы, и куда он плыл.
+static const Simulation* tracedSimulation = nullptr;
+static std::vector<uint64_t> trace;
+static uint64_t startX = 0, startY = 0;
+
+// Ждет 3 тика, плывет на 2 клетки по x и 1 по y, рыбачит и заканчивается.
+static ShipScript traceScript(ScriptShip& ship)
+{
+    trace.push_back(tracedSimulation->tick());
+    co_await ticks(3);
+    trace.push_back(tracedSimulation->tick());
+    startX = ship.x;
+    startY = ship.y;
+    co_await moveTo(ship.x < 50 ? ship.x + 2 : ship.x - 2, ship.y < 50 ? ship.y + 1 : ship.y - 1);
+    trace.push_back(tracedSimulation->tick());
+    co_await fish();
+    trace.push_back(tracedSimulation->tick());
+}
+
+// Лодки сценариев, чей сценарий еще идет (ушедшие и уплывающие кадра не держат).
+static uint64_t runningScripts(const Simulation& simulation)
+{
+    uint64_t running = 0;
+    for (const ScriptShip& ship : simulation.scriptFleet()) {
+        running += ship.alive && ship.action != ScriptAction::LEAVE;
+    }
+    return running;
+}
+
+int main()
+{
+    // Трасса одной лодки: ticks(n) продолжается через n тиков, moveTo - по тику на клетку
+    // и тик на прибытие, рыбалка - таймер 1-3 тика, как у обычных лодок.
+    {
+        SimulationConfig config;
+        config.width = 100;
+        config.height = 100;
+        config.shipCount = 0;
+        config.scriptShips = 1;
+        config.customScript = traceScript;
+        config.seed = 4;
+        Simulation simulation(config);
+        tracedSimulation = &simulation;
+        for (int tick = 0; tick < 200 && !simulation.finished(); tick++) {
+            simulation.step();
+        }
+        if (check(trace.size() == 4, "trace script ran to the end")) {
+            check(trace[0] == 1, "script starts on the first tick");
+            check(trace[1] == trace[0] + 3, "ticks(3) resumes three ticks later");
+            check(trace[2] == trace[1] + 2 + 1 + 1, "moveTo takes a tick per cell plus arrival");
+            check(trace[3] >= trace[2] + 1 && trace[3] <= trace[2] + 3, "fish resumes after a 1-3 tick timer");
+        }
+        const ScriptShip& ship = simulation.scriptFleet().front();
+        check(ship.x != startX || ship.y != startY, "ship moved");
+        check(simulation.finished() && !ship.alive, "finished script ship leaves the map");
+        check(simulation.framePool().liveFrames() == 0, "finished script returns its frame");
+    }
+
+    // Жадные сценарии с заменой ушедших: кадры ходят по кругу, пул не растет.
+    {
+        SimulationConfig config;
+        config.width = 80;
+        config.height = 60;
+        config.shipCount = 2'000;
+        config.winFishCount = 40;
+        config.scriptShips = 500;
+        config.script = ScriptKind::GREEDY_SCRIPT;
+        config.arrivals.respawn = true;
+        config.seed = 8;
+        Simulation simulation(config);
+        const FramePool& pool = simulation.framePool();
+        const uint64_t chunks = pool.chunks();
+        const uint64_t startFrames = pool.frames();
+        check(startFrames == config.scriptShips, "each script ship starts with one frame");
+
+        bool bounded = true;
+        for (int tick = 0; tick < 2000 && bounded; tick++) {
+            simulation.step();
+            bounded = check(pool.chunks() == chunks, "pool takes no new chunks after start")
+                && check(pool.liveFrames() == runningScripts(simulation), "live frames match running scripts");
+        }
+        check(pool.frames() > 3 * startFrames, "respawned scripts got frames");
+        check(simulation.scriptResumes() > 10 * pool.frames(), "resumes far outnumber frame allocations");
+        check(simulation.scriptShips() == config.scriptShips, "respawn keeps every script slot alive");
+    }
+    return failures() == 0 ? 0 : 1;
+}
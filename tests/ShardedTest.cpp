@@ -0,0 +1,48 @@
+#include <sstream>
+#include <string>
+
+#include "Check.hpp"
+#include "Sharded.hpp"
+
+// Прогоняет карту полосами и возвращает строку "State hash: ..." из вывода или пустую при ошибке.
+static std::string runStripes(unsigned shards, bool threads, uint64_t rebalanceInterval, bool verify)
+{
+    ShardedConfig config;
+    config.simulation.width = 300;
+    config.simulation.height = 200;
+    config.simulation.shipCount = 20'000;
+    config.simulation.winFishCount = 200;
+    config.simulation.typeWeights = { 2, 1, 1, 1 };
+    config.simulation.seed = 3;
+    config.shards = shards;
+    config.threads = threads;
+    config.maxTicks = 400;
+    config.rebalanceInterval = rebalanceInterval;
+    config.verify = verify;
+
+    std::ostringstream out;
+    std::string error;
+    if (!check(runSharded(config, out, error), "sharded run succeeds")) {
+        std::cerr << error << "\n" << out.str();
+        return {};
+    }
+    const std::string text = out.str();
+    const std::size_t begin = text.find("State hash: ");
+    if (!check(begin != std::string::npos, "sharded run prints the state hash")) {
+        return {};
+    }
+    return text.substr(begin, text.find_first_of(" \n", begin + 12) - begin);
+}
+
+int main()
+{
+    // Хеш не зависит от числа полос, от потоков или процессов и от сдвига границ.
+    const std::string single = runStripes(1, true, 0, false);
+    check(!single.empty(), "single-stripe hash");
+    check(runStripes(3, true, 0, false) == single, "three thread stripes give the single-stripe hash");
+    check(runStripes(4, true, 10, false) == single, "rebalanced stripes give the single-stripe hash");
+    check(runStripes(4, false, 10, false) == single, "process stripes give the single-stripe hash");
+    // С verify координатор сверяет хеш каждого тика и падает на первом расхождении.
+    check(runStripes(4, true, 7, true) == single, "per-tick verification passes");
+    return failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#include <cstdint>
+
+#include "Check.hpp"
+#include "Simulation.hpp"
+#include "Stripe.hpp"
+
+// Хеш состояния симуляции: лодки по слотам и клетки, как у полос (см. shipStateHash).
+static uint64_t stateHash(const Simulation& simulation)
+{
+    uint64_t hash = 0;
+    const ShipArray& ships = simulation.ships();
+    for (uint64_t i = 0; i < ships.size(); i++) {
+        hash += shipStateHash(i, ships[i]);
+    }
+    simulation.cells().forEachWithExpiry([&](uint64_t cell, uint8_t fish, uint32_t expireTick) {
+        hash += cellFishHash(cell, fish) + cellExpiryHash(cell, expireTick);
+    });
+    return hash;
+}
+
+// Число лодок в журнале тика, у которых поменялось слово.
+static uint64_t changedShips(const Simulation& simulation)
+{
+    uint64_t changed = 0;
+    for (const ShipChange& change : simulation.journal().ships) {
+        changed += change.before != change.after;
+    }
+    return changed;
+}
+
+int main()
+{
+    // Маленькая тесная карта: лодки часто переходят через край, рыбачат и уходят.
+    SimulationConfig config;
+    config.width = 120;
+    config.height = 80;
+    config.shipCount = 20'000;
+    config.winFishCount = 150;
+    config.typeWeights = { 1, 1, 1, 1 };
+    config.arrivals.mode = ArrivalMode::FIXED_RATE;
+    config.arrivals.rate = 5;
+    config.arrivals.respawn = true;
+    config.seed = 11;
+
+    SimulationConfig slowConfig = config;
+    slowConfig.transitionTable = false;
+
+    Simulation table(config);
+    Simulation slow(slowConfig);
+    table.setJournalEnabled(true);
+    slow.setJournalEnabled(true);
+
+    // Таблица переходов и полный обход stepShip дают одно и то же состояние на каждом тике.
+    bool same = true;
+    for (int tick = 0; tick < 1500 && same && !slow.finished(); tick++) {
+        table.step();
+        slow.step();
+        const SimulationStats& a = table.stats();
+        const SimulationStats& b = slow.stats();
+        same = check(stateHash(table) == stateHash(slow), "state hash matches the stepShip-only run")
+            && check(table.ships() == slow.ships(), "ship words match the stepShip-only run")
+            && check(a.greedyCount == b.greedyCount && a.lazyCount == b.lazyCount && a.restlessCount == b.restlessCount
+                    && a.seekerCount == b.seekerCount && a.minFishCount == b.minFishCount
+                    && a.maxFishCount == b.maxFishCount && a.meanFishCount == b.meanFishCount,
+                "statistics match the stepShip-only run")
+            && check(changedShips(table) == changedShips(slow) && table.journal().cells.size() == slow.journal().cells.size(),
+                "change journals match the stepShip-only run");
+    }
+    check(table.tick() > 100, "run is long enough to cover arrivals and departures");
+    return failures() == 0 ? 0 : 1;
+}